@@ -0,0 +1,419 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/parser_stages.h"
+#include "../include/buffer_util.h"
+#include "../include/chunk_arena.h"
+#include "../include/subsample.h"
+#include "../include/worker_pool.h"
+#include "../include/utils.h"
+
+#define DEFAULT_ROWS 2000
+#define DEFAULT_COLS 2000
+#define DEFAULT_FIELD_WIDTH 8
+#define DEFAULT_TILE_SIZE 500
+#define DEFAULT_ITERATIONS 5
+
+/*  Times the stages of parser on a synthetic heightmap: read_chunk, the
+ *  subsample kernel, then subsample_and_format and write_buffers_to_files
+ *  as parser runs them. Each stage is timed chunk after chunk over the
+ *  whole source, and the best of the iterations is reported as JSON on
+ *  stdout, in MB/s (of the bytes the stage reads or produces) and
+ *  values/s.
+ *
+ *  The source is a CSV of `rows` x `cols` fields of at most `field width`
+ *  characters (3 decimals), made of uniform noise, smooth terrain or a
+ *  constant, written in a temporary directory along with the tiles and
+ *  removed afterwards unless --keep is given.
+ *
+ *  usage: bench [--rows N] [--cols N] [--field-width W] [--eol unix|dos]
+ *               [--values uniform|terrain|constant] [--tile-width N]
+ *               [--tile-height N] [--parse-threads N] [--iterations N]
+ *               [--seed N] [--keep]
+ */
+
+typedef enum {
+	VALUES_UNIFORM = 0,
+	VALUES_TERRAIN = 1,
+	VALUES_CONSTANT = 2
+} Value_distribution;
+
+typedef struct {
+	int32_t rows;
+	int32_t cols;
+	int field_width;
+	char dos;
+	Value_distribution values;
+	int tile_width;
+	int tile_height;
+	int parse_threads;
+	int iterations;
+	uint32_t seed;
+	char keep;
+} BenchOptions;
+
+typedef enum {
+	STAGE_READ = 0,
+	STAGE_SUBSAMPLE,
+	STAGE_FUSED,
+	STAGE_WRITE,
+	STAGE_COUNT
+} Stage;
+
+static const char *stage_names[STAGE_COUNT] = {
+	"read_chunk",
+	"subsample",
+	"subsample_and_format",
+	"write_buffers_to_files"
+};
+
+typedef struct {
+	double seconds;
+	int64_t bytes;
+	int64_t values;
+} StageTime;
+
+static const char *value_names[] = {"uniform", "terrain", "constant"};
+
+static void print_usage(void) {
+	printf(
+		"usage: bench [--rows N] [--cols N] [--field-width W] [--eol unix|dos]" ENDL
+		"             [--values uniform|terrain|constant] [--tile-width N]" ENDL
+		"             [--tile-height N] [--parse-threads N] [--iterations N]" ENDL
+		"             [--seed N] [--keep]" ENDL
+	);
+}
+
+static int parse_options(BenchOptions *opt, int argc, char *argv[]) {
+	*opt = (BenchOptions) {
+		.rows = DEFAULT_ROWS,
+		.cols = DEFAULT_COLS,
+		.field_width = DEFAULT_FIELD_WIDTH,
+		.values = VALUES_TERRAIN,
+		.tile_width = DEFAULT_TILE_SIZE,
+		.tile_height = DEFAULT_TILE_SIZE,
+		.parse_threads = 1,
+		.iterations = DEFAULT_ITERATIONS,
+		.seed = 12345
+	};
+
+	for (int i = 1; i < argc; i++) {
+		const char *key = argv[i];
+		if (strcmp(key, "--keep") == 0) {
+			opt->keep = 1;
+			continue;
+		}
+		if (i + 1 == argc) return 1;
+		const char *val = argv[++i];
+
+		if (strcmp(key, "--rows") == 0) opt->rows = atoi(val);
+		else if (strcmp(key, "--cols") == 0) opt->cols = atoi(val);
+		else if (strcmp(key, "--field-width") == 0) opt->field_width = atoi(val);
+		else if (strcmp(key, "--tile-width") == 0) opt->tile_width = atoi(val);
+		else if (strcmp(key, "--tile-height") == 0) opt->tile_height = atoi(val);
+		else if (strcmp(key, "--parse-threads") == 0) opt->parse_threads = atoi(val);
+		else if (strcmp(key, "--iterations") == 0) opt->iterations = atoi(val);
+		else if (strcmp(key, "--seed") == 0) opt->seed = (uint32_t) strtoul(val, NULL, 10);
+		else if (strcmp(key, "--eol") == 0) {
+			if (strcmp(val, "dos") == 0) opt->dos = 1;
+			else if (strcmp(val, "unix") == 0) opt->dos = 0;
+			else return 1;
+		}
+		else if (strcmp(key, "--values") == 0) {
+			if (strcmp(val, "uniform") == 0) opt->values = VALUES_UNIFORM;
+			else if (strcmp(val, "terrain") == 0) opt->values = VALUES_TERRAIN;
+			else if (strcmp(val, "constant") == 0) opt->values = VALUES_CONSTANT;
+			else return 1;
+		}
+		else return 1;
+	}
+
+	// a sign, a digit, the point and 3 decimals at least
+	return opt->rows < 2 || opt->cols < 2 || opt->field_width < 6 || opt->field_width > 12
+		|| opt->tile_width < 1 || opt->tile_height < 1 || opt->tile_height > USHRT_MAX
+		|| opt->tile_width > USHRT_MAX || opt->parse_threads < 1 || opt->iterations < 1;
+}
+
+static uint32_t next_random(uint32_t *state) {
+	*state = *state * 1664525u + 1013904223u;
+	return *state >> 8;
+}
+
+/*! Value of the heightmap at (`row`, `col`), within +-`amplitude`. */
+static double heightmap_value(const BenchOptions *opt, int32_t row, int32_t col, double amplitude, uint32_t *state) {
+	double noise = (double) next_random(state) / (1 << 24) * 2.0 - 1.0;
+	switch (opt->values) {
+		case VALUES_UNIFORM:
+			return amplitude * noise;
+		case VALUES_CONSTANT:
+			return amplitude / 3.0;
+		default: {
+			// ridges and valleys, with a little noise on top
+			double height = sin(row * 0.013) + sin(col * 0.011) + 0.5 * sin((row + col) * 0.031);
+			return amplitude * (0.38 * height + 0.04 * noise);
+		}
+	}
+}
+
+/*! Writes the synthetic source at `path`.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+static int generate_source(const BenchOptions *opt, const char *path) {
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL) return errno;
+
+	// widest magnitude that still fits with the sign and 3 decimals
+	double amplitude = pow(10.0, opt->field_width - 5) - 0.001;
+	uint32_t state = opt->seed;
+	char *line = (char *) malloc((size_t) opt->cols * (opt->field_width + 1) + 2);
+	if (line == NULL) {
+		fclose(fp);
+		return ENOMEM;
+	}
+
+	int err = 0;
+	for (int32_t row = 0; row < opt->rows && !err; row++) {
+		char *dst = line;
+		for (int32_t col = 0; col < opt->cols; col++) {
+			double value = heightmap_value(opt, row, col, amplitude, &state);
+			dst += snprintf(dst, opt->field_width + 1, "%.3f", value);
+			*dst++ = ',';
+		}
+		dst--;
+		if (opt->dos) *dst++ = '\r';
+		*dst++ = '\n';
+		if (fwrite(line, 1, dst - line, fp) != (size_t) (dst - line)) err = errno ? errno : EIO;
+	}
+
+	free(line);
+	if (fclose(fp) && !err) err = errno ? errno : EIO;
+	return err;
+}
+
+/*! Removes every file of `dir`, then `dir` itself. */
+static void remove_dir(const char *dir) {
+	DIR *d = opendir(dir);
+	if (d == NULL) return;
+
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+		char path[MAXIMUM_PATH()];
+		snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+		unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+static void add_time(StageTime *st, double start, int64_t bytes, int64_t values) {
+	st->seconds += monotonic_seconds() - start;
+	st->bytes += bytes;
+	st->values += values;
+}
+
+/*! Runs every stage over the whole source once.
+ *
+ * @return the number of source rows read, -1 if a chunk is not read as
+ *         generated.
+ */
+static int64_t run_stages(
+	StageTime times[STAGE_COUNT],
+	const char *map,
+	uint64_t file_size,
+	const Config *conf,
+	const RowLayout *row_lo,
+	ReadBuffer *rd,
+	CompBuffer *cp,
+	ChunkIndex *idx,
+	WorkerPool *pool,
+	ChunkArena *arena,
+	float *values,
+	const char *dir
+){
+	memset(times, 0, STAGE_COUNT * sizeof(StageTime));
+	MapOffsets off = {0};
+	char complete = 0;
+	int64_t source_rows = 0;
+
+	for (int tile_row = 0; !complete; tile_row++) {
+		ReadStats stats = {0};
+		rd->start = (char *) map + off.fstart_to_page;
+		uint64_t consumed = off.fstart_to_readptr;
+
+		double start = monotonic_seconds();
+		int32_t rows = read_chunk(rd, cp, idx, pool, row_lo, &off, file_size, NULL, &stats, &complete);
+		consumed = (complete ? file_size : off.fstart_to_readptr) - consumed;
+		add_time(times + STAGE_READ, start, consumed, (int64_t) rows * row_lo->window_fields);
+		source_rows += rows;
+		if (stats.short_rows || stats.long_rows || (!complete && rows < cp->row_count)) return -1;
+
+		ProcValBuffer pv;
+		init_ProcValBufferStruct(&pv, row_lo, conf);
+		pv.row_count = rows / conf->downsample_factor;
+		pv.bytesize = (int64_t) pv.row_count * pv.row_length * sizeof(float);
+		pv.start = values;
+		int64_t out_values = (int64_t) pv.row_count * pv.row_length;
+
+		// the same views of the arena as alloc_output_buffers
+		WriteBuffer wr = {0};
+		FullFileBuffer ff;
+		int64_t arena_used = 0;
+		wr.arena = arena;
+		if (init_WriteBufferStruct(&wr, &pv, conf, &arena_used)) return -1;
+		init_FullFileBuffer(&ff, pv.row_length, pv.row_count, wr.field_size, row_lo->sep_size, row_lo->eol_size);
+		wr.buffer = carve_arena(arena, &arena_used, wr.bytesize);
+		ff.buffer = carve_arena(arena, &arena_used, ff.bytesize);
+		if (wr.buffer == NULL || ff.buffer == NULL) return -1;
+		asign_filebuffers(&wr);
+
+		start = monotonic_seconds();
+		subsample(cp, &pv);
+		add_time(times + STAGE_SUBSAMPLE, start, (int64_t) rows * cp->row_length * sizeof(float), out_values);
+
+		start = monotonic_seconds();
+		subsample_and_format(cp, pv.row_count, conf->downsample_factor, conf->downsample_filter, conf->engine, &wr, &ff, values, 0);
+		add_time(times + STAGE_FUSED, start, wr.bytesize + ff.bytesize, out_values);
+
+		start = monotonic_seconds();
+		write_buffers_to_files(&wr, dir, tile_row);
+		add_time(times + STAGE_WRITE, start, wr.bytesize, out_values);
+	}
+	return source_rows;
+}
+
+static void print_json(const BenchOptions *opt, uint64_t file_size, const StageTime best[STAGE_COUNT]) {
+	printf("{" ENDL);
+	printf("  \"source\": {" ENDL);
+	printf("    \"rows\": %d," ENDL, opt->rows);
+	printf("    \"cols\": %d," ENDL, opt->cols);
+	printf("    \"field_width\": %d," ENDL, opt->field_width);
+	printf("    \"eol\": \"%s\"," ENDL, opt->dos ? "dos" : "unix");
+	printf("    \"values\": \"%s\"," ENDL, value_names[opt->values]);
+	printf("    \"bytes\": %llu" ENDL, (unsigned long long) file_size);
+	printf("  }," ENDL);
+	printf("  \"tile_width\": %d," ENDL, opt->tile_width);
+	printf("  \"tile_height\": %d," ENDL, opt->tile_height);
+	printf("  \"parse_threads\": %d," ENDL, opt->parse_threads);
+	printf("  \"subsample_isa\": \"%s\"," ENDL, subsample_row_isa());
+	printf("  \"iterations\": %d," ENDL, opt->iterations);
+	printf("  \"stages\": [" ENDL);
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		const StageTime *st = best + s;
+		double seconds = st->seconds > 0 ? st->seconds : 1e-9;
+		printf(
+			"    {\"name\": \"%s\", \"seconds\": %.6f, \"bytes\": %lld, \"values\": %lld, "
+			"\"mb_per_s\": %.1f, \"values_per_s\": %.0f}%s" ENDL,
+			stage_names[s], st->seconds, (long long) st->bytes, (long long) st->values,
+			st->bytes / seconds / 1e6, st->values / seconds, s + 1 < STAGE_COUNT ? "," : ""
+		);
+	}
+	printf("  ]" ENDL);
+	printf("}" ENDL);
+}
+
+int main(int argc, char* argv[]) {
+	BenchOptions opt;
+	if (parse_options(&opt, argc, argv)) {
+		print_usage();
+		return 1;
+	}
+
+	char dir[] = "/tmp/bench_XXXXXX";
+	if (mkdtemp(dir) == NULL) {
+		fprintf(stderr, "could not create a temporary directory: %s" ENDL, strerror(errno));
+		return 1;
+	}
+	char source[MAXIMUM_PATH()];
+	snprintf(source, sizeof(source), "%s/source.csv", dir);
+
+	int err = generate_source(&opt, source);
+	if (err) {
+		fprintf(stderr, "could not write `%s`: %s" ENDL, source, strerror(err));
+		remove_dir(dir);
+		return 1;
+	}
+
+	Config conf = {
+		.tile_width = (unsigned short) opt.tile_width,
+		.tile_height = (unsigned short) opt.tile_height,
+		.min_field_size = 5,
+		.max_field_size = (unsigned char) opt.field_width,
+		.output_field_size = (unsigned char) opt.field_width,
+		.output_format = OUTPUT_CSV,
+		.eol_flag = opt.dos ? EOL_DOS : EOL_UNIX,
+		.write_mode = WRITE_STDIO,
+		.downsample_factor = 2,
+		.downsample_filter = FILTER_BOX,
+		.parse_threads = (unsigned short) opt.parse_threads
+	};
+
+	int fd = open(source, O_RDONLY);
+	RowLayout row_lo = {0};
+	ErrMsg rl_err = {0};
+	if (fd < 0 || get_row_layout(&row_lo, &conf, fd, &rl_err)) {
+		fprintf(stderr, "could not read the layout of `%s`" ENDL, source);
+		remove_dir(dir);
+		return 1;
+	}
+	uint64_t file_size = file_size_from_fd(fd);
+	char *map = (char *) mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "could not map `%s`: %s" ENDL, source, strerror(errno));
+		remove_dir(dir);
+		return 1;
+	}
+
+	ReadBuffer rd;
+	CompBuffer cp;
+	ChunkIndex idx;
+	WorkerPool pool;
+	ArenaPool arenas;
+	init_ReadBufferStruct(&rd, &row_lo, &conf);
+	ChunkArena *arena = NULL;
+	float *values = (float *) malloc((size_t) conf.tile_height * (row_lo.window_fields / 2) * sizeof(float));
+	if (
+		init_CompBuffer(&cp, &row_lo, &conf) || init_ChunkIndex(&idx, &row_lo, &conf)
+		|| init_WorkerPool(&pool, opt.parse_threads)
+		|| init_ArenaPool(&arenas, chunk_arena_size(&conf, &row_lo))
+		|| (arena = take_arena(&arenas)) == NULL || values == NULL
+	) {
+		fprintf(stderr, "Out of memory" ENDL);
+		remove_dir(dir);
+		return 1;
+	}
+
+	StageTime best[STAGE_COUNT];
+	StageTime times[STAGE_COUNT];
+	int failed = 0;
+	for (int i = 0; i < opt.iterations && !failed; i++) {
+		int64_t rows = run_stages(times, map, file_size, &conf, &row_lo, &rd, &cp, &idx, &pool, arena, values, dir);
+		failed = rows != opt.rows;
+		for (int s = 0; s < STAGE_COUNT; s++) {
+			if (i == 0 || times[s].seconds < best[s].seconds) best[s] = times[s];
+		}
+	}
+
+	if (failed) fprintf(stderr, "the source was not read as generated" ENDL);
+	else print_json(&opt, file_size, best);
+
+	give_back_arena(&arenas, arena);
+	free_ArenaPool(&arenas);
+	free_WorkerPool(&pool);
+	free(values);
+	munmap(map, file_size);
+	close(fd);
+	if (!opt.keep) remove_dir(dir);
+	else fprintf(stderr, "source and tiles kept in %s" ENDL, dir);
+	return failed;
+}
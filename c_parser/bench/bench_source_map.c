@@ -0,0 +1,158 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/scanner.h"
+#include "../include/stream_reader.h"
+#include "../include/utils.h"
+
+#define DEFAULT_WINDOW_MIB 16
+#define DEFAULT_ITERATIONS 5
+
+/*  Compares the ways parser can read its source: a fresh mapping for
+ *  every window (read_mode = window), the whole file mapped once with
+ *  madvise hints (read_mode = whole), or pread by a background thread
+ *  (read_mode = stream). All count the rows of the file with scan_eol,
+ *  window after window, like the parse stage would.
+ *
+ *  With --cold, the file is evicted from the page cache before each run
+ *  (posix_fadvise, Linux only) so the read ahead is measured too.
+ *
+ *  usage: bench_source_map <file> [window MiB] [iterations] [--cold]
+ */
+
+static int64_t count_rows(const char *start, const char *limit) {
+	int64_t rows = 0;
+	for (const char *p = scan_eol(start, limit); p != NULL; p = scan_eol(p + 1, limit)) rows++;
+	return rows;
+}
+
+static int64_t remap_per_window(int fd, uint64_t file_size, uint64_t window) {
+	int64_t rows = 0;
+	for (uint64_t offset = 0; offset < file_size; offset += window) {
+		uint64_t length = file_size - offset < window ? file_size - offset : window;
+		char *map = (char *) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, (off_t) offset);
+		if (map == MAP_FAILED) return -1;
+
+		rows += count_rows(map, map + length);
+		munmap(map, length);
+	}
+	return rows;
+}
+
+static int64_t map_whole_file(int fd, uint64_t file_size, uint64_t window) {
+	char *map = (char *) mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) return -1;
+	madvise(map, file_size, MADV_SEQUENTIAL);
+
+	int64_t rows = 0;
+	for (uint64_t offset = 0; offset < file_size; offset += window) {
+		uint64_t length = file_size - offset < window ? file_size - offset : window;
+
+		uint64_t next = offset + length;
+		if (next < file_size) {
+			uint64_t ahead = file_size - next < window ? file_size - next : window;
+			madvise(map + next, ahead, MADV_WILLNEED);
+		}
+
+		rows += count_rows(map + offset, map + offset + length);
+		madvise(map + offset, length, MADV_DONTNEED);
+	}
+	munmap(map, file_size);
+	return rows;
+}
+
+static int64_t stream_file(int fd, uint64_t file_size, uint64_t window) {
+	StreamReader sr;
+	if (init_StreamReader(&sr, fd, file_size, (int64_t) window, 0)) return -1;
+
+	int64_t rows = 0;
+	for (uint64_t offset = 0; offset < file_size; offset += window) {
+		uint64_t length = file_size - offset < window ? file_size - offset : window;
+		const char *data = stream_window(&sr, offset);
+		if (data == NULL) {
+			rows = -1;
+			break;
+		}
+		rows += count_rows(data, data + length);
+	}
+	free_StreamReader(&sr);
+	return rows;
+}
+
+static double time_mode(
+	int64_t (*fn)(int, uint64_t, uint64_t),
+	int fd, uint64_t file_size, uint64_t window,
+	int iterations, char cold, int64_t *rows
+) {
+	double best = 1e30;
+	for (int i = 0; i < iterations; i++) {
+#ifdef POSIX_FADV_DONTNEED
+		if (cold) posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+		(void) cold;
+#endif
+		double start = monotonic_seconds();
+		*rows = fn(fd, file_size, window);
+		double elapsed = monotonic_seconds() - start;
+		if (elapsed < best) best = elapsed;
+	}
+	return best;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		printf("usage: bench_source_map <file> [window MiB] [iterations] [--cold]" ENDL);
+		return 1;
+	}
+	int window_mib = argc > 2 ? atoi(argv[2]) : DEFAULT_WINDOW_MIB;
+	int iterations = argc > 3 ? atoi(argv[3]) : DEFAULT_ITERATIONS;
+	char cold = argc > 4 && strcmp(argv[4], "--cold") == 0;
+	if (window_mib < 1 || iterations < 1) {
+		printf("window and iterations must be positive" ENDL);
+		return 1;
+	}
+
+	int fd = open(argv[1], O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) || st.st_size == 0) {
+		printf("could not open `%s`: %s" ENDL, argv[1], strerror(errno));
+		return 1;
+	}
+	uint64_t file_size = (uint64_t) st.st_size;
+	uint64_t window = (uint64_t) window_mib << 20; // a multiple of the page size
+
+	printf(
+		"%.1f MiB in windows of %d MiB, best of %d runs%s" ENDL,
+		file_size / 1048576.0, window_mib, iterations, cold ? ", cold cache" : ""
+	);
+
+	int64_t remap_rows = 0;
+	int64_t whole_rows = 0;
+	int64_t stream_rows = 0;
+	double remap = time_mode(remap_per_window, fd, file_size, window, iterations, cold, &remap_rows);
+	double whole = time_mode(map_whole_file, fd, file_size, window, iterations, cold, &whole_rows);
+	double stream = time_mode(stream_file, fd, file_size, window, iterations, cold, &stream_rows);
+
+	double gbytes = file_size / 1e9;
+	printf("window : %8.2f ms  %6.2f GB/s" ENDL, remap * 1e3, gbytes / remap);
+	printf("whole  : %8.2f ms  %6.2f GB/s  (x%.2f)" ENDL, whole * 1e3, gbytes / whole, remap / whole);
+	printf("stream : %8.2f ms  %6.2f GB/s  (x%.2f)" ENDL, stream * 1e3, gbytes / stream, remap / stream);
+
+	close(fd);
+	if (remap_rows < 0 || remap_rows != whole_rows || remap_rows != stream_rows) {
+		printf(
+			"row counts differ: %lld, %lld and %lld" ENDL,
+			(long long) remap_rows, (long long) whole_rows, (long long) stream_rows
+		);
+		return 1;
+	}
+	printf("%lld rows in every mode" ENDL, (long long) whole_rows);
+	return 0;
+}
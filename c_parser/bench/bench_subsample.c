@@ -0,0 +1,122 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/subsample.h"
+#include "../include/utils.h"
+
+// CompBuffer of 1000 rows of 100k values by default
+#define DEFAULT_ROW_COUNT 1000
+#define DEFAULT_ROW_LENGTH 100000
+#define DEFAULT_ITERATIONS 10
+
+/*  Microbenchmark of subsample: the loop parser.c had before the kernel
+ *  was vectorized, the plain C kernel and the SIMD version picked by
+ *  subsample_row on this machine, against the first one.
+ *
+ *  usage: bench_subsample [row count] [row length] [iterations]
+ */
+
+/*! The subsampling loop of parser.c before subsample_row, kept as it was.
+ *  It reads row `row` and the values r_len further instead of rows
+ *  2 * row and 2 * row + 1, so its output is timed but not compared.
+ */
+static void subsample_original(CompBuffer* cpb, ProcValBuffer* pvb) {
+	// redefined with a shorter name within this scope
+	int r_len = pvb->row_length;
+	int r_cnt = pvb->row_count;
+
+	for(int row_off = 0; row_off < r_cnt * r_len; row_off+=r_len) {
+		for(int col_off = 0; col_off < r_len; col_off++) {
+
+			float *from = cpb->start + 2 * (row_off + col_off);
+			float *to = pvb->start + (row_off + col_off);
+
+			//avg
+			*to = (from[0] + from[1] + from[r_len] + from[r_len + 1]) / 4;
+		}
+	}
+}
+
+static void subsample_scalar(CompBuffer* cpb, ProcValBuffer* pvb) {
+	for (int32_t row = 0; row < pvb->row_count; row++) {
+		const float *top = cpb->start + (int64_t) 2 * row * cpb->row_length;
+		subsample_row_scalar(
+			top, top + cpb->row_length,
+			pvb->start + (int64_t) row * pvb->row_length,
+			pvb->row_length
+		);
+	}
+}
+
+static double time_subsample(
+	void (*fn)(CompBuffer*, ProcValBuffer*),
+	CompBuffer *cpb,
+	ProcValBuffer *pvb,
+	int iterations
+) {
+	double best = 1e30;
+	for (int i = 0; i < iterations; i++) {
+		double start = monotonic_seconds();
+		fn(cpb, pvb);
+		double elapsed = monotonic_seconds() - start;
+		if (elapsed < best) best = elapsed;
+	}
+	return best;
+}
+
+int main(int argc, char* argv[]) {
+	int32_t row_count = argc > 1 ? atoi(argv[1]) : DEFAULT_ROW_COUNT;
+	int32_t row_length = argc > 2 ? atoi(argv[2]) : DEFAULT_ROW_LENGTH;
+	int iterations = argc > 3 ? atoi(argv[3]) : DEFAULT_ITERATIONS;
+	if (row_count < 2 || row_length < 2 || iterations < 1) {
+		printf("usage: bench_subsample [row count] [row length] [iterations]" ENDL);
+		return 1;
+	}
+
+	CompBuffer cpb = {
+		.row_length = row_length,
+		.row_count = row_count,
+		.bytesize = (int64_t) row_length * row_count * sizeof(float)
+	};
+	ProcValBuffer pvb = {
+		.row_length = row_length / 2,
+		.row_count = row_count / 2,
+		.bytesize = (int64_t) (row_length / 2) * (row_count / 2) * sizeof(float)
+	};
+	cpb.start = (float *) malloc(cpb.bytesize);
+	pvb.start = (float *) malloc(pvb.bytesize);
+	float *reference = (float *) malloc(pvb.bytesize);
+	if (cpb.start == NULL || pvb.start == NULL || reference == NULL) {
+		printf("Out of memory" ENDL);
+		return 1;
+	}
+
+	uint32_t state = 12345;
+	for (int64_t i = 0; i < (int64_t) row_length * row_count; i++) {
+		state = state * 1664525u + 1013904223u;
+		cpb.start[i] = (float) (state >> 8) / 1000.0f - 5000.0f;
+	}
+
+	printf("CompBuffer of %d x %d values, best of %d runs" ENDL, row_count, row_length, iterations);
+
+	double original = time_subsample(subsample_original, &cpb, &pvb, iterations);
+	double scalar = time_subsample(subsample_scalar, &cpb, &pvb, iterations);
+	memcpy(reference, pvb.start, pvb.bytesize);
+	double simd = time_subsample(subsample, &cpb, &pvb, iterations);
+
+	double gbytes = (double) (cpb.bytesize + pvb.bytesize) / 1e9;
+	printf("original : %8.2f ms  %6.2f GB/s" ENDL, original * 1e3, gbytes / original);
+	printf("scalar   : %8.2f ms  %6.2f GB/s  (x%.2f)" ENDL, scalar * 1e3, gbytes / scalar, original / scalar);
+	printf("%-8s : %8.2f ms  %6.2f GB/s  (x%.2f)" ENDL,
+		subsample_row_isa(), simd * 1e3, gbytes / simd, original / simd);
+
+	int identical = memcmp(reference, pvb.start, pvb.bytesize) == 0;
+	printf("scalar and %s results are %s" ENDL, subsample_row_isa(), identical ? "bit-identical" : "DIFFERENT");
+
+	free(reference);
+	free(pvb.start);
+	free(cpb.start);
+	return identical ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#ifndef __BAND_WRITER_H
+#define __BAND_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "custom_dtypes.h"
+
+typedef struct {
+	// a tile of the row of tiles being appended to, band after band
+	FILE *fp;
+	int64_t rows;
+	char failed;
+} TileColumn;
+
+typedef struct {
+	// the tiles of the current row of tiles, open from its first band to
+	// its last. Only the first `max_open` stay open in between, the other
+	// ones are reopened for every band
+	TileColumn *columns;
+	int32_t column_count;
+	int32_t max_open;
+	int32_t bands_per_tile_row;
+	int32_t tile_height;
+} BandWriter;
+
+/*! Sets the band writer up for rows of tiles of `column_count` tiles.
+ *  `reserved` files are kept for the rest of the run, the tiles get what
+ *  the open file limit leaves. On Linux and macOS, the soft limit is
+ *  raised towards the hard one when that is too little for a whole row
+ *  of tiles, with a warning.
+ *
+ * @return 0 on success, 1 if out of memory.
+ */
+int init_BandWriter(BandWriter *bw, const Config *conf, int32_t column_count, int32_t reserved);
+
+void free_BandWriter(BandWriter *bw);
+
+/*! Appends band `band` of `wr` to the tiles of its row of tiles in `dir`.
+ *  The tiles are created by the first band of the row, and closed after
+ *  its last one, or after `last`. Errors are reported tile by tile, a
+ *  tile is left alone after its first error.
+ */
+void append_band_to_files(BandWriter *bw, WriteBuffer *wr, const char *dir, int band, char last);
+
+#endif
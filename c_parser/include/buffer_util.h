@@ -1,6 +1,11 @@
 #include "custom_dtypes.h"
 #include <stdint.h>
 
+/*! Output rows made from each chunk: a band with band_height, a whole
+ *  row of tiles otherwise.
+ */
+int32_t chunk_height(const Config *cf);
+
 void init_ReadBufferStruct(
 	ReadBuffer *rb,
 	const RowLayout* row_lo,
@@ -13,6 +18,12 @@ void init_CompBufferStruct(
 	const Config *cf
 );
 
+void init_ChunkIndexStruct(
+	ChunkIndex *idx,
+	const RowLayout *row_lo,
+	const Config *cf
+);
+
 void init_ProcValBufferStruct(
 	ProcValBuffer *pvb,
 	const RowLayout *row_lo,
@@ -0,0 +1,75 @@
+#ifndef __CHUNK_ARENA_H
+#define __CHUNK_ARENA_H
+
+#include <stdint.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <pthread.h>
+#endif
+
+// Size of a huge page on x86-64 and most aarch64 kernels
+#define HUGE_PAGE_SIZE (2 << 20)
+// Buffers carved out of an arena start on a cache line
+#define ARENA_ALIGNMENT 64
+
+typedef enum {
+	ARENA_MALLOC = 0,
+	ARENA_PAGES = 1,
+	ARENA_HUGE_PAGES = 2,
+	ARENA_HUGETLB = 3
+} Arena_backing;
+
+typedef struct ChunkArena {
+	// room for the output buffers of a chunk, handed from chunk to chunk
+	char *start;
+	int64_t bytesize;
+	Arena_backing backing;
+	struct ChunkArena *next;
+} ChunkArena;
+
+typedef struct {
+	// arenas no chunk is using, see take_arena
+	ChunkArena *free_arenas;
+	int64_t arena_bytesize;
+	int32_t arena_count;
+	Arena_backing backing;
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_t lock;
+#endif
+} ArenaPool;
+
+/*! Sets up a pool of arenas of `arena_bytesize` bytes each. No arena is
+ *  allocated until one is taken.
+ *
+ * @return 0 on success, 1 otherwise.
+ */
+int init_ArenaPool(ArenaPool *ap, int64_t arena_bytesize);
+
+/*! Hands out an arena no one is using, allocating a new one only when
+ *  they are all taken. Its content is whatever the last user left there.
+ *  Can be called from any thread.
+ *
+ *  New arenas are backed by preallocated huge pages (MAP_HUGETLB) when
+ *  the system has some, by transparent huge pages (MADV_HUGEPAGE) or
+ *  plain anonymous pages otherwise, and malloc'd on other platforms.
+ *
+ * @return the arena, NULL if out of memory.
+ */
+ChunkArena *take_arena(ArenaPool *ap);
+
+/*! Puts `arena` back in the pool for the next chunk. Can be called from any
+ *  thread. Does nothing if `arena` is NULL.
+ */
+void give_back_arena(ArenaPool *ap, ChunkArena *arena);
+
+/*! Returns the next `size` bytes of `arena` past `*used`, aligned on a
+ *  cache line, and moves `*used` past them.
+ *
+ * @return the bytes, NULL if the arena is too small.
+ */
+char *carve_arena(ChunkArena *arena, int64_t *used, int64_t size);
+
+/*! Releases every arena. They must all have been given back. */
+void free_ArenaPool(ArenaPool *ap);
+
+#endif
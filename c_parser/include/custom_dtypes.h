@@ -1,10 +1,18 @@
 #ifndef __CUSTOM_DTYPES_H
 #define __CUSTOM_DTYPES_H
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <sys/types.h>
 
+#include "worker_pool.h"
+#include "stream_reader.h"
+#include "tile_writer.h"
+#include "chunk_arena.h"
+#include "row_index.h"
+#include "value_cache.h"
+
 #ifdef _WIN32
 #define MAXIMUM_PATH( ... ) MAX_PATH
 #else
@@ -27,6 +35,42 @@ typedef union {
 
 typedef enum {EOL_AUTO = 0, EOL_UNIX = 1, EOL_DOS = 2} Eol_flag;
 
+typedef enum {
+	READ_AUTO = 0,
+	READ_MMAP_WHOLE = 1,
+	READ_MMAP_WINDOW = 2,
+	READ_STREAM = 3
+} Read_mode;
+
+typedef enum {
+	WRITE_AUTO = 0,
+	WRITE_URING = 1,
+	WRITE_STDIO = 2,
+	WRITE_MMAP = 3
+} Write_mode;
+
+typedef enum {
+	OUTPUT_CSV = 0,
+	OUTPUT_F32 = 1,
+	OUTPUT_F16 = 2,
+	OUTPUT_NPY = 3
+} Output_format;
+
+typedef enum {
+	FILTER_BOX = 0,
+	FILTER_MIN = 1,
+	FILTER_MAX = 2,
+	FILTER_BILINEAR = 3
+} Filter_flag;
+
+typedef enum {
+	// fields parsed to floats, averaged and printed back as floats
+	ENGINE_FLOAT = 0,
+	// fields parsed to int32 thousandths, and kept so down to the text
+	// written, in the same buffers as the floats would be
+	ENGINE_FIXED = 1
+} Engine_flag;
+
 typedef struct {
 	// statistics about a row of a csv
 	char* string;
@@ -52,12 +96,40 @@ typedef struct{
 	// should be merged with Params struct
 	unsigned short tile_width;
 	unsigned short tile_height;
+	unsigned short band_height;
 	unsigned  char min_field_size;
 	unsigned  char max_field_size;
 	unsigned  char output_field_size;
+	Output_format output_format;
 	Eol_flag eol_flag;
+	Read_mode read_mode;
+	// rows found from the .rowidx sidecar of the source, see row_index.h
+	char row_index;
+	// values read from the .f32cache of the source, or written to it by
+	// a run over the whole source, see value_cache.h
+	char value_cache;
+	Write_mode write_mode;
+	unsigned  char downsample_factor;
+	Filter_flag downsample_filter;
+	Engine_flag engine;
+	unsigned  char pyramid_levels;
+	unsigned short threads;
+	unsigned short parse_threads;
+	// bytes, 0 for no limit
+	int64_t memory_limit;
+	// commits written rows to a journal in dest, and picks an
+	// interrupted run up from its last commit
+	char resume;
+	// window of the source converted, rows then columns, from first
+	// included to end excluded; the whole source when end is 0
+	int64_t roi_row_first;
+	int64_t roi_row_end;
+	int32_t roi_col_first;
+	int32_t roi_col_end;
 	char source[MAXIMUM_PATH()];
 	char dest[MAXIMUM_PATH()];
+	// where the run report is written as JSON, empty for none
+	char report_json[MAXIMUM_PATH()];
 } Config;
 
 typedef struct{
@@ -70,7 +142,13 @@ typedef struct {
 	char sep_size;
 	char max_field_size;
 	char min_field_size;
+	// fields of a row of the source
 	int32_t field_count;
+	// fields converted, from first_field on, see roi_cols
+	int32_t first_field;
+	int32_t window_fields;
+	// what the fields are converted to
+	Engine_flag engine;
 	int64_t max_size;
 } RowLayout;
 
@@ -88,6 +166,29 @@ typedef struct {
 	float *start;
 } CompBuffer;
 
+typedef struct {
+	// structural index of a chunk, see index_chunk in scanner.h
+	// `row_length` offsets of separators/eol per row, relative to the row
+	uint32_t *field_ends;
+	// offset of each row, relative to the start of the chunk,
+	// followed by the offset of the end of the last row
+	int64_t *row_starts;
+	// number of fields found in each row
+	int32_t *row_fields;
+	int32_t row_length;
+	int32_t row_count;
+	int32_t row_capacity;
+	int64_t bytesize;
+} ChunkIndex;
+
+typedef struct {
+	// anomalies spotted while reading a chunk
+	int64_t small_fields;
+	int64_t big_fields;
+	int64_t short_rows;
+	int64_t long_rows;
+} ReadStats;
+
 typedef struct {
 	int32_t row_length;
 	int32_t row_count;
@@ -100,6 +201,10 @@ typedef struct {
 	int32_t row_length;
 	int32_t row_size;
 	int64_t bytesize;
+	// WRITE_MMAP: mapping of the whole tile, `buffer` points in it.
+	// NULL if the tile could not be mapped, `buffer` is malloc'd then
+	char* map;
+	int64_t map_size;
 } FileBuffer;
 
 typedef struct {
@@ -107,9 +212,19 @@ typedef struct {
 	int64_t bytesize;
 	FileBuffer* file_buffers;
 	int32_t file_buffer_count;
+	// binary formats have no separator nor eol,
+	// and `field_size` bytes per value
+	Output_format format;
+	// what the values handed to it are
+	Engine_flag engine;
 	char sep_size;
 	short field_size;
 	char eol_size;
+	// WRITE_MMAP: the file buffers are mapped tiles, not parts of `buffer`
+	char mapped;
+	// where `buffer`, `file_buffers` and the full file buffer are carved
+	// from, given back to the pool along with them
+	ChunkArena *arena;
 } WriteBuffer;
 
 typedef struct {
@@ -134,6 +249,10 @@ typedef struct {
 	int32_t row_bytesize;
 	int32_t row_count;
 	short eol_size;
+	// WRITE_MMAP: mapping of the pages of the full file holding the rows,
+	// `buffer` points in it. NULL if they could not be mapped
+	char* map;
+	int64_t map_size;
 } FullFileBuffer;
 
 typedef struct {
@@ -141,4 +260,88 @@ typedef struct {
 	uint64_t page_to_readptr;
 	uint64_t fstart_to_readptr;
 } MapOffsets;
+
+typedef struct {
+	// cursor walking through the source file, chunk after chunk
+	ReadBuffer rd;
+	ChunkIndex idx;
+	WorkerPool pool;
+	MapOffsets off;
+	uint64_t file_size;
+	Read_mode mode;
+	// offsets of the rows of the source, NULL to look for them chunk
+	// after chunk
+	const RowIndex *rows;
+	// values of the source already converted, taken instead of parsing it
+	// when mapped, or appended to while written
+	ValueCache *cache;
+	// READ_MMAP_WHOLE: mapping of the whole file, the windows point in it,
+	// and everything before `released` has been given back to the OS
+	char *file_map;
+	uint64_t released;
+	// READ_STREAM: the windows point in the stream's buffer
+	StreamReader stream;
+#ifdef _WIN32
+	HANDLE map_handle;
+#endif
+	int32_t next_tile_row;
+	char complete;
+} SourceReader;
+
+typedef enum {
+	PARSE_STAGE = 0,
+	FORMAT_STAGE = 1,
+	WRITE_STAGE = 2,
+	PIPELINE_STAGES = 3
+} Pipeline_stage;
+
+typedef struct {
+	// a row of tiles going through the parse, format and write stages,
+	// or only a band of it with band_height, `tile_row` is then the
+	// index of the band
+	int32_t tile_row;
+	int32_t read_rows;
+	char last;
+	ReadStats rstats;
+	int64_t read_bytes;
+	// offset of the source right after the chunk
+	uint64_t source_end;
+	// seconds spent in each stage, for the run report
+	double stage_seconds[PIPELINE_STAGES];
+	CompBuffer cp;
+	// rows of a mapped value cache, used instead of `cp` when set, with
+	// the length of the rows of the cache as row_length
+	CompBuffer cached;
+	ProcValBuffer pv;
+	// subsampled values, a single row unless a pyramid needs them all,
+	// allocated with the first chunk and kept for the next ones
+	float *values;
+	WriteBuffer wr;
+	FullFileBuffer ff;
+	// set once `ff` is in the full file, if a formatter did it
+	char ff_written;
+	int ff_error;
+} Chunk;
+
+typedef struct {
+	// a row of tiles handed to the TileWriter, and the buffers it owns
+	// until the writes are done
+	TileWrite *tiles;
+	int32_t tile_count;
+	char *paths;
+	char *headers;
+	WriteBuffer wr;
+} TileBatch;
+
+typedef struct {
+	// peak bytes of the buffers, for chunks of `chunk_rows` output rows
+	int32_t chunk_rows;
+	int32_t chunks_in_flight;
+	int64_t read;
+	int64_t index;
+	int64_t values;
+	int64_t output;
+	int64_t pyramid;
+	int64_t total;
+} MemoryFootprint;
 #endif
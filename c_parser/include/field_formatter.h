@@ -0,0 +1,30 @@
+#ifndef __FIELD_FORMATTER_H
+#define __FIELD_FORMATTER_H
+
+#include <stdint.h>
+
+// Enough for any float printed with "%.3f" and a field size up to 255
+#define FORMAT_FALLBACK_SIZE 320
+
+/*! Writes `value` with 3 decimals, zero padded to `width` characters.
+ *
+ * Produces the same `width` characters as
+ * `snprintf(dst, width + 1, "%0*.3f", width, value)` but does not write the
+ * terminating '\0'. The rounding to 3 decimals is done with integers
+ * (round half to even, on the exact binary value, like printf does).
+ * Non-finite and very large values are handed to snprintf.
+ *
+ * @return the number of characters snprintf would have wanted to write,
+ *         anything other than `width` means the value did not fit.
+ */
+int format_field(char *dst, int width, float value);
+
+/*! Writes `thousandths` / 1000 with 3 decimals, zero padded to `width`
+ *  characters, straight from the integer.
+ *
+ * Produces the same characters and count as format_field does for a
+ * float holding that exact value, but 0 is never written as "-0.000".
+ */
+int format_fixed_field(char *dst, int width, int32_t thousandths);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef __FIELD_PARSER_H
+#define __FIELD_PARSER_H
+
+#include <stdint.h>
+
+// Largest mantissa that a float holds exactly (2^24)
+#define FAST_FIELD_MAX_MANTISSA 16777216
+// Largest power of ten that a float holds exactly (10^10)
+#define FAST_FIELD_MAX_DECIMALS 10
+// Fields handed to strtof are copied first, up to this size minus the nul
+#define FIELD_COPY_SIZE 128
+
+/*! Parses a `[-]ddd.ddd` field into a float in a single pass.
+ *
+ * No character is read at or after `start + max_size`, so a field can
+ * end right where the readable memory does.
+ *
+ * @param start first character of the field.
+ * @param max_size number of characters the field can span, its width
+ *        when it is known.
+ * @param end set to the first character after the field.
+ *
+ * @return the parsed value, bit-identical to what strtof would return on
+ *         the first `max_size` characters. Anything outside of the fast
+ *         path (exponents, hex, inf, nan, leading spaces, too many
+ *         digits...) is copied and handed to strtof.
+ */
+float parse_field(const char *start, int max_size, char **end);
+
+/*! Parses a `[-]ddd.ddd` field into an integer number of thousandths,
+ *  without going through a float.
+ *
+ * Fields with fewer decimals are scaled, and the decimals after the 3rd
+ * are rounded half away from zero, on their exact decimal value. Anything
+ * outside of this (exponents, inf, nan, values beyond +-2147483.647...)
+ * is copied and handed to strtod, then rounded the same way and clamped.
+ * Like parse_field, nothing is read at or after `start + max_size`.
+ *
+ * @return the value times 1000, 0 if there is no number at all.
+ */
+int32_t parse_fixed_field(const char *start, int max_size, char **end);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef __FULL_FILE_H
+#define __FULL_FILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <pthread.h>
+#endif
+
+#include "custom_dtypes.h"
+
+typedef struct {
+	// resized_full file of a directory, open from the first row of tiles
+	// to the last, each of them written at its own offset
+	char path[MAXIMUM_PATH()];
+#ifdef _WIN32
+	FILE *fp;
+#else
+	int fd;
+#endif
+	Output_format format;
+	int64_t data_offset;
+	int32_t row_length;
+	int64_t row_bytesize;
+	int32_t rows_per_chunk;
+	// rows written so far, in order
+	int64_t rows;
+	char failed;
+#if defined(__APPLE__) || defined(__LINUX__)
+	// WRITE_MMAP: size of the file, grown as rows of tiles get mapped
+	int64_t size;
+	pthread_mutex_t grow_lock;
+#endif
+} FullFile;
+
+typedef enum {
+	FULL_FILE_OPEN = 0,
+	// could not be created, `failed` is set and the run goes on without it
+	FULL_FILE_NOT_CREATED = 1,
+	// the file of the interrupted run holds fewer rows than its journal
+	FULL_FILE_MISMATCH = 2,
+	FULL_FILE_FAILED = 3
+} Full_file_status;
+
+/*! Creates the resized_full file of `dir`, reserves room for `max_rows`
+ *  rows of `row_length` values and writes the npy header if needed.
+ *  Every chunk but the last brings `rows_per_chunk` rows.
+ *  With `kept_rows`, the file of an interrupted run is cut back to its
+ *  first `kept_rows` rows instead.
+ *
+ * @return how it went, the reason of any error is printed.
+ */
+Full_file_status open_FullFile(
+	FullFile *full,
+	const char *dir,
+	const Config *conf,
+	const RowLayout *row_lo,
+	int32_t row_length,
+	int32_t rows_per_chunk,
+	int64_t max_rows,
+	int64_t kept_rows
+);
+
+/*! Writes the rows of chunk `chunk` where they belong in the full file.
+ *  Only reads what open_FullFile set, so chunks can be written in any
+ *  order and from any thread (not on Windows, where the file position
+ *  is shared).
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int write_full_rows(const FullFile *full, const FullFileBuffer *ff, int32_t chunk);
+
+/*! Counts the rows of `ff` once written, or reports `err` and stops
+ *  writing the full file. Chunks must be accounted for in order.
+ */
+void account_full_rows(FullFile *full, const FullFileBuffer *ff, int err);
+
+/*! Maps the pages of the full file where the rows of chunk `chunk` go,
+ *  growing the file if needed. Can be called from any thread.
+ *
+ * @return 0 on success, an errno value otherwise, with `ff` untouched.
+ */
+int map_full_rows(FullFile *full, FullFileBuffer *ff, int32_t chunk);
+
+/*! Flushes the rows written so far to the disk. Nothing is done for a
+ *  full file that could not be created or written.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int sync_FullFile(FullFile *full);
+
+/*! Trims the full file to the rows written, sets the row count of the npy
+ *  header, and closes the file.
+ */
+int close_FullFile(FullFile *full);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __OUTPUT_FILES_H
+#define __OUTPUT_FILES_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "custom_dtypes.h"
+
+/*! @return the extension of the files written in `format`. */
+const char *output_extension(Output_format format);
+
+/*! Builds the path of tile `col` of row `tile_row` of `dir`.
+ *
+ * @return 0 on success, 1 if it does not fit in `size` bytes.
+ */
+int tile_path(char *dst, size_t size, const char *dir, int tile_row, int col, Output_format format);
+
+/*! Points `t` at the bytes of tile `col`. With npy, its header is built
+ *  in `header`, which must hold NPY_HEADER_SIZE bytes.
+ */
+void fill_TileWrite(TileWrite *t, const WriteBuffer *wr, int col, const char *path, char *header);
+
+/*! Writes the header and data of `t` at the position of `fp`. */
+void fwrite_tile(FILE *fp, TileWrite *t);
+
+/*! Writes a tile with fopen/fwrite, where io_uring is not available. */
+void write_tile_stdio(TileWrite *t);
+
+/*! Prints what went wrong while writing a tile, if anything.
+ *  Errors are not fatal, the other tiles are still written.
+ */
+void report_tile_write(const TileWrite *t);
+
+/*! Explains the errno of a tile that could not be opened. */
+void output_open_print_err(int err);
+
+/*! Explains the errno of a full file that could not be opened. */
+void output_fullfile_open_print_err(int err);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __PARSER_STAGES_H
+#define __PARSER_STAGES_H
+
+#include "custom_dtypes.h"
+#include "utils.h"
+#include <stdint.h>
+
+/*  The stages of parser.c, for the benchmarks. Compiling parser.c with
+ *  PARSER_NO_MAIN leaves its main out.
+ */
+
+int init_CompBuffer(CompBuffer *cb, const RowLayout *row_lo, const Config *cf);
+
+int init_ChunkIndex(ChunkIndex *idx, const RowLayout *row_lo, const Config *cf);
+
+#if defined(__APPLE__) || defined(__LINUX__)
+int get_row_layout(RowLayout *row_lo, const Config *conf, int input_fd, ErrMsg *err);
+#endif
+
+int init_WriteBufferStruct(WriteBuffer* wb, ProcValBuffer* pvb, const Config* conf, int64_t *arena_used);
+
+void asign_filebuffers(WriteBuffer *wrb);
+
+/*! Indexes and converts the rows of the window `rd` to floats, up to the
+ *  CompBuffer's row count, and moves `off` to the first row left. The rows
+ *  are taken from `rows` if not NULL, looked for otherwise.
+ *
+ * @return the number of rows converted.
+ */
+int read_chunk(
+	const ReadBuffer *rd,
+	CompBuffer *cp,
+	ChunkIndex *idx,
+	WorkerPool *pool,
+	const RowLayout *row_lo,
+	MapOffsets *off,
+	uint64_t file_size,
+	const RowIndex *rows,
+	ReadStats *stats,
+	char* read_complete_flag
+);
+
+int subsample_and_format(
+	const CompBuffer *cp,
+	int32_t rows,
+	int factor,
+	Filter_flag filter,
+	Engine_flag engine,
+	WriteBuffer *wr,
+	FullFileBuffer *ff,
+	float *values,
+	int64_t values_stride
+);
+
+void write_buffers_to_files(WriteBuffer *wr, const char *dir, int tile_row);
+
+int64_t chunk_arena_size(const Config *conf, const RowLayout *row_lo);
+
+#endif
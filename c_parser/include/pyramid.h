@@ -0,0 +1,64 @@
+#ifndef __PYRAMID_H
+#define __PYRAMID_H
+
+#include <stdint.h>
+
+#include "custom_dtypes.h"
+#include "full_file.h"
+
+typedef struct {
+	// a level of the pyramid, built one row of the level above at a time
+	char dir[MAXIMUM_PATH()];
+	int32_t width;
+	int32_t next_tile_row;
+	FullFile full;
+	// rows of the level above waiting for a whole block of `factor` rows
+	float *carry;
+	int32_t carry_length;
+	int32_t carry_rows;
+	// rows of this level waiting for a whole row of tiles,
+	// `pending.row_count` of them are filled
+	ProcValBuffer pending;
+	int32_t pending_capacity;
+} PyramidLevel;
+
+// writes the pending rows of level `k` as its next row of tiles
+typedef void (*LevelFlush)(void *ctx, PyramidLevel *lvl, int32_t k);
+
+typedef struct {
+	// levels[0] is the output of the chunks themselves, at 1/factor,
+	// levels[k] is at 1/factor^(k+1) and is fed by levels[k - 1]
+	PyramidLevel *levels;
+	int32_t level_count;
+	int factor;
+	Filter_flag filter;
+	Engine_flag engine;
+	LevelFlush flush;
+	void *ctx;
+} Pyramid;
+
+/*! Sets the `pyramid_levels` levels of `conf` up for a source converted
+ *  over `width` columns, and allocates the carry and pending rows of every
+ *  level past the first. The directories and full files of the levels are
+ *  left to the caller, `flush` writes the rows of tiles.
+ *
+ * @return 0 on success, 1 if out of memory, 2 if a level would have no
+ *         column left.
+ */
+int init_Pyramid(Pyramid *pyr, const Config *conf, int32_t width, LevelFlush flush, void *ctx);
+
+void free_Pyramid(Pyramid *pyr);
+
+/*! Hands a row of level `k - 1` to level `k`. Every `factor` rows, the
+ *  carry is reduced into a new row of level `k`, which cascades down to
+ *  level `k + 1` in turn. Rows must be pushed in order.
+ */
+void pyramid_push_row(Pyramid *pyr, int32_t k, const float *row);
+
+/*! Writes what is left in every level once the source has been read.
+ *  Carried rows that don't make a whole block are dropped, like the last
+ *  rows of the source.
+ */
+void pyramid_flush(Pyramid *pyr);
+
+#endif
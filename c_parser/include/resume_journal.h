@@ -0,0 +1,79 @@
+#ifndef __RESUME_JOURNAL_H
+#define __RESUME_JOURNAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "custom_dtypes.h"
+
+// Hidden, so that it is not taken for an output file
+#define JOURNAL_NAME ".resume_journal"
+
+typedef struct {
+	// a point of the run up to which every output file is complete
+	int32_t next_chunk;
+	// rows of the first level written before it
+	int64_t rows;
+	// where the source is read from after it
+	uint64_t source_offset;
+} JournalEntry;
+
+typedef struct {
+	// commits of a run to JOURNAL_NAME in the destination, each written
+	// to a temporary file renamed over the previous one
+	char open;
+	char path[MAXIMUM_PATH()];
+	char dest[MAXIMUM_PATH()];
+	uint64_t fingerprint;
+	// rows of the first level between two commits
+	int64_t commit_rows;
+	// rows of the first level written so far
+	int64_t rows;
+} ResumeJournal;
+
+typedef enum {
+	JOURNAL_MISSING = 0,
+	JOURNAL_FOUND = 1,
+	// written for another source or configuration
+	JOURNAL_MISMATCH = 2,
+	JOURNAL_UNREADABLE = 3
+} Journal_status;
+
+/*! Hashes what the output depends on: the source, through its path, size
+ *  and modification time, and the settings shaping the tiles and rows, the window included.
+ */
+uint64_t run_fingerprint(const Config *conf, uint64_t source_size, int64_t source_mtime);
+
+/*! @return 1 if `dest` holds a journal, 0 otherwise. */
+int journal_exists(const char *dest);
+
+/*! Reads the last commit of the journal of `dest`. A commit cut short by
+ *  the end of the run that wrote it is ignored. With no commit at all,
+ *  `last` is zeroed.
+ *
+ * @return JOURNAL_FOUND if the journal was written with `fingerprint`.
+ */
+Journal_status read_journal(const char *dest, uint64_t fingerprint, JournalEntry *last);
+
+/*! Starts the journal of `dest` over, with `from` as its only commit if
+ *  it is past the first chunk. The previous journal is replaced at once,
+ *  so that a run stopped here can still be resumed.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int open_ResumeJournal(ResumeJournal *rj, const char *dest, uint64_t fingerprint, const JournalEntry *from);
+
+/*! Replaces the journal by one holding `e`, flushed to the disk along
+ *  with the destination directory, so that it only ever points at rows
+ *  already on the disk.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int commit_journal(ResumeJournal *rj, const JournalEntry *e);
+
+/*! Closes the journal, and removes it if `complete`, as there is nothing
+ *  left to resume.
+ */
+void close_ResumeJournal(ResumeJournal *rj, char complete);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef __RESUME_TILES_H
+#define __RESUME_TILES_H
+
+#include <stdint.h>
+
+#include "custom_dtypes.h"
+#include "resume_journal.h"
+
+/*! Checks that the tiles of row of tiles `tile_row` of `dir`, for output
+ *  rows of `width` values, are all there and of the exact size of a
+ *  whole tile.
+ *
+ * @return the number of tiles missing or of another size.
+ */
+int32_t check_tile_row(const char *dir, int tile_row, int32_t width, const Config *conf);
+
+/*! Removes the rows of tiles of `dir` from `tile_row` on, left by the
+ *  interrupted run past its last commit.
+ *
+ * @return the number of tiles removed.
+ */
+int32_t remove_tile_rows(const char *dir, int tile_row, int32_t width, const Config *conf);
+
+/*! Checks the last committed row of tiles of every level, then removes
+ *  the tiles written after it, which the resumed run writes again. The
+ *  number of tiles removed is put in `removed`.
+ *
+ * @return the number of tiles missing or cut short, which the resumed
+ *         run can't be trusted with.
+ */
+int32_t check_resumed_tiles(const Config *conf, const RowLayout *row_lo, const JournalEntry *from, int32_t *removed);
+
+/*! Flushes the rows of tiles of every level between rows `from_rows` and
+ *  `to_rows` of the first level to the disk, along with the entries of
+ *  their directories, before a commit points past them.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int sync_committed_tiles(const Config *conf, const RowLayout *row_lo, int64_t from_rows, int64_t to_rows);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __ROW_INDEX_H
+#define __ROW_INDEX_H
+
+#include <stdint.h>
+
+// Appended to the source path to name the sidecar
+#define ROW_INDEX_SUFFIX ".rowidx"
+
+typedef struct {
+	// offset of every row of the source, and of its end, at
+	// row_starts[row_count]
+	uint64_t *row_starts;
+	int64_t row_count;
+	// the source the offsets belong to
+	uint64_t source_size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+} RowIndex;
+
+typedef enum {
+	ROW_INDEX_LOADED = 0,
+	ROW_INDEX_BUILT = 1,
+	// built, but the sidecar could not be written
+	ROW_INDEX_NOT_SAVED = 2,
+	ROW_INDEX_FAILED = 3
+} Row_index_status;
+
+/*! Gives the row offsets of the source open as `fd` at `source_path`.
+ *
+ * They come from the `.rowidx` sidecar next to it when its header matches
+ * the size and modification time of the source. Otherwise every eol of
+ * the source is looked for with scan_eol, and the sidecar is (re)written
+ * with the offsets, as LEB128 varints of the distance between
+ * consecutive rows.
+ *
+ * @return how the index was obtained. With ROW_INDEX_FAILED (read error,
+ *         out of memory, platform without pread), `ri` is empty.
+ */
+Row_index_status open_RowIndex(RowIndex *ri, const char *source_path, int fd);
+
+/*! Moves `offset`, at the start of a row of `fd`, past the next `rows`
+ * rows, looking for their eols with scan_eol and nothing else. Used
+ * when the source has no index. On Windows, `fd` must be open in binary
+ * mode, and is left past the last block read.
+ *
+ * @return the number of rows skipped, fewer at the end of the source,
+ *         or -1 on a read error.
+ */
+int64_t skip_rows(int fd, uint64_t source_size, uint64_t *offset, int64_t rows);
+
+/*! Finds the first row starting at or after `offset`.
+ *
+ * @return its index, row_count if there is none.
+ */
+int64_t row_at_offset(const RowIndex *ri, uint64_t offset);
+
+void free_RowIndex(RowIndex *ri);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __RUN_REPORT_H
+#define __RUN_REPORT_H
+
+#include "custom_dtypes.h"
+#include <stdint.h>
+
+typedef struct {
+	// what a run went through, printed once it is over
+	double start;
+	// seconds each chunk spent in every stage, chunk after chunk
+	double *stage_seconds[PIPELINE_STAGES];
+	int32_t chunk_count;
+	int32_t chunk_capacity;
+	int64_t bytes_read;
+	int64_t values_parsed;
+	// rows taken from the value cache are neither read nor parsed
+	int64_t cache_bytes_read;
+	int64_t values_cached;
+	ReadStats parse_errors;
+	int64_t values_written;
+	int64_t bytes_written;
+} RunReport;
+
+/*! Starts the clock of the run. */
+void init_RunReport(RunReport *rr);
+
+/*! Adds the stage times, bytes read and values parsed of chunk `ch`,
+ *  once written, or the values it took from the value cache.
+ *
+ * @return 0 on success, 1 if out of memory.
+ */
+int report_chunk(RunReport *rr, const Chunk *ch);
+
+/*! Counts the values and bytes of a row of tiles and its full file rows. */
+void report_output(RunReport *rr, const WriteBuffer *wr, const FullFileBuffer *ff);
+
+/*! Prints the totals and percentiles of the stages, the volumes and the
+ *  throughput of the run.
+ */
+void print_RunReport(const RunReport *rr);
+
+/*! Writes the report as a JSON object to `path`.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int write_RunReport_json(const RunReport *rr, const char *path);
+
+void free_RunReport(RunReport *rr);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __SCANNER_H
+#define __SCANNER_H
+
+#include <stdint.h>
+
+#include "custom_dtypes.h"
+
+/*! Finds every separator of a row and its end of line.
+ *
+ * Uses AVX2 or SSE2 when the compiler targets them, plain C otherwise.
+ *
+ * @param row first character of the row.
+ * @param limit first character that must not be read.
+ * @param ends receives the offset (relative to `row`) of each ',' and of
+ *        the terminating '\n'. Can be NULL if `capacity` is 0.
+ * @param capacity number of offsets `ends` can hold. Any hit past it is
+ *        counted but not stored.
+ * @param eol set to the '\n' ending the row, or to NULL if `limit` was
+ *        reached first.
+ *
+ * @return the number of separators found, plus one for the eol if found.
+ */
+int64_t scan_row(
+	const char *row,
+	const char *limit,
+	uint32_t *ends,
+	int64_t capacity,
+	const char **eol
+);
+
+/*! Finds the next '\n', with the same instructions as scan_row.
+ *
+ * @return a pointer to the '\n', or NULL if `limit` was reached first.
+ */
+const char *scan_eol(const char *p, const char *limit);
+
+/*! Finds where each of the next `max_rows` rows starts.
+ *
+ * Only looks for eols, which is enough to split a chunk in independent
+ * rows. Fills `idx->row_starts` and `idx->row_count`, and sets
+ * `idx->row_starts[idx->row_count]` to the end of the last row.
+ * A last row with no eol is kept only if `limit` is the end of the file,
+ * as signaled by `at_eof`.
+ *
+ * @return a pointer to the first character after the last row found.
+ */
+const char *find_row_starts(
+	ChunkIndex *idx,
+	const char *start,
+	const char *limit,
+	int32_t max_rows,
+	char at_eof
+);
+
+/*! Same as find_row_starts, from the offsets of `ri` instead of a scan of
+ *  the chunk. `start` is the byte at `offset` of the source.
+ */
+const char *find_indexed_row_starts(
+	ChunkIndex *idx,
+	const RowIndex *ri,
+	uint64_t offset,
+	const char *start,
+	const char *limit,
+	int32_t max_rows
+);
+
+/*! Indexes the fields of rows [first, last) found by find_row_starts.
+ *
+ * Rows are independent, so distinct ranges can be indexed concurrently.
+ */
+void index_rows(ChunkIndex *idx, const char *start, int32_t first, int32_t last);
+
+/*! Indexes up to `max_rows` rows starting at `start`.
+ *
+ * Same as find_row_starts followed by index_rows over every row found.
+ *
+ * @return a pointer to the first character after the last indexed row.
+ */
+const char *index_chunk(
+	ChunkIndex *idx,
+	const char *start,
+	const char *limit,
+	int32_t max_rows,
+	char at_eof
+);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef __STREAM_READER_H
+#define __STREAM_READER_H
+
+#include <stdint.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <pthread.h>
+#endif
+
+// Size of each pread, a multiple of any page size
+#define STREAM_BLOCK_SIZE (8 << 20)
+
+typedef struct {
+	// a file read block after block by a background thread, see stream_window
+	int fd;
+	uint64_t file_size;
+	int64_t window_size;
+	int64_t block_count;
+	// the thread reads block i in blocks[i % 2] while block i - 1 is used
+	char *blocks[2];
+	int64_t block_lengths[2];
+	char block_ready[2];
+	int64_t next_read;
+	int64_t next_take;
+	int read_error;
+	char running;
+	char stopping;
+	// bytes of the file from `window_offset` on, up to `tail`
+	char *window;
+	int64_t window_capacity;
+	int64_t tail;
+	uint64_t window_offset;
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+#endif
+} StreamReader;
+
+/*! Allocates the buffers and starts reading `fd` from the block holding
+ *  `offset`, the first offset stream_window will be asked for.
+ *
+ * @param window_size number of bytes stream_window must give at once.
+ *
+ * @return 0 on success, 1 otherwise. Always fails on platforms without
+ *         pread and pthreads.
+ */
+int init_StreamReader(StreamReader *sr, int fd, uint64_t file_size, int64_t window_size, uint64_t offset);
+
+/*! Gives the bytes of the file from `offset` on.
+ *
+ * Waits for the background reads until `window_size` bytes (or whatever
+ * is left of the file) are available, carrying over the bytes of the
+ * previous window that were not used yet. `offset` must never go back,
+ * what is before it is dropped.
+ *
+ * @return a pointer to the byte at `offset`, or NULL if a read failed,
+ *         with errno set.
+ */
+const char *stream_window(StreamReader *sr, uint64_t offset);
+
+void free_StreamReader(StreamReader *sr);
+
+#endif
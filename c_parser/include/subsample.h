@@ -0,0 +1,68 @@
+#ifndef __SUBSAMPLE_H
+#define __SUBSAMPLE_H
+
+#include <stdint.h>
+
+#include "custom_dtypes.h"
+
+/*! Averages the 2x2 blocks of two consecutive rows of a CompBuffer.
+ *
+ * Picks the widest instructions available: AVX2 (checked at run time with
+ * GCC and clang), SSE2 or NEON, and plain C otherwise. Every path adds the
+ * 4 values in the same order, so they all give bit-identical results.
+ *
+ * @param top row 2*i of the CompBuffer.
+ * @param bottom row 2*i + 1 of the CompBuffer.
+ * @param out receives `out_length` averages.
+ */
+void subsample_row(const float *top, const float *bottom, float *out, int32_t out_length);
+
+/*! Plain C version of subsample_row. */
+void subsample_row_scalar(const float *top, const float *bottom, float *out, int32_t out_length);
+
+/*! Name of the instruction set subsample_row uses on this machine. */
+const char *subsample_row_isa(void);
+
+/*! Averages every 2x2 block of `cpb` into `pvb`. */
+void subsample(CompBuffer* cpb, ProcValBuffer* pvb);
+
+/*! Reduces each `factor` x `factor` block of `factor` rows into one value.
+ *
+ * FILTER_BOX averages the block, FILTER_MIN and FILTER_MAX keep its
+ * extremum, FILTER_BILINEAR interpolates the source at the center of the
+ * block: the central value for odd factors, the average of the 4 central
+ * values for even ones. A factor of 2 with the box or bilinear filter goes
+ * through subsample_row.
+ *
+ * @param rows first value of the first of the `factor` rows.
+ * @param stride number of floats between two consecutive rows.
+ * @param out receives `out_length` values.
+ */
+void downsample_row(
+	const float *rows,
+	int64_t stride,
+	float *out,
+	int32_t out_length,
+	int factor,
+	Filter_flag filter
+);
+
+/*! downsample_row for values in thousandths, with integers only.
+ *
+ * Sums are made in 64 bits, and averages rounded half away from zero,
+ * so the result only depends on the values, not on the order they are
+ * added in.
+ */
+void downsample_row_fixed(
+	const int32_t *rows,
+	int64_t stride,
+	int32_t *out,
+	int32_t out_length,
+	int factor,
+	Filter_flag filter
+);
+
+/*! Name of the filter, as written in the config file. */
+const char *filter_name(Filter_flag filter);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef __TILE_WRITER_H
+#define __TILE_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__LINUX__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define TILE_WRITER_URING 1
+#endif
+#endif
+
+typedef struct {
+	// a file to create (or truncate) and fill with `header_size` bytes of
+	// `header`, if any, then `size` bytes of `data`
+	const char *path;
+	const char *header;
+	int64_t header_size;
+	const char *data;
+	int64_t size;
+	// results, valid once wait_tile_writes returned
+	int open_error;
+	int write_error;
+	int64_t header_written;
+	int64_t written;
+	// completions not reaped yet
+	int32_t pending_ops;
+} TileWrite;
+
+typedef struct {
+	// an io_uring instance writing a row of tiles while the caller goes on
+	int ring_fd;
+	uint32_t file_slots;
+	// submission queue
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned *sq_array;
+	void *sqes;
+	// completion queue
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	unsigned cq_entries;
+	void *cqes;
+	// mappings of the rings
+	void *sq_map;
+	size_t sq_map_size;
+	void *cq_map;
+	size_t cq_map_size;
+	size_t sqes_size;
+	// the row of tiles in flight
+	TileWrite *tiles;
+	int32_t tile_count;
+	int32_t next_tile;
+	int64_t in_flight;
+	unsigned unsubmitted;
+} TileWriter;
+
+/*! Sets up an io_uring able to write rows of up to `max_tiles` tiles.
+ *
+ * Every tile is written by linked operations, openat, write (header then
+ * data) and close, through a registered file slot, so that no file
+ * descriptor has to come back to user space in between.
+ *
+ * @return 0 on success, 1 if io_uring or one of the operations is not
+ *         available (old kernel, seccomp filter, other platform...), in
+ *         which case the tiles must be written some other way.
+ */
+int init_TileWriter(TileWriter *tw, int32_t max_tiles);
+
+/*! Queues the writes of `count` tiles and submits them in one call.
+ *
+ * Returns without waiting, as soon as the ring took every tile or is full.
+ * `tiles`, the paths and the data must stay valid until wait_tile_writes
+ * returned. Only one row of tiles can be in flight at a time.
+ *
+ * @return 0 on success, or the errno of a failed io_uring_enter.
+ */
+int submit_tile_writes(TileWriter *tw, TileWrite *tiles, int32_t count);
+
+/*! Waits until every tile of the row in flight is written and closed,
+ *  and fills their results. Does nothing if no row is in flight.
+ *
+ * @return 0 on success, or the errno of a failed io_uring_enter, in which
+ *         case the results of the tiles are not reliable.
+ */
+int wait_tile_writes(TileWriter *tw);
+
+void free_TileWriter(TileWriter *tw);
+
+#endif
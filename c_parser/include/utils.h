@@ -20,6 +20,28 @@ typedef struct {
 
 void _die(const char e_msg[], int excode, char USAGE[MAX_USAGE]);
 
+/*! Seconds elapsed since an arbitrary point, from a monotonic clock. */
+double monotonic_seconds(void);
+
+/*! Largest resident set size of the process so far, in bytes, 0 if
+ *  unknown.
+ */
+int64_t peak_rss_bytes(void);
+
+/*! Flushes the file at `path` to the disk, along with what was written
+ *  to it through other descriptors or mappings.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int sync_file(const char *path);
+
+/*! Flushes the entries of directory `path` to the disk, so that the files
+ *  created or renamed in it stay there.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int sync_dir(const char *path);
+
 #if defined(__APPLE__) || defined(__LINUX__)
 size_t file_size_from_fd(int fildes);
 #endif
@@ -0,0 +1,73 @@
+#ifndef __VALUE_CACHE_H
+#define __VALUE_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "row_index.h"
+
+// Appended to the source path to name the cache
+#define VALUE_CACHE_SUFFIX ".f32cache"
+
+typedef struct {
+	// offsets of the rows of the source the values come from, with the
+	// size and modification time of the source
+	RowIndex rows;
+	// rows.row_count rows of row_length values, one after the other
+	const float *values;
+	int32_t row_length;
+	// mapping of the whole cache, once read
+	void *map;
+	uint64_t map_size;
+	// while written, to the path with a .tmp suffix until it is complete
+	FILE *fp;
+	int64_t row_capacity;
+	char *path;
+} ValueCache;
+
+typedef enum {
+	// mapped, values and rows can be read
+	VALUE_CACHE_LOADED = 0,
+	// absent, or written from another version of the source, it can be
+	// written with start_ValueCache
+	VALUE_CACHE_MISSING = 1,
+	VALUE_CACHE_FAILED = 2
+} Value_cache_status;
+
+/*! Maps the `.f32cache` file next to the source open as `fd` at
+ * `source_path`, if its header matches the size and modification time of
+ * the source and `row_length`, its number of fields.
+ *
+ * The cache holds the values of every row as parsed by read_chunk, float32
+ * in the byte order of the host, then the offset of every row in the
+ * source, as a RowIndex would.
+ *
+ * @return VALUE_CACHE_FAILED if the source can't be looked at or on a
+ *         platform without mmap.
+ */
+Value_cache_status open_ValueCache(ValueCache *vc, const char *source_path, int fd, int32_t row_length);
+
+/*! Starts writing the cache of a source whose cache is missing.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int start_ValueCache(ValueCache *vc);
+
+/*! Appends `rows` rows of values, which start in the source at `base`
+ *  plus their `row_starts`.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int append_ValueCache(ValueCache *vc, const float *values, int32_t rows, const int64_t *row_starts, uint64_t base);
+
+/*! Completes the cache once every row of the source was appended, and
+ *  renames it to its final path.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+int finish_ValueCache(ValueCache *vc);
+
+/*! Unmaps the cache, or drops it if it was being written. */
+void close_ValueCache(ValueCache *vc);
+
+#endif
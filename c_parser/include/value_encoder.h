@@ -0,0 +1,41 @@
+#ifndef __VALUE_ENCODER_H
+#define __VALUE_ENCODER_H
+
+#include <stdint.h>
+
+// Size of the .npy header written by write_npy_header, data included
+#define NPY_HEADER_SIZE 128
+
+/*! Converts a float to IEEE half precision bits.
+ *
+ * Rounds to nearest even like a hardware conversion does: values of 65520
+ * and above become infinities, tiny ones become half subnormals or zeros,
+ * and nans stay nans.
+ */
+uint16_t float_to_half(float value);
+
+/*! Writes `count` floats as little-endian float32.
+ *
+ * @return a pointer to the byte following the last value.
+ */
+char *encode_f32(char *dst, const float *values, int32_t count);
+
+/*! Writes `count` floats as little-endian float16.
+ *
+ * @param overflow incremented for every finite value that became infinite.
+ *
+ * @return a pointer to the byte following the last value.
+ */
+char *encode_f16(char *dst, const float *values, int32_t count, int *overflow);
+
+/*! Writes the header of a .npy (version 1.0) file holding a C ordered
+ *  `rows` x `cols` array of little-endian float32.
+ *
+ * The header is padded with spaces to NPY_HEADER_SIZE bytes whatever the
+ * shape, so it can be rewritten once the final row count is known.
+ *
+ * @param dst room for NPY_HEADER_SIZE bytes.
+ */
+void write_npy_header(char *dst, int64_t rows, int64_t cols);
+
+#endif
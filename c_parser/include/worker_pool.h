@@ -0,0 +1,45 @@
+#ifndef __WORKER_POOL_H
+#define __WORKER_POOL_H
+
+#include <stdint.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <pthread.h>
+#endif
+
+typedef void (*PoolTask)(void *ctx, int32_t task);
+
+typedef struct {
+	// threads waiting to run batches of tasks, see run_on_pool
+	int32_t thread_count;
+	PoolTask fn;
+	void *ctx;
+	int32_t task_count;
+	int32_t next_task;
+	int32_t done_tasks;
+	uint64_t batch;
+	char stopping;
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_t *threads;
+	pthread_mutex_t lock;
+	pthread_cond_t batch_ready;
+	pthread_cond_t batch_done;
+#endif
+} WorkerPool;
+
+/*! Starts `thread_count - 1` threads: the caller of run_on_pool is the
+ *  last worker. On platforms without pthreads, no thread is started and
+ *  every task runs in the caller.
+ *
+ * @return 0 on success, 1 otherwise.
+ */
+int init_WorkerPool(WorkerPool *wp, int32_t thread_count);
+
+/*! Runs fn(ctx, 0) ... fn(ctx, task_count - 1) on the pool and returns
+ *  once they are all done. Tasks must be independent of each other.
+ */
+void run_on_pool(WorkerPool *wp, PoolTask fn, void *ctx, int32_t task_count);
+
+void free_WorkerPool(WorkerPool *wp);
+
+#endif
@@ -176,6 +176,21 @@ void show_params(Params* paramsp) {
 	printf("destination directory has path `%s`" ENDL, paramsp->dest);
 }
 
+/*! Reads a range written `first..end`, quoted or not.
+ *
+ * @return 0 if it holds 0 <= first < end, 1 otherwise.
+ */
+int parse_range(const char* s, long long* first, long long* end){
+	while(*s == ' ' || *s == '"') s++;
+	char *stop;
+	*first = strtoll(s, &stop, 10);
+	if (stop == s || stop[0] != '.' || stop[1] != '.') return 1;
+	s = stop + 2;
+	*end = strtoll(s, &stop, 10);
+	if (stop == s) return 1;
+	return *first < 0 || *end <= *first;
+}
+
 int match_words(const char* s1, const char* s2, size_t len){
 	for (size_t i = 0; i < len; i++){
 		if (s1[i] != s2[i]) return 0;
@@ -211,11 +226,28 @@ int parse_config_file_line(const Segment* line, Config* conf){
 	char minfield[] = "min_field_size";
 	char maxfield[] = "max_field_size";
 	char outfield[] = "output_field_size";
+	char outformat[] = "output_format";
+	char readmode[] = "read_mode";
+	char writemode[] = "write_mode";
 	char eol[] = "eol_flag";
 	char tile_w[] = "tile_width";
 	char tile_h[] = "tile_height";
+	char band_h[] = "band_height";
+	char factor[] = "downsample_factor";
+	char filter[] = "downsample_filter";
+	char engine[] = "engine";
+	char pyramid[] = "pyramid_levels";
+	char threads[] = "threads";
+	char parse_threads[] = "parse_threads";
+	char mem_limit[] = "memory_limit";
+	char row_index[] = "row_index";
+	char resume[] = "resume";
+	char value_cache[] = "value_cache";
+	char roi_rows[] = "roi_rows";
+	char roi_cols[] = "roi_cols";
 	char source[] = "source";
 	char dest[] = "dest";
+	char report[] = "report_json";
 
 	const char MAX_SPACE_EQ_TO_VAL = 100;
 
@@ -228,12 +260,153 @@ int parse_config_file_line(const Segment* line, Config* conf){
 	else if (match_words(line->start, outfield, sizeof(outfield) - 1)){
 		conf->output_field_size = atoi(value_start);
 	}
+	else if (match_words(line->start, outformat, sizeof(outformat) - 1)){
+		while(*value_start == ' ') value_start++;
+		if (match_words(value_start, "csv", 3)) conf->output_format = OUTPUT_CSV;
+		else if (match_words(value_start, "f32", 3)) conf->output_format = OUTPUT_F32;
+		else if (match_words(value_start, "f16", 3)) conf->output_format = OUTPUT_F16;
+		else if (match_words(value_start, "npy", 3)) conf->output_format = OUTPUT_NPY;
+		else {
+			printf("Error: output_format must be one of csv, f32, f16 or npy" ENDL);
+			return 1;
+		}
+	}
+	else if (match_words(line->start, readmode, sizeof(readmode) - 1)){
+		while(*value_start == ' ') value_start++;
+		if (match_words(value_start, "auto", 4)) conf->read_mode = READ_AUTO;
+		else if (match_words(value_start, "whole", 5)) conf->read_mode = READ_MMAP_WHOLE;
+		else if (match_words(value_start, "window", 6)) conf->read_mode = READ_MMAP_WINDOW;
+		else if (match_words(value_start, "stream", 6)) conf->read_mode = READ_STREAM;
+		else {
+			printf("Error: read_mode must be one of auto, whole, window or stream" ENDL);
+			return 1;
+		}
+	}
+	else if (match_words(line->start, row_index, sizeof(row_index) - 1)){
+		while(*value_start == ' ') value_start++;
+		if (match_words(value_start, "on", 2)) conf->row_index = 1;
+		else if (match_words(value_start, "off", 3)) conf->row_index = 0;
+		else {
+			printf("Error: row_index must be on or off" ENDL);
+			return 1;
+		}
+	}
+	else if (match_words(line->start, value_cache, sizeof(value_cache) - 1)){
+		while(*value_start == ' ') value_start++;
+		if (match_words(value_start, "on", 2)) conf->value_cache = 1;
+		else if (match_words(value_start, "off", 3)) conf->value_cache = 0;
+		else {
+			printf("Error: value_cache must be on or off" ENDL);
+			return 1;
+		}
+	}
+	else if (match_words(line->start, resume, sizeof(resume) - 1)){
+		while(*value_start == ' ') value_start++;
+		if (match_words(value_start, "on", 2)) conf->resume = 1;
+		else if (match_words(value_start, "off", 3)) conf->resume = 0;
+		else {
+			printf("Error: resume must be on or off" ENDL);
+			return 1;
+		}
+	}
+	else if (match_words(line->start, roi_rows, sizeof(roi_rows) - 1)){
+		long long first, end;
+		if (parse_range(value_start, &first, &end)) {
+			printf("Error: roi_rows must be a range first..end of rows, end excluded" ENDL);
+			return 1;
+		}
+		conf->roi_row_first = (int64_t) first;
+		conf->roi_row_end = (int64_t) end;
+	}
+	else if (match_words(line->start, roi_cols, sizeof(roi_cols) - 1)){
+		long long first, end;
+		if (parse_range(value_start, &first, &end) || end > INT32_MAX) {
+			printf("Error: roi_cols must be a range first..end of columns, end excluded" ENDL);
+			return 1;
+		}
+		conf->roi_col_first = (int32_t) first;
+		conf->roi_col_end = (int32_t) end;
+	}
+	else if (match_words(line->start, writemode, sizeof(writemode) - 1)){
+		while(*value_start == ' ') value_start++;
+		if (match_words(value_start, "auto", 4)) conf->write_mode = WRITE_AUTO;
+		else if (match_words(value_start, "uring", 5)) conf->write_mode = WRITE_URING;
+		else if (match_words(value_start, "stdio", 5)) conf->write_mode = WRITE_STDIO;
+		else if (match_words(value_start, "mmap", 4)) conf->write_mode = WRITE_MMAP;
+		else {
+			printf("Error: write_mode must be one of auto, uring, stdio or mmap" ENDL);
+			return 1;
+		}
+	}
 	else if (match_words(line->start, tile_w, sizeof(tile_w) - 1)){
 		conf->tile_width = atoi(value_start);
 	}
 	else if (match_words(line->start, tile_h, sizeof(tile_h) - 1)){
 		conf->tile_height = atoi(value_start);
 	}
+	else if (match_words(line->start, band_h, sizeof(band_h) - 1)){
+		conf->band_height = atoi(value_start);
+	}
+	else if (match_words(line->start, factor, sizeof(factor) - 1)){
+		int val = atoi(value_start);
+		if (val < 0 || val > UCHAR_MAX) {
+			printf("Error: downsample_factor goes from 1 to 255, zero is default" ENDL);
+			return 1;
+		}
+		conf->downsample_factor = val;
+	}
+	else if (match_words(line->start, filter, sizeof(filter) - 1)){
+		while(*value_start == ' ') value_start++;
+		switch (*value_start) {
+			case 'b':
+				// box or bilinear
+				conf->downsample_filter = value_start[1] == 'i' ? FILTER_BILINEAR : FILTER_BOX;
+				break;
+			case 'm':
+				// min or max
+				conf->downsample_filter = value_start[1] == 'a' ? FILTER_MAX : FILTER_MIN;
+				break;
+			default:
+				printf("Unrecognized downsample filter, fallback to box" ENDL);
+				conf->downsample_filter = FILTER_BOX;
+		}
+	}
+	else if (match_words(line->start, engine, sizeof(engine) - 1)){
+		while(*value_start == ' ') value_start++;
+		if (match_words(value_start, "float", 5)) conf->engine = ENGINE_FLOAT;
+		else if (match_words(value_start, "fixed", 5)) conf->engine = ENGINE_FIXED;
+		else {
+			printf("Error: engine must be float or fixed" ENDL);
+			return 1;
+		}
+	}
+	else if (match_words(line->start, pyramid, sizeof(pyramid) - 1)){
+		conf->pyramid_levels = atoi(value_start);
+	}
+	else if (match_words(line->start, threads, sizeof(threads) - 1)){
+		conf->threads = atoi(value_start);
+	}
+	else if (match_words(line->start, parse_threads, sizeof(parse_threads) - 1)){
+		conf->parse_threads = atoi(value_start);
+	}
+	else if (match_words(line->start, mem_limit, sizeof(mem_limit) - 1)){
+		// bytes, or K, M, G (powers of 1024), quoted or not
+		while(*value_start == ' ' || *value_start == '"') value_start++;
+		char *suffix;
+		long long val = strtoll(value_start, &suffix, 10);
+		int shift = 0;
+		switch (toupper((unsigned char) *suffix)) {
+			case 'K': shift = 10; break;
+			case 'M': shift = 20; break;
+			case 'G': shift = 30; break;
+			default: break;
+		}
+		if (suffix == value_start || val < 0 || val > (LLONG_MAX >> shift)) {
+			printf("Error: memory_limit must be a size in bytes, K, M or G" ENDL);
+			return 1;
+		}
+		conf->memory_limit = (int64_t) val << shift;
+	}
 	else if (match_words(line->start, eol, sizeof(eol) - 1)){
 		while(*value_start == ' ') value_start++;
 		switch (*value_start) {
@@ -299,6 +472,28 @@ int parse_config_file_line(const Segment* line, Config* conf){
 		memcpy(conf->dest, path_start, size);
 		conf->dest[size] = '\0';
 	}
+	else if (match_words(line->start, report, sizeof(report) - 1)){
+		char* first_quote = memchr(value_start, '"', MAX_SPACE_EQ_TO_VAL);
+		if (first_quote == NULL) {
+			printf("Error: first quotation mark around report_json path not found" ENDL);
+			return 1;
+		}
+		char *path_start = first_quote + 1;
+
+		char* second_quote = memchr(path_start, '"', MAXIMUM_PATH());
+		if (second_quote == NULL) {
+			printf("Error: second quotation mark around report_json path not found" ENDL);
+			return 1;
+		}
+
+		ptrdiff_t size = second_quote - path_start;
+		if (size + 1 >= MAXIMUM_PATH()) {
+			printf("Error: report_json path too long" ENDL);
+			return 1;
+		}
+		memcpy(conf->report_json, path_start, size);
+		conf->report_json[size] = '\0';
+	}
 	else {
 		const short ERR_MSG_LEN = 1000;
 		char* string = malloc(ERR_MSG_LEN);
@@ -0,0 +1,148 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <sys/resource.h>
+#endif
+
+#include "../include/band_writer.h"
+#include "../include/output_files.h"
+#include "../include/value_encoder.h"
+#include "../include/utils.h"
+
+int init_BandWriter(BandWriter *bw, const Config *conf, int32_t column_count, int32_t reserved) {
+	*bw = (BandWriter) {0};
+	bw->column_count = column_count;
+	bw->bands_per_tile_row = conf->tile_height / conf->band_height;
+	bw->tile_height = conf->tile_height;
+	bw->columns = (TileColumn *) calloc(column_count, sizeof(TileColumn));
+	if (bw->columns == NULL) return 1;
+
+	#if defined(__APPLE__) || defined(__LINUX__)
+	int64_t wanted = (int64_t) column_count + reserved;
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl)) {
+		printf("WARNING: could not read the open file limit (%s)" ENDL, strerror(errno));
+		rl.rlim_cur = rl.rlim_max = 0;
+	}
+	// raised as far as this run needs, and no further
+	if (rl.rlim_cur != RLIM_INFINITY && (rlim_t) wanted > rl.rlim_cur && rl.rlim_cur < rl.rlim_max) {
+		rlim_t previous = rl.rlim_cur;
+		rl.rlim_cur = rl.rlim_max == RLIM_INFINITY || (rlim_t) wanted < rl.rlim_max ? (rlim_t) wanted : rl.rlim_max;
+		if (setrlimit(RLIMIT_NOFILE, &rl)) {
+			printf("WARNING: could not raise the open file limit (%s)" ENDL, strerror(errno));
+			rl.rlim_cur = previous;
+		} else {
+			printf(
+				"WARNING: open file limit raised from %llu to %llu" ENDL,
+				(unsigned long long) previous, (unsigned long long) rl.rlim_cur
+			);
+		}
+	}
+	int64_t limit = rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > INT32_MAX ? INT32_MAX : (int64_t) rl.rlim_cur;
+	#else
+	int64_t limit = _getmaxstdio();
+	#endif
+	int64_t max_open = limit - reserved;
+	if (max_open < 0) max_open = 0;
+	bw->max_open = max_open < column_count ? (int32_t) max_open : column_count;
+	if (bw->max_open < column_count) {
+		printf(
+			"WARNING: only %d of the %d tiles of a row can stay open, the other ones are reopened for every band" ENDL,
+			bw->max_open, column_count
+		);
+	}
+	return 0;
+}
+
+void free_BandWriter(BandWriter *bw) {
+	free(bw->columns);
+	bw->columns = NULL;
+}
+
+/*! Writes the actual row count in the npy header of a tile of the last
+ *  row of tiles, which was written with tile_height rows.
+ */
+static void fix_band_tile_header(TileColumn *col, const char *path, int32_t row_length) {
+	char header[NPY_HEADER_SIZE];
+	write_npy_header(header, col->rows, row_length);
+
+	FILE *fp = col->fp != NULL ? col->fp : fopen(path, "rb+");
+	int err = fp == NULL || fseek(fp, 0, SEEK_SET) || fwrite(header, 1, NPY_HEADER_SIZE, fp) != NPY_HEADER_SIZE;
+	if (fp != NULL && fp != col->fp) err = fclose(fp) || err;
+
+	if (err) printf("error: could not write the npy header of %s" ENDL, path);
+}
+
+void append_band_to_files(BandWriter *bw, WriteBuffer *wr, const char *dir, int band, char last) {
+	int tile_row = band / bw->bands_per_tile_row;
+	char first = band % bw->bands_per_tile_row == 0;
+	if (first) {
+		memset(bw->columns, 0, bw->column_count * sizeof(TileColumn));
+	}
+	last = last || band % bw->bands_per_tile_row == bw->bands_per_tile_row - 1;
+
+	for (int i = 0; i < wr->file_buffer_count; i++) {
+		TileColumn *col = bw->columns + i;
+		FileBuffer *fb = wr->file_buffers + i;
+		char path[MAXIMUM_PATH()];
+		char header[NPY_HEADER_SIZE];
+		TileWrite t;
+
+		char too_long = tile_path(path, MAXIMUM_PATH(), dir, tile_row, i, wr->format);
+		fill_TileWrite(&t, wr, i, path, header);
+		if (col->failed) continue;
+
+		FILE *fp = col->fp;
+		if (too_long) {
+			t.open_error = ENAMETOOLONG;
+		} else if (fp == NULL) {
+			errno = 0;
+			fp = fopen(path, first ? "wb" : "ab");
+			if (fp == NULL) t.open_error = errno ? errno : EIO;
+			else if (i < bw->max_open) col->fp = fp;
+		}
+
+		if (fp != NULL) {
+			// the row count is only known for sure at the end of the row
+			if (first && t.header_size) {
+				write_npy_header(header, bw->tile_height, fb->row_length);
+			} else {
+				t.header = NULL;
+				t.header_size = 0;
+			}
+			fwrite_tile(fp, &t);
+			col->rows += fb->bytesize / fb->row_size;
+
+			if (fp != col->fp) {
+				errno = 0;
+				if (fclose(fp) && t.write_error == 0) t.write_error = errno ? errno : EIO;
+			}
+		}
+
+		report_tile_write(&t);
+		if (t.open_error || t.write_error || t.written != t.size || t.header_written != t.header_size) {
+			col->failed = 1;
+		}
+	}
+
+	if (!last) return;
+
+	// the paths fitted for every tile that did not fail
+	for (int i = 0; i < wr->file_buffer_count; i++) {
+		TileColumn *col = bw->columns + i;
+		if (wr->format == OUTPUT_NPY && !col->failed && col->rows != bw->tile_height) {
+			char path[MAXIMUM_PATH()];
+			tile_path(path, MAXIMUM_PATH(), dir, tile_row, i, wr->format);
+			fix_band_tile_header(col, path, wr->file_buffers[i].row_length);
+		}
+		if (col->fp != NULL && fclose(col->fp)) {
+			char path[MAXIMUM_PATH()];
+			tile_path(path, MAXIMUM_PATH(), dir, tile_row, i, wr->format);
+			printf("ERROR n°%d: %s while writing to file %s" ENDL, errno, strerror(errno), path);
+		}
+		col->fp = NULL;
+	}
+}
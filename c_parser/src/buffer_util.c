@@ -7,9 +7,14 @@
 #endif
 
 
+int32_t chunk_height(const Config *cf) {
+	return cf->band_height ? cf->band_height : cf->tile_height;
+}
+
 void init_ReadBufferStruct(ReadBuffer *rb, const RowLayout* row_lo, const Config* cf) {
-	rb->bytesize = row_lo->max_size * cf->tile_height * 2 * sizeof(char);
 	rb->page_bytesize = getpagesize();
+	// the read pointer can start anywhere in the first page
+	rb->bytesize = row_lo->max_size * chunk_height(cf) * cf->downsample_factor * sizeof(char) + rb->page_bytesize;
 	// calculate pagecount for mmap
 	// (X + Y - 1) / Y For rounding up instead of down
 	rb->page_count = (rb->bytesize + rb->page_bytesize - 1) / rb->page_bytesize;
@@ -17,15 +22,28 @@ void init_ReadBufferStruct(ReadBuffer *rb, const RowLayout* row_lo, const Config
 }
 
 void init_CompBufferStruct(CompBuffer *cb, const RowLayout *row_lo, const Config *cf) {
-	cb->row_length = row_lo->field_count;
-	cb->row_count = cf->tile_height * 2;
-	cb-> bytesize = cb->row_length * cb->row_count * sizeof(float);
+	cb->row_length = row_lo->window_fields;
+	cb->row_count = chunk_height(cf) * cf->downsample_factor;
+	cb-> bytesize = (int64_t) cb->row_length * cb->row_count * sizeof(float);
 	cb->start = NULL;
 }
 
+void init_ChunkIndexStruct(ChunkIndex *idx, const RowLayout *row_lo, const Config *cf) {
+	// the ends of the fields before the window are needed to find it
+	idx->row_length = row_lo->first_field + row_lo->window_fields;
+	idx->row_capacity = chunk_height(cf) * cf->downsample_factor;
+	idx->row_count = 0;
+	idx->bytesize = (int64_t) (idx->row_capacity + 1) * sizeof(int64_t)
+		+ (int64_t) idx->row_capacity * sizeof(int32_t)
+		+ (int64_t) idx->row_capacity * idx->row_length * sizeof(uint32_t);
+	idx->row_starts = NULL;
+	idx->row_fields = NULL;
+	idx->field_ends = NULL;
+}
+
 void init_ProcValBufferStruct(ProcValBuffer *pvb, const RowLayout *row_lo, const Config *cf) {
-	pvb->row_length = row_lo->field_count / 2;
-	pvb->row_count = cf->tile_height;
+	pvb->row_length = row_lo->window_fields / cf->downsample_factor;
+	pvb->row_count = chunk_height(cf);
 	pvb->bytesize = pvb->row_count * pvb->row_length * sizeof(float);
 	pvb->start = NULL;
 }
@@ -44,4 +62,6 @@ void init_FullFileBuffer(
 	ff->bytesize = row_count * ff->row_bytesize;
 	ff->row_count = row_count;
 	ff->eol_size = eol_size;
+	ff->map = NULL;
+	ff->map_size = 0;
 }
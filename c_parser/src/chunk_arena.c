@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../include/chunk_arena.h"
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <sys/mman.h>
+#endif
+
+/*! Allocates the memory of a new arena, as huge pages when possible. */
+static int alloc_arena_memory(ChunkArena *arena, int64_t bytesize) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	#if defined(MAP_HUGETLB)
+	// only when whole huge pages are used, and the pool of the system has
+	// enough of them, which it usually does not
+	if (bytesize >= HUGE_PAGE_SIZE) {
+		int64_t huge_size = (bytesize + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+		void *addr = mmap(
+			NULL, huge_size, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0
+		);
+		if (addr != MAP_FAILED) {
+			arena->start = (char *) addr;
+			arena->bytesize = huge_size;
+			arena->backing = ARENA_HUGETLB;
+			return 0;
+		}
+	}
+	#endif
+
+	void *addr = mmap(NULL, bytesize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) return 1;
+	arena->start = (char *) addr;
+	arena->bytesize = bytesize;
+	arena->backing = ARENA_PAGES;
+
+	#if defined(MADV_HUGEPAGE)
+	if (bytesize >= HUGE_PAGE_SIZE && madvise(addr, bytesize, MADV_HUGEPAGE) == 0) {
+		arena->backing = ARENA_HUGE_PAGES;
+	}
+	#endif
+	return 0;
+#else
+	arena->start = (char *) malloc(bytesize);
+	if (arena->start == NULL) return 1;
+	arena->bytesize = bytesize;
+	arena->backing = ARENA_MALLOC;
+	return 0;
+#endif
+}
+
+static void free_arena_memory(ChunkArena *arena) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	munmap(arena->start, arena->bytesize);
+#else
+	free(arena->start);
+#endif
+}
+
+int init_ArenaPool(ArenaPool *ap, int64_t arena_bytesize) {
+	*ap = (ArenaPool) {0};
+	ap->arena_bytesize = arena_bytesize > 0 ? arena_bytesize : 1;
+
+#if defined(__APPLE__) || defined(__LINUX__)
+	if (pthread_mutex_init(&ap->lock, NULL)) return 1;
+#endif
+	return 0;
+}
+
+ChunkArena *take_arena(ArenaPool *ap) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_lock(&ap->lock);
+#endif
+	ChunkArena *arena = ap->free_arenas;
+	if (arena != NULL) ap->free_arenas = arena->next;
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_unlock(&ap->lock);
+#endif
+	if (arena != NULL) {
+		arena->next = NULL;
+		return arena;
+	}
+
+	// allocated outside of the lock, they are big
+	arena = (ChunkArena *) calloc(1, sizeof(ChunkArena));
+	if (arena == NULL) return NULL;
+	if (alloc_arena_memory(arena, ap->arena_bytesize)) {
+		free(arena);
+		return NULL;
+	}
+
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_lock(&ap->lock);
+#endif
+	ap->arena_count++;
+	ap->backing = arena->backing;
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_unlock(&ap->lock);
+#endif
+	return arena;
+}
+
+void give_back_arena(ArenaPool *ap, ChunkArena *arena) {
+	if (arena == NULL) return;
+
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_lock(&ap->lock);
+#endif
+	arena->next = ap->free_arenas;
+	ap->free_arenas = arena;
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_unlock(&ap->lock);
+#endif
+}
+
+char *carve_arena(ChunkArena *arena, int64_t *used, int64_t size) {
+	int64_t offset = (*used + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+	if (size < 0 || offset + size > arena->bytesize) return NULL;
+	*used = offset + size;
+	return arena->start + offset;
+}
+
+void free_ArenaPool(ArenaPool *ap) {
+	while (ap->free_arenas != NULL) {
+		ChunkArena *arena = ap->free_arenas;
+		ap->free_arenas = arena->next;
+		free_arena_memory(arena);
+		free(arena);
+	}
+	ap->arena_count = 0;
+
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_destroy(&ap->lock);
+#endif
+}
@@ -0,0 +1,87 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/field_formatter.h"
+
+static int format_fallback(char *dst, int width, float value) {
+	char tmp[FORMAT_FALLBACK_SIZE];
+	int count = snprintf(tmp, FORMAT_FALLBACK_SIZE, "%0*.3f", width, value);
+	memcpy(dst, tmp, width);
+	return count;
+}
+
+/*! Writes `thousandths` / 1000 with 3 decimals, zero padded to `width`
+ *  characters like snprintf "%0*.3f" would.
+ */
+static int write_thousandths(char *dst, int width, char negative, uint64_t thousandths) {
+	// digits are written backward, the fractional part first
+	char digits[24];
+	char *d = digits + sizeof(digits);
+	uint64_t integer = thousandths / 1000;
+	uint32_t frac = (uint32_t) (thousandths % 1000);
+
+	*--d = '0' + frac % 10;
+	*--d = '0' + frac / 10 % 10;
+	*--d = '0' + frac / 100;
+	*--d = '.';
+	do {
+		*--d = '0' + integer % 10;
+		integer /= 10;
+	} while (integer);
+
+	int length = (int) (digits + sizeof(digits) - d);
+	int count = length + negative;
+	int padding = width - count;
+
+	if (padding >= 0) {
+		char *out = dst;
+		if (negative) *out++ = '-';
+		memset(out, '0', padding);
+		memcpy(out + padding, d, length);
+		return width;
+	}
+
+	// too long: keep the first `width` characters, as snprintf would
+	*--d = '-';
+	memcpy(dst, d + !negative, width);
+	return count;
+}
+
+int format_field(char *dst, int width, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(float));
+
+	char negative = bits >> 31;
+	int32_t exponent = (bits >> 23) & 0xFF;
+	uint64_t mantissa = bits & 0x7FFFFF;
+
+	// inf, nan and values >= 2^23 (no fractional bits): rare enough
+	if (exponent >= 150) return format_fallback(dst, width, value);
+
+	if (exponent == 0) exponent = 1; // subnormal
+	else mantissa |= 0x800000;
+
+	// value = mantissa / 2^shift, so value * 1000 = scaled / 2^shift
+	int32_t shift = 150 - exponent;
+	uint64_t scaled = mantissa * 1000; // < 2^34
+	uint64_t thousandths = 0;
+
+	// beyond 63 bits of shift, value * 1000 < 1/2 and rounds to 0
+	if (shift < 64) {
+		uint64_t half = (uint64_t) 1 << (shift - 1);
+		uint64_t rest = scaled & ((half << 1) - 1);
+		thousandths = scaled >> shift;
+		// round half to even
+		thousandths += rest > half || (rest == half && (thousandths & 1));
+	}
+
+	return write_thousandths(dst, width, negative, thousandths);
+}
+
+int format_fixed_field(char *dst, int width, int32_t thousandths) {
+	char negative = thousandths < 0;
+	// through 64 bits, -INT32_MIN does not fit 32
+	uint64_t magnitude = negative ? (uint64_t) -(int64_t) thousandths : (uint64_t) thousandths;
+	return write_thousandths(dst, width, negative, magnitude);
+}
@@ -0,0 +1,170 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/field_parser.h"
+
+// Every power of ten below is exactly representable as a float.
+static const float POW10[FAST_FIELD_MAX_DECIMALS + 1] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+/*  Fast path (Clinger's): when both the mantissa and the power of ten are
+ *  exact floats, a single IEEE division is correctly rounded, which is
+ *  exactly what strtof has to return. Evaluating the division in a wider
+ *  type (FLT_EVAL_METHOD != 0) is harmless since the wider type has more
+ *  than 2*24+2 bits of precision.
+ *
+ *  Everything else is rare in our files and is delegated to strtof, so the
+ *  results stay bit-identical whatever the input.
+ */
+static int parse_fast(const char *start, int max_size, float *value, const char **end) {
+	const char *p = start;
+	const char *limit = start + max_size;
+
+	char negative = 0;
+	uint32_t mantissa = 0;
+	int digits = 0;
+	int decimals = 0;
+
+	if (p < limit && *p == '-') {
+		negative = 1;
+		p++;
+	}
+
+	for (; p < limit && (unsigned char) (*p - '0') < 10; p++) {
+		mantissa = mantissa * 10 + (*p - '0');
+		digits++;
+		if (digits > 9) return 1; // mantissa would overflow 32 bits
+	}
+
+	if (p < limit && *p == '.') {
+		p++;
+		for (; p < limit && (unsigned char) (*p - '0') < 10; p++) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits++;
+			decimals++;
+			if (digits > 9) return 1;
+		}
+	}
+
+	if (digits == 0) return 1; // "", "-", ".", "inf", "nan", " 1"...
+
+	// at max_size the field ended cleanly, the byte after it is not ours
+	if (p < limit) switch (*p) {
+		// written in a format strtof understands but that we don't
+		// (1e3, 0x1p3), or not a number at all (1.2.3)
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+		case '.': case 'e': case 'E': case 'x': case 'X':
+			return 1;
+		default:
+			break;
+	}
+
+	if (mantissa > FAST_FIELD_MAX_MANTISSA || decimals > FAST_FIELD_MAX_DECIMALS) {
+		return 1;
+	}
+
+	float v = (float) mantissa / POW10[decimals];
+	*value = negative ? -v : v;
+	*end = p;
+	return 0;
+}
+
+/*! Copies the field to `dst`, nul-terminated, so that strtof and strtod
+ *  stop at its end even when nothing readable follows it.
+ */
+static void copy_field(char dst[FIELD_COPY_SIZE], const char *start, int max_size) {
+	int size = max_size < FIELD_COPY_SIZE ? max_size : FIELD_COPY_SIZE - 1;
+	if (size < 0) size = 0;
+	memcpy(dst, start, (size_t) size);
+	dst[size] = '\0';
+}
+
+float parse_field(const char *start, int max_size, char **end) {
+	float value;
+	const char *fend;
+
+	if (parse_fast(start, max_size, &value, &fend) == 0) {
+		*end = (char *) fend;
+		return value;
+	}
+
+	char copy[FIELD_COPY_SIZE];
+	char *copy_end;
+	copy_field(copy, start, max_size);
+	value = strtof(copy, &copy_end);
+	*end = (char *) start + (copy_end - copy);
+	return value;
+}
+
+static int parse_fixed_fast(const char *start, int max_size, int32_t *value, const char **end) {
+	const char *p = start;
+	const char *limit = start + max_size;
+
+	char negative = 0;
+	int64_t thousandths = 0;
+	int digits = 0;
+	int decimals = 0;
+
+	if (p < limit && *p == '-') {
+		negative = 1;
+		p++;
+	}
+
+	for (; p < limit && (unsigned char) (*p - '0') < 10; p++) {
+		thousandths = thousandths * 10 + (*p - '0');
+		digits++;
+		if (digits > 7) return 1; // beyond 2147483.647
+	}
+
+	if (p < limit && *p == '.') {
+		p++;
+		for (; p < limit && (unsigned char) (*p - '0') < 10; p++) {
+			if (decimals < 3) thousandths = thousandths * 10 + (*p - '0');
+			// the first digit dropped is enough to round half away
+			else if (decimals == 3) thousandths += *p >= '5';
+			digits++;
+			decimals++;
+		}
+	}
+
+	if (digits == 0) return 1;
+
+	if (p < limit) switch (*p) {
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+		case '.': case 'e': case 'E': case 'x': case 'X':
+			return 1;
+		default:
+			break;
+	}
+
+	for (; decimals < 3; decimals++) thousandths *= 10;
+	if (thousandths > INT32_MAX) return 1;
+
+	*value = (int32_t) (negative ? -thousandths : thousandths);
+	*end = p;
+	return 0;
+}
+
+int32_t parse_fixed_field(const char *start, int max_size, char **end) {
+	int32_t value;
+	const char *fend;
+
+	if (parse_fixed_fast(start, max_size, &value, &fend) == 0) {
+		*end = (char *) fend;
+		return value;
+	}
+
+	char copy[FIELD_COPY_SIZE];
+	char *copy_end;
+	copy_field(copy, start, max_size);
+	double scaled = strtod(copy, &copy_end) * 1000.0;
+	*end = (char *) start + (copy_end - copy);
+	if (scaled != scaled) return 0;
+	if (scaled >= INT32_MAX) return INT32_MAX;
+	if (scaled <= INT32_MIN) return INT32_MIN;
+	return (int32_t) (scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
@@ -10,6 +10,7 @@
 #endif
 
 #include "../include/file_identificator.h"
+#include "../include/scanner.h"
 #include "../include/utils.h"
 
 #define L1_BUFF_SIZE 1000000
@@ -29,25 +30,29 @@ int print_RowInfo(RowInfo* ri_p) {
 int identify_line(RowInfo* info, int64_t max_line_len) {
 	if (max_line_len > MAX_LINE_SIZE) max_line_len = MAX_LINE_SIZE;
 	info->eol_flag = EOL_AUTO;
-	int32_t counter = 1; // Always at least 1 field in a row, even if empty
-	char* i;
-	for (i=info->string ; (i < info->string + max_line_len); ++i){
-		counter += (*i == ',');
-		if (*i == '\n'){
-			// printf("last char values = [%hhu, %hhu, %hhu]" ENDL, i[-1], i[0], i[1]);
-			info->eol_flag = (*(i - 1) == '\r') ? EOL_DOS : EOL_UNIX;
-			break;
-		}
+
+	// only counting, the offsets of the separators are not needed here
+	const char *eol = NULL;
+	const char *limit = info->string + max_line_len;
+	int64_t hits = scan_row(info->string, limit, NULL, 0, &eol);
+
+	int32_t counter;
+	const char *last;
+	if (eol != NULL) {
+		info->eol_flag = (eol > info->string && eol[-1] == '\r') ? EOL_DOS : EOL_UNIX;
+		counter = hits; // commas + 1 for the eol
+		last = eol;
+	} else {
+		counter = hits + 1; // Always at least 1 field in a row, even if empty
+		last = limit;
 	}
-	// if the last char was '\n', `i - info->counter` would equal 0, but there
-	// would be 1 char, hence the `+1`.
-	ptrdiff_t length = i - info->string + 1;
+	// if the last char was '\n', `last - info->string` would equal 0, but
+	// there would be 1 char, hence the `+1`.
+	ptrdiff_t length = last - info->string + 1;
 	if (length > INT32_MAX) return 1;
 	info->length = length;
-	// printf("line length is %d" ENDL, info->length);
 	info->count = counter;
-	if (info->length < 0) return 1;
-	else return 0;
+	return 0;
 }
 
 #if defined(__APPLE__) || defined(__LINUX__)
@@ -0,0 +1,265 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+#include "../include/full_file.h"
+#include "../include/buffer_util.h"
+#include "../include/output_files.h"
+#include "../include/value_encoder.h"
+#include "../include/utils.h"
+
+/*! Writes `ff->bytesize` bytes of `ff` at `offset` of the full file.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+static int write_full_bytes(const FullFile *full, const FullFileBuffer *ff, int64_t offset) {
+	const char *src = ff->buffer;
+	int64_t left = ff->bytesize;
+
+	#ifdef _WIN32
+	if (_fseeki64(full->fp, offset, SEEK_SET)) return errno ? errno : EIO;
+	errno = 0;
+	if (fwrite(src, 1, left, full->fp) != (size_t) left) return errno ? errno : EIO;
+	#else
+	while (left > 0) {
+		ssize_t written = pwrite(full->fd, src, (size_t) left, (off_t) offset);
+		if (written < 0 && errno == EINTR) continue;
+		if (written < 0) return errno;
+		if (written == 0) return EIO;
+
+		src += written;
+		left -= written;
+		offset += written;
+	}
+	#endif
+	return 0;
+}
+
+Full_file_status open_FullFile(
+	FullFile *full,
+	const char *dir,
+	const Config *conf,
+	const RowLayout *row_lo,
+	int32_t row_length,
+	int32_t rows_per_chunk,
+	int64_t max_rows,
+	int64_t kept_rows
+) {
+	*full = (FullFile) {0};
+	#ifdef _WIN32
+	full->fp = NULL;
+	#else
+	full->fd = -1;
+	#endif
+	full->format = conf->output_format;
+	full->row_length = row_length;
+	full->rows_per_chunk = rows_per_chunk;
+	full->data_offset = conf->output_format == OUTPUT_NPY ? NPY_HEADER_SIZE : 0;
+
+	// same row size as the FullFileBuffers of alloc_output_buffers
+	char binary = conf->output_format != OUTPUT_CSV;
+	short field_size = conf->output_field_size;
+	if (binary) field_size = conf->output_format == OUTPUT_F16 ? sizeof(uint16_t) : sizeof(float);
+	FullFileBuffer shape;
+	init_FullFileBuffer(
+		&shape, row_length, 0, field_size,
+		binary ? 0 : row_lo->sep_size,
+		binary ? 0 : row_lo->eol_size
+	);
+	full->row_bytesize = shape.row_bytesize;
+
+	int char_count =
+		snprintf(full->path, MAXIMUM_PATH(), "%s/resized_full.%s", dir, output_extension(conf->output_format));
+	if (char_count < 0 || char_count >= MAXIMUM_PATH()) {
+		printf("error: the path of the full file of %s is too long" ENDL, dir);
+		return FULL_FILE_FAILED;
+	}
+
+	errno = 0;
+	#ifdef _WIN32
+	full->fp = fopen(full->path, kept_rows ? "rb+" : "wb+");
+	char opened = full->fp != NULL;
+	#else
+	// read access is needed to map it
+	full->fd = open(full->path, kept_rows ? O_RDWR : O_RDWR|O_CREAT|O_TRUNC, 0666);
+	char opened = full->fd >= 0;
+	#endif
+	int err = errno;
+
+	if (!opened) {
+		printf("an error occured while opening an output file" ENDL);
+		printf("path: %s" ENDL, full->path);
+
+		output_fullfile_open_print_err(err);
+		full->failed = 1;
+		return FULL_FILE_NOT_CREATED;
+	}
+
+	// what the interrupted run wrote past its last commit is dropped
+	int64_t kept_size = full->data_offset + kept_rows * full->row_bytesize;
+	if (kept_rows) {
+		#ifdef _WIN32
+		char shorter = _fseeki64(full->fp, 0, SEEK_END) || _ftelli64(full->fp) < kept_size;
+		err = shorter ? 0 : _chsize_s(_fileno(full->fp), kept_size);
+		#else
+		struct stat st;
+		char shorter = fstat(full->fd, &st) || st.st_size < kept_size;
+		err = shorter || ftruncate(full->fd, (off_t) kept_size) == 0 ? 0 : errno;
+		#endif
+		if (shorter) {
+			printf("error: %s holds less than the %lld rows of the journal" ENDL, full->path, (long long) kept_rows);
+			return FULL_FILE_MISMATCH;
+		}
+		if (err) {
+			printf("ERROR n°%d: %s while cutting %s back to the journal" ENDL, err, strerror(err), full->path);
+			return FULL_FILE_FAILED;
+		}
+		full->rows = kept_rows;
+	}
+
+	#if defined(__APPLE__) || defined(__LINUX__)
+	if (pthread_mutex_init(&full->grow_lock, NULL)) {
+		printf("error: could not initialize the lock of %s" ENDL, full->path);
+		return FULL_FILE_FAILED;
+	}
+	full->size = kept_size;
+	#endif
+
+	#if defined(__LINUX__)
+	// the extra room is given back by close_FullFile
+	int64_t size = full->data_offset + max_rows * full->row_bytesize;
+	err = posix_fallocate(full->fd, 0, (off_t) size);
+	if (err) printf("WARNING: could not preallocate %s (%s)" ENDL, full->path, strerror(err));
+	else full->size = size;
+	#else
+	(void) max_rows;
+	#endif
+
+	// the row count of the header is set by close_FullFile
+	if (full->format == OUTPUT_NPY) {
+		char header[NPY_HEADER_SIZE];
+		write_npy_header(header, 0, row_length);
+		FullFileBuffer header_rows = {.buffer = header, .bytesize = NPY_HEADER_SIZE};
+		if (write_full_bytes(full, &header_rows, 0)) {
+			printf("error: could not write the npy header of %s" ENDL, full->path);
+			full->failed = 1;
+		}
+	}
+	return FULL_FILE_OPEN;
+}
+
+int write_full_rows(const FullFile *full, const FullFileBuffer *ff, int32_t chunk) {
+	#ifdef _WIN32
+	if (full->fp == NULL) return 0;
+	#else
+	if (full->fd < 0) return 0;
+	#endif
+	int64_t first_row = (int64_t) chunk * full->rows_per_chunk;
+	return write_full_bytes(full, ff, full->data_offset + first_row * full->row_bytesize);
+}
+
+void account_full_rows(FullFile *full, const FullFileBuffer *ff, int err) {
+	if (full->failed) return;
+	if (err) {
+		printf(
+			"ERROR n°%d: %s while writing to file %s" ENDL,
+			err, strerror(err), full->path
+		);
+		full->failed = 1;
+		return;
+	}
+	full->rows += ff->row_count;
+}
+
+int sync_FullFile(FullFile *full) {
+	#ifdef _WIN32
+	if (full->fp == NULL || full->failed) return 0;
+	if (fflush(full->fp) || _commit(_fileno(full->fp))) return errno ? errno : EIO;
+	#elif defined(__LINUX__)
+	if (full->fd < 0 || full->failed) return 0;
+	if (fdatasync(full->fd)) return errno ? errno : EIO;
+	#else
+	if (full->fd < 0 || full->failed) return 0;
+	if (fsync(full->fd)) return errno ? errno : EIO;
+	#endif
+	return 0;
+}
+
+int close_FullFile(FullFile *full) {
+	#ifdef _WIN32
+	if (full->fp == NULL) return 1;
+	#else
+	if (full->fd < 0) return 1;
+	#endif
+
+	int err = 0;
+	if (!full->failed) {
+		int64_t size = full->data_offset + full->rows * full->row_bytesize;
+		#ifdef _WIN32
+		err = fflush(full->fp) || _chsize_s(_fileno(full->fp), size);
+		#else
+		err = ftruncate(full->fd, (off_t) size);
+		#endif
+
+		if (full->format == OUTPUT_NPY) {
+			char header[NPY_HEADER_SIZE];
+			write_npy_header(header, full->rows, full->row_length);
+			FullFileBuffer header_rows = {.buffer = header, .bytesize = NPY_HEADER_SIZE};
+			err = write_full_bytes(full, &header_rows, 0) || err;
+		}
+		if (err) printf("could not finish %s" ENDL, full->path);
+	}
+
+	#ifdef _WIN32
+	err = fclose(full->fp) || err;
+	full->fp = NULL;
+	#else
+	err = close(full->fd) || err;
+	full->fd = -1;
+	pthread_mutex_destroy(&full->grow_lock);
+	#endif
+	return err;
+}
+
+int map_full_rows(FullFile *full, FullFileBuffer *ff, int32_t chunk) {
+	#if defined(__APPLE__) || defined(__LINUX__)
+	if (full->fd < 0 || ff->bytesize == 0) return EINVAL;
+
+	int64_t offset = full->data_offset + (int64_t) chunk * full->rows_per_chunk * full->row_bytesize;
+	int64_t end = offset + ff->bytesize;
+	int64_t map_start = offset - offset % sysconf(_SC_PAGESIZE);
+
+	// only ever grows, the rows of other chunks may be mapped already
+	int err = 0;
+	pthread_mutex_lock(&full->grow_lock);
+	if (end > full->size) {
+		if (ftruncate(full->fd, (off_t) end)) err = errno;
+		else full->size = end;
+	}
+	pthread_mutex_unlock(&full->grow_lock);
+	if (err) return err;
+
+	void *addr = mmap(NULL, end - map_start, PROT_READ|PROT_WRITE, MAP_SHARED, full->fd, (off_t) map_start);
+	if (addr == MAP_FAILED) return errno;
+
+	ff->map = (char *) addr;
+	ff->map_size = end - map_start;
+	ff->buffer = ff->map + (offset - map_start);
+	return 0;
+	#else
+	(void) full;
+	(void) ff;
+	(void) chunk;
+	return ENOSYS;
+	#endif
+}
@@ -0,0 +1,202 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/output_files.h"
+#include "../include/value_encoder.h"
+#include "../include/utils.h"
+
+const char *output_extension(Output_format format) {
+	switch (format) {
+		case OUTPUT_F32: return "f32";
+		case OUTPUT_F16: return "f16";
+		case OUTPUT_NPY: return "npy";
+		case OUTPUT_CSV:
+		default: return "csv";
+	}
+}
+
+void output_open_print_err(int err) {
+	switch (err) {
+		case EACCES:
+			printf("Writing autorization to file denied" ENDL);
+			break;
+
+		case EMFILE:
+#if !_WIN32
+		case EDQUOT:
+#endif
+		case ENOSPC:
+			printf("Out of disk quota, too many inodes, or too many files opened" ENDL);
+			break;
+
+		case EEXIST:
+			printf("file already exists!!!" ENDL);
+			break;
+
+		case EAGAIN:
+		case EISDIR:
+		case ENXIO:
+		case EOPNOTSUPP:
+		case EROFS:
+		case ETXTBSY:
+			printf("file is not writable!!!" ENDL);
+			break;
+
+		case EINTR:
+			printf("Interrupted by a signal" ENDL);
+			break;
+
+		case ELOOP:
+			printf("Too many symlinks" ENDL);
+			break;
+
+		case ENAMETOOLONG:
+			printf("path element too long" ENDL);
+			break;
+
+		case ENOTDIR:
+			printf("one of the elements in the path may not be a dir" ENDL);
+			break;
+
+		case EILSEQ:
+		case EBADF:
+		case EOVERFLOW:
+		case EDEADLK:
+		case ENOENT:
+		case EFAULT:
+		case EINVAL:
+		case EIO:
+		default:
+			printf("Unexpected error n°%d: %s" ENDL, err, strerror(err));
+			break;
+	}
+}
+
+void output_fullfile_open_print_err(int err) {
+	switch (err) {
+		case EACCES:
+			printf("Writing autorization to file denied" ENDL);
+			break;
+
+		case EMFILE:
+		#if !_WIN32
+		case EDQUOT:
+		#endif
+		case ENOSPC:
+			printf("Out of disk quota, too many inodes, or too many files opened" ENDL);
+			break;
+
+		case EAGAIN:
+		case EISDIR:
+		case ENXIO:
+		case EOPNOTSUPP:
+		case EROFS:
+		case ETXTBSY:
+			printf("file is not writable!!!" ENDL);
+			break;
+
+		case EINTR:
+			printf("Interrupted by a signal" ENDL);
+			break;
+
+		case ELOOP:
+			printf("Too many symlinks" ENDL);
+			break;
+
+		case ENAMETOOLONG:
+			printf("path element too long" ENDL);
+			break;
+
+		case ENOTDIR:
+			printf("one of the elements in the path may not be a dir" ENDL);
+			break;
+
+		case EEXIST:
+		case EILSEQ:
+		case EBADF:
+		case EOVERFLOW:
+		case EDEADLK:
+		case ENOENT:
+		case EFAULT:
+		case EINVAL:
+		case EIO:
+		default:
+			printf("Unexpected error n°%d: %s" ENDL, err, strerror(err));
+			break;
+	}
+}
+
+int tile_path(char *dst, size_t size, const char *dir, int tile_row, int col, Output_format format) {
+	int char_count =
+		snprintf(dst, size, "%s/row%.3d_col%.3d.%s", dir, tile_row, col, output_extension(format));
+	return char_count < 0 || (size_t) char_count >= size || char_count >= MAXIMUM_PATH();
+}
+
+void fill_TileWrite(TileWrite *t, const WriteBuffer *wr, int col, const char *path, char *header) {
+	FileBuffer *fb = wr->file_buffers + col;
+	*t = (TileWrite) {0};
+	t->path = path;
+	t->data = fb->buffer;
+	t->size = fb->bytesize;
+
+	if (wr->format == OUTPUT_NPY) {
+		write_npy_header(header, fb->bytesize / fb->row_size, fb->row_length);
+		t->header = header;
+		t->header_size = NPY_HEADER_SIZE;
+	}
+}
+
+void fwrite_tile(FILE *fp, TileWrite *t) {
+	if (t->header_size) t->header_written = fwrite(t->header, 1, t->header_size, fp);
+
+	errno = 0;
+	t->written = fwrite(t->data, 1, t->size, fp);
+	if (t->written != t->size) t->write_error = errno;
+}
+
+void write_tile_stdio(TileWrite *t) {
+	errno = 0;
+	FILE *fp = fopen(t->path, "wb");
+	if (fp == NULL) {
+		t->open_error = errno ? errno : EIO;
+		return;
+	}
+
+	fwrite_tile(fp, t);
+
+	errno = 0;
+	if (fclose(fp) && t->write_error == 0) t->write_error = errno ? errno : EIO;
+}
+
+void report_tile_write(const TileWrite *t) {
+	if (t->open_error) {
+		printf("an error occured while opening an output file" ENDL);
+		printf("path: %s" ENDL, t->path);
+
+		output_open_print_err(t->open_error);
+
+		printf("skipping..." ENDL);
+		return;
+	}
+
+	if (t->header_written != t->header_size) {
+		printf("error: could not write the npy header of %s" ENDL, t->path);
+	}
+
+	if (t->write_error) {
+		printf(
+			"ERROR n°%d: %s while writing to file %s" ENDL,
+			t->write_error, strerror(t->write_error), t->path
+		);
+	}
+	else if (t->written != t->size) {
+		printf(
+			"error: discrepancy between buffer size and number of bytes"
+			"written... : expected %llu, wrote %lld" ENDL,
+			(long long unsigned) t->size,
+			(long long) t->written
+		);
+	}
+}
@@ -13,19 +13,36 @@
 #include <unistd.h>
 #include <sysexits.h>
 #include <sys/mman.h>
+#include <pthread.h>
 #elif defined(_WIN32)
 #define _CRT_SECURE_NO_WARNINGS 1
+#include <io.h>
 #include <windows.h>
 #include "../include/win_err_status_numbers.h"
 #endif
 
 #include "../include/file_identificator.h"
+#include "../include/field_parser.h"
+#include "../include/field_formatter.h"
+#include "../include/value_encoder.h"
+#include "../include/scanner.h"
+#include "../include/subsample.h"
 #include "../include/arg_parse.h"
 #include "../include/buffer_util.h"
+#include "../include/output_files.h"
+#include "../include/full_file.h"
+#include "../include/band_writer.h"
+#include "../include/pyramid.h"
+#include "../include/parser_stages.h"
+#include "../include/run_report.h"
+#include "../include/resume_journal.h"
+#include "../include/resume_tiles.h"
+#include "../include/value_cache.h"
 #include "../include/utils.h"
 
 #define SMALL_ERR_MSG_SIZE 100 // Arbitrary value
 #define PARSING_ERR_LIMIT 5
+#define MAX_PARSE_THREADS 256
 
 #define USAGE "Usage: benchmark [config path]" ENDL
 
@@ -61,6 +78,21 @@ FILE *input_fp = NULL;
 static int input_fd = -1;
 #endif
 static void* comp_buff_ptr = NULL;
+static void* chunk_index_ptr = NULL;
+
+// set when the tiles are written with io_uring, see write_buffers_to_files
+static TileWriter tile_writer;
+static char tile_writer_ready = 0;
+// the row of tiles io_uring is writing
+static TileBatch tile_batch = {0};
+// with band_height, tiles are appended to band after band
+static BandWriter band_writer = {0};
+// the output buffers of the chunks, reused from one chunk to the next
+static ArenaPool chunk_arenas;
+// stage times and volumes, printed at the end of the run
+static RunReport run_report;
+// with resume, where the output is complete, see commit_written_chunk
+static ResumeJournal journal;
 
 // ============================= ATEXIT FUNCTIONS =============================
 #ifdef _WIN32
@@ -77,6 +109,10 @@ void free_comp_buff(void){
 	free(comp_buff_ptr);
 }
 
+void free_chunk_index(void){
+	free(chunk_index_ptr);
+}
+
 // ================================= THE REST =================================
 #ifdef _WIN32
 void print_file_attributes(ULONG attrs) {
@@ -223,7 +259,7 @@ int parse_readbuffer_line(char* start, char** end, ParserConfig* conf, float* ou
 		fend = current;
 
 		errno = 0;
-		outptr[count] = strtof(current, &fend);
+		outptr[count] = parse_field(current, conf->field.max, &fend);
 		int errval = errno;
 
 		if (errval) errcount += 1;
@@ -294,6 +330,9 @@ int init_RowLayout(RowLayout *rl, const RowInfo *ri, const Config *cf) {
 	rl->max_field_size = cf->max_field_size;
 	rl->min_field_size = cf->min_field_size;
 	rl->field_count = ri->count;
+	rl->first_field = 0;
+	rl->window_fields = ri->count;
+	rl->engine = cf->engine;
 	rl->max_size = ((int64_t) cf->max_field_size + rl->sep_size) * ri->count - rl->sep_size + rl->eol_size;
 	return 0;
 }
@@ -312,25 +351,57 @@ int init_CompBuffer(CompBuffer *cb, const RowLayout *row_lo, const Config *cf) {
 	}
 }
 
-int init_WriteBufferStruct(WriteBuffer* wb, ProcValBuffer* pvb, Config* conf){
+int init_ChunkIndex(ChunkIndex *idx, const RowLayout *row_lo, const Config *cf) {
+	init_ChunkIndexStruct(idx, row_lo, cf);
+	char *mem = (char *) malloc(idx->bytesize);
+	if (mem == NULL) {
+		printf("couldn't allocate memory for the chunk index" ENDL);
+		print_size_info(idx->bytesize);
+		return 1;
+	}
+	chunk_index_ptr = mem;
+	if (atexit(free_chunk_index)) die("could not set chunk index auto exit", EX_OSERR);
+
+	idx->row_starts = (int64_t *) mem;
+	mem += (idx->row_capacity + 1) * sizeof(int64_t);
+	idx->row_fields = (int32_t *) mem;
+	mem += idx->row_capacity * sizeof(int32_t);
+	idx->field_ends = (uint32_t *) mem;
+	return 0;
+}
+
+/*! Describes the tiles of the values of `pvb`. The array of FileBuffers
+ *  is carved from `wb->arena`, past `*arena_used`, the buffers are not.
+ */
+int init_WriteBufferStruct(WriteBuffer* wb, ProcValBuffer* pvb, const Config* conf, int64_t *arena_used){
 	//sizes of different elements
 	char sep = 1;
-	int stride = conf->output_field_size + sep;
+	short field_size = conf->output_field_size;
 	char eol = conf->eol_flag == EOL_UNIX ? 1 : 2;
 
+	// binary values are packed, rows are implicit
+	if (conf->output_format != OUTPUT_CSV) {
+		sep = 0;
+		eol = 0;
+		field_size = conf->output_format == OUTPUT_F16 ? sizeof(uint16_t) : sizeof(float);
+	}
+	int stride = field_size + sep;
+
 	// we don't malloc the whole buffer
 	wb->buffer = NULL;
 
-	// but we malloc the array of FileBuffers (not actual buffers)
+	// but we carve the array of FileBuffers (not actual buffers)
 	div_t qr = div(pvb->row_length, conf->tile_width);
 	int file_count = qr.quot + (qr.rem ? 1 : 0);
-	wb->file_buffers = (FileBuffer *) malloc(file_count * sizeof(FileBuffer));
+	wb->file_buffers = (FileBuffer *) carve_arena(wb->arena, arena_used, file_count * sizeof(FileBuffer));
 	if (wb->file_buffers == NULL) return 1;
 
 	//some data
 	wb->file_buffer_count = file_count;
+	wb->format = conf->output_format;
+	wb->engine = conf->engine;
 	wb->sep_size = sep;
-	wb->field_size = conf->output_field_size;
+	wb->field_size = field_size;
 	wb->eol_size = eol;
 
 	//initializing the structs inside
@@ -338,7 +409,9 @@ int init_WriteBufferStruct(WriteBuffer* wb, ProcValBuffer* pvb, Config* conf){
 	for (int i = 0; i < file_count; i++) {
 		FileBuffer *fb = wb->file_buffers + i;
 		fb->buffer = NULL;
-		fb->row_length = (i != file_count - 1) ? conf->tile_width : qr.rem;
+		fb->map = NULL;
+		fb->map_size = 0;
+		fb->row_length = (i != file_count - 1 || qr.rem == 0) ? conf->tile_width : qr.rem;
 		fb->row_size = fb->row_length * stride - sep + eol;
 		fb->bytesize = (int64_t) fb->row_size * pvb->row_count;
 		wb->bytesize += fb->bytesize;
@@ -607,405 +680,386 @@ void handle_dest_dir_check(DirCheckError err) {
 	}
 }
 
-void output_open_print_err(int err) {
-	switch (err) {
-		case EACCES:
-			printf("Writing autorization to file denied" ENDL);
-			break;
-
-		case EMFILE:
-#if !_WIN32
-		case EDQUOT:
-#endif
-		case ENOSPC:
-			printf("Out of disk quota, too many inodes, or too many files opened" ENDL);
-			break;
-
-		case EEXIST:
-			printf("file already exists!!!" ENDL);
-			break;
-
-		case EAGAIN:
-		case EISDIR:
-		case ENXIO:
-		case EOPNOTSUPP:
-		case EROFS:
-		case ETXTBSY:
-			printf("file is not writable!!!" ENDL);
-			break;
-
-		case EINTR:
-			printf("Interrupted by a signal" ENDL);
-			break;
-
-		case ELOOP:
-			printf("Too many symlinks" ENDL);
-			break;
-
-		case ENAMETOOLONG:
-			printf("path element too long" ENDL);
-			break;
-
-		case ENOTDIR:
-			printf("one of the elements in the path may not be a dir" ENDL);
-			break;
-
-		case EILSEQ:
-		case EBADF:
-		case EOVERFLOW:
-		case EDEADLK:
-		case ENOENT:
-		case EFAULT:
-		case EINVAL:
-		case EIO:
-		default:
-			printf("Unexpected error n°%d: %s" ENDL, err, strerror(err));
-			break;
-	}
-}
-
-void output_fullfile_open_print_err(int err) {
-	switch (err) {
-		case EACCES:
-			printf("Writing autorization to file denied" ENDL);
-			break;
-
-		case EMFILE:
-		#if !_WIN32
-		case EDQUOT:
-		#endif
-		case ENOSPC:
-			printf("Out of disk quota, too many inodes, or too many files opened" ENDL);
-			break;
-
-		case EAGAIN:
-		case EISDIR:
-		case ENXIO:
-		case EOPNOTSUPP:
-		case EROFS:
-		case ETXTBSY:
-			printf("file is not writable!!!" ENDL);
-			break;
-
-		case EINTR:
-			printf("Interrupted by a signal" ENDL);
-			break;
-
-		case ELOOP:
-			printf("Too many symlinks" ENDL);
-			break;
-
-		case ENAMETOOLONG:
-			printf("path element too long" ENDL);
-			break;
-
-		case ENOTDIR:
-			printf("one of the elements in the path may not be a dir" ENDL);
-			break;
-
-		case EEXIST:
-		case EILSEQ:
-		case EBADF:
-		case EOVERFLOW:
-		case EDEADLK:
-		case ENOENT:
-		case EFAULT:
-		case EINVAL:
-		case EIO:
-		default:
-			printf("Unexpected error n°%d: %s" ENDL, err, strerror(err));
-			break;
+/*! Converts rows [first, last) of an indexed chunk to floats.
+ *
+ * Fields are delimited by the ChunkIndex, so the conversion never has to
+ * look for the next field, and the field widths and row lengths are
+ * checked against the RowLayout on the way. Missing fields are set to 0.
+ * Only the fields of the window of the RowLayout are converted, the
+ * index holds the ends of the fields before it. With the fixed engine,
+ * the CompBuffer receives int32 thousandths instead of floats.
+ */
+void convert_rows(
+	const char *chunk,
+	const ChunkIndex *idx,
+	CompBuffer *cp,
+	const RowLayout *row_lo,
+	int32_t first,
+	int32_t last,
+	ReadStats *stats
+){
+	for (int32_t r = first; r < last; r++) {
+		const char *row = chunk + idx->row_starts[r];
+		const uint32_t *ends = idx->field_ends + (int64_t) r * idx->row_length;
+		float *cbidx = cp->start + (int64_t) r * cp->row_length;
+		int32_t *fixed_idx = (int32_t *) cbidx;
+
+		int32_t found = idx->row_fields[r];
+		int32_t window_end = row_lo->first_field + cp->row_length;
+		int32_t fields = found < window_end ? found : window_end;
+		stats->short_rows += found < row_lo->field_count;
+		stats->long_rows += found > row_lo->field_count;
+
+		int32_t first_field = row_lo->first_field;
+		uint32_t fstart = first_field > 0 && first_field <= found ? ends[first_field - 1] + 1 : 0;
+		for (int32_t i = first_field; i < fields; i++) {
+			uint32_t fend = ends[i];
+			// DOS eol: the '\r' is not part of the last field
+			if (i == found - 1 && fend > fstart && row[fend - 1] == '\r') fend--;
+
+			int width = (int) (fend - fstart);
+			stats->big_fields += width > row_lo->max_field_size;
+			stats->small_fields += width < row_lo->min_field_size;
+
+			char *newptr;
+			if (row_lo->engine == ENGINE_FIXED) *fixed_idx++ = parse_fixed_field(row + fstart, width, &newptr);
+			else *cbidx++ = parse_field(row + fstart, width, &newptr);
+
+			fstart = ends[i] + 1;
+		}
+		// 0.0f and 0 are both all zero bits
+		int32_t converted = fields > first_field ? fields - first_field : 0;
+		float *missing = cp->start + (int64_t) r * cp->row_length + converted;
+		memset(missing, 0, (size_t) (cp->row_length - converted) * sizeof(float));
 	}
 }
 
-void subsample(CompBuffer* cpb, ProcValBuffer* pvb) {
-	// redefined with a shorter name within this scope
-	int r_len = pvb->row_length;
-	int r_cnt = pvb->row_count;
-	
-	for(int row_off = 0; row_off < r_cnt * r_len; row_off+=r_len) {
-		for(int col_off = 0; col_off < r_len; col_off++) {
-
-			float *from = cpb->start + 2 * (row_off + col_off);
-			float *to = pvb->start + (row_off + col_off);
-
-			//avg
-			*to = (from[0] + from[1] + from[r_len] + from[r_len + 1]) / 4;
-		}
-	}
+typedef struct {
+	const char *chunk;
+	ChunkIndex *idx;
+	CompBuffer *cp;
+	const RowLayout *row_lo;
+	int32_t task_count;
+	ReadStats task_stats[MAX_PARSE_THREADS];
+} ConvertJob;
+
+/*! Indexes and converts the `task`-th slice of the rows of a chunk,
+ *  straight into its slice of the CompBuffer.
+ */
+static void convert_task(void *ctx, int32_t task) {
+	ConvertJob *job = (ConvertJob *) ctx;
+	int64_t rows = job->idx->row_count;
+	int32_t first = (int32_t) (rows * task / job->task_count);
+	int32_t last = (int32_t) (rows * (task + 1) / job->task_count);
+
+	index_rows(job->idx, job->chunk, first, last);
+	convert_rows(job->chunk, job->idx, job->cp, job->row_lo, first, last, job->task_stats + task);
 }
 
 int read_chunk(
 	const ReadBuffer *rd,
 	CompBuffer *cp,
+	ChunkIndex *idx,
+	WorkerPool *pool,
 	const RowLayout *row_lo,
 	MapOffsets *off,
 	uint64_t file_size,
+	const RowIndex *rows,
+	ReadStats *stats,
 	char* read_complete_flag
 ){
-	int read_rows = 0;
-
 	// align correctly to the begining of the line,
 	// within the first mapped page
 	char *readptr = rd->start + off->page_to_readptr;
 	*read_complete_flag = 0;
 
-	// depends on
-	// cpbuff
-	for (;read_rows < cp->row_count; read_rows++) {
-		off->fstart_to_readptr = off->fstart_to_page + (readptr - rd->start);
-
-		// Can't check EOF flag since it's MMAP and not a file reading utility.
-		// check for eof by comparing true offset to file size
-		if (off->fstart_to_readptr > file_size) {
-			*read_complete_flag = 1;
-			break;
-		}
-		// flag for fields too big or too small...
-		// int f2big = 0;
-		// int f2sml = 0;
-
-		float *cb_init_pos = cp->start + read_rows * cp->row_length;
-		float *cb_row_limit = cb_init_pos + cp->row_length;
-
-		if (off->fstart_to_readptr < file_size - row_lo->max_size) {
-
-			// repeated cb_info.row_size (=row_lo.field_count) times
-			// does not exit nor break to reduce code branching
-			//
-			for (float *cbidx=cb_init_pos; cbidx<cb_row_limit; cbidx++) {
-				char *newptr = readptr;
-				*cbidx = strtof(readptr, &newptr);
-
-				//short delta = newptr - readptr;
-				// f2big += delta > row_lo->max_field_size;
-				// f2sml += delta < row_lo->min_field_size;
-
-				readptr = newptr + 1;
-			}
-
-		} else {
-			char *read_limit = rd->start + (file_size - off->fstart_to_page);
-			for (float *cbidx=cb_init_pos; cbidx<cb_row_limit && readptr < read_limit; cbidx++) {
-				char *newptr = readptr;
-				*cbidx = strtof(readptr, &newptr);
+	// Can't check EOF flag since it's MMAP and not a file reading utility.
+	// Never read past the end of the file, nor past the mapped region.
+	uint64_t mapped_file = file_size - off->fstart_to_page;
+	char at_eof = mapped_file <= (uint64_t) rd->bytesize;
+	const char *read_limit = rd->start + (at_eof ? (int64_t) mapped_file : rd->bytesize);
+
+	// Only the eols are searched sequentially, rows are then independent
+	// and are split between the threads of the pool. With a row index,
+	// they are not even searched.
+	const char *next = rows != NULL
+		? find_indexed_row_starts(idx, rows, off->fstart_to_page + off->page_to_readptr, readptr, read_limit, cp->row_count)
+		: find_row_starts(idx, readptr, read_limit, cp->row_count, at_eof);
+
+	ConvertJob job = {
+		.chunk = readptr,
+		.idx = idx,
+		.cp = cp,
+		.row_lo = row_lo,
+		.task_count = pool->thread_count
+	};
+	run_on_pool(pool, convert_task, &job, job.task_count);
 
-				//short delta = newptr - readptr;
-				// f2big += delta > row_lo->max_field_size;
-				// f2sml += delta < row_lo->min_field_size;
+	for (int32_t t = 0; t < job.task_count; t++) {
+		stats->small_fields += job.task_stats[t].small_fields;
+		stats->big_fields += job.task_stats[t].big_fields;
+		stats->short_rows += job.task_stats[t].short_rows;
+		stats->long_rows += job.task_stats[t].long_rows;
+	}
 
-				readptr = newptr + 1;
-			}
-		}
+	if (at_eof && next == read_limit) *read_complete_flag = 1;
 
-		if (row_lo->eol_size == 2) readptr++;
-		// if (f2big || f2sml){
-		// 	printf("unexpected size of field:");
-		// 	if (f2big) printf("    too big x %d", f2big);
-		// 	if (f2sml) printf("    too small x %d", f2sml);
-		// 	printf(ENDL);
-		//
-		// }
-	}
-	
 	// grow input_offset
+	off->fstart_to_readptr = off->fstart_to_page + (next - rd->start);
 	if (!*read_complete_flag) {
-		off->fstart_to_readptr = off->fstart_to_page + (readptr - rd->start);
 		off->page_to_readptr = off->fstart_to_readptr % rd->page_bytesize;
 		off->fstart_to_page = off->fstart_to_readptr - off->page_to_readptr;
 	}
-	return read_rows;
+	return idx->row_count;
 }
 
-void write_buffers_to_files(WriteBuffer *wr, Config* cf, int tile_row){
-	for (int i=0; i<wr->file_buffer_count; i++) {
-		// generate file path
-		// due diligence done at beginning of main,
-		// if there are any error while creating the file
-		// skip to next file
-		char path[MAXIMUM_PATH()];
-		int char_count =
-			snprintf(path, MAXIMUM_PATH(), "%s/row%.3d_col%.3d.csv", cf->dest, tile_row, i);
-		if (char_count >= MAXIMUM_PATH()) {
-			printf(ENDL);
-			die("pathname too big!", EX_SOFTWARE);
-		}
-
-		errno = 0;
-		FILE *fp = fopen(path, "wb");
-		int err = errno;
-
-		if (fp == NULL) {
-			printf("an error occured while opening an output file" ENDL);
-			printf("path: %s" ENDL, path);
-
-			output_open_print_err(err);
-
-			printf("skipping..." ENDL);
-		}
-		else {
-			// fill buffer
-			FileBuffer *fb = wr->file_buffers + i;
-
-			// TODO: handle write errors
-			errno = 0;
-			unsigned int written_bytes = fwrite(fb->buffer, 1, fb->bytesize, fp);
-			int errval = errno;
-
-			if (written_bytes < 0) {
-				printf(
-					"ERROR n°%d: %s while writing to file %s" ENDL,
-					errval, strerror(errval), path
-				);
-			}
-
-			else if (written_bytes != fb->bytesize) {
-				printf(
-					"error: discrepancy between buffer size and number of bytes"
-					"written... : expected %llu, wrote %d" ENDL,
-					(long long unsigned) fb->bytesize,
-					written_bytes
-				);
-			}
-
-			fclose(fp);
-		}
+/*! tile_path, for the tiles of the run, whose paths were checked up front. */
+void output_tile_path(char *dst, size_t size, const char *dir, int tile_row, int col, Output_format format) {
+	if (tile_path(dst, size, dir, tile_row, col, format)) {
+		printf(ENDL);
+		die("pathname too big!", EX_SOFTWARE);
 	}
 }
 
-int write_FullFileBuffer_to_file(FullFileBuffer *ff, Config* cf){
-	char path[MAXIMUM_PATH()];
-	int char_count =
-		snprintf(path, MAXIMUM_PATH(), "%s/resized_full.csv", cf->dest);
-	if (char_count >= MAXIMUM_PATH()) {
-		printf(ENDL);
-		die("pathname too big!", EX_SOFTWARE);
+/*! Waits for the row of tiles handed to io_uring, if any, reports the
+ *  errors of its tiles and releases its buffers.
+ */
+void finish_tile_batch(void) {
+	TileBatch *b = &tile_batch;
+	if (b->tiles == NULL) return;
+
+	int err = wait_tile_writes(&tile_writer);
+	if (err) {
+		printf("ERROR n°%d: %s while waiting for the tile writes" ENDL, err, strerror(err));
+		die("could not write the tiles", EX_OSERR);
 	}
 
-	// file at `path` will be created, written to, then closed,
-	// then opened, then appended to, then closed,
-	// then opened, then appended to, then closed,
-	// ...
+	for (int32_t i = 0; i < b->tile_count; i++) report_tile_write(b->tiles + i);
 
-	errno = 0;
-	FILE *fp = fopen(path, "ab+");
-	int err = errno;
+	give_back_arena(&chunk_arenas, b->wr.arena);
+	free(b->headers);
+	free(b->paths);
+	free(b->tiles);
+	*b = (TileBatch) {0};
+}
 
-	if (fp == NULL) {
-		printf("an error occured while opening an output file" ENDL);
-		printf("path: %s" ENDL, path);
+/*! Hands every tile of `wr` to io_uring at once, after the previous row of
+ *  tiles is done, and returns while they are being written. The batch
+ *  takes the buffers of `wr` over.
+ */
+void submit_tile_batch(WriteBuffer *wr, const char *dir, int tile_row) {
+	finish_tile_batch();
+
+	TileBatch *b = &tile_batch;
+	int32_t count = wr->file_buffer_count;
+	// "/row%.3d_col%.3d.ext" and the nul, with the widest ints
+	size_t path_size = strlen(dir) + 40;
+
+	b->tiles = (TileWrite *) malloc(count * sizeof(TileWrite));
+	b->paths = (char *) malloc(count * path_size);
+	if (wr->format == OUTPUT_NPY) b->headers = (char *) malloc((size_t) count * NPY_HEADER_SIZE);
+	if (b->tiles == NULL || b->paths == NULL || (wr->format == OUTPUT_NPY && b->headers == NULL)) {
+		die("Out of Memory (tile batch)", EX_OSERR);
+	}
 
-		output_fullfile_open_print_err(err);
-		return 1;
+	for (int32_t i = 0; i < count; i++) {
+		char *path = b->paths + i * path_size;
+		char *header = b->headers == NULL ? NULL : b->headers + (size_t) i * NPY_HEADER_SIZE;
+		output_tile_path(path, path_size, dir, tile_row, i, wr->format);
+		fill_TileWrite(b->tiles + i, wr, i, path, header);
 	}
+	b->tile_count = count;
 
-	errno = 0;
-	unsigned int written_bytes = fwrite(ff->buffer, 1, ff->bytesize, fp);
-	int errval = errno;
+	b->wr = *wr;
+	wr->buffer = NULL;
+	wr->file_buffers = NULL;
+	wr->arena = NULL;
 
-	if (written_bytes < 0) {
-		printf(
-			"ERROR n°%d: %s while writing to file %s" ENDL,
-			errval, strerror(errval), path
-		);
-		fclose(fp);
-		return 1;
+	int err = submit_tile_writes(&tile_writer, b->tiles, count);
+	if (err) {
+		printf("ERROR n°%d: %s while submitting the tile writes" ENDL, err, strerror(err));
+		die("could not write the tiles", EX_OSERR);
 	}
+}
 
-	if (written_bytes != ff->bytesize) {
-		printf(
-			"error: discrepancy between buffer size and number of bytes"
-			"written... : expected %llu, wrote %d" ENDL,
-			(long long unsigned) ff->bytesize,
-			written_bytes
-		);
+/*! Writes every tile of `wr` in `dir`. With io_uring, the writes are only
+ *  submitted, and `wr` no longer owns its buffers: the batch gives its
+ *  arena back once written. Errors are reported tile by tile either way.
+ */
+void write_buffers_to_files(WriteBuffer *wr, const char *dir, int tile_row){
+	if (tile_writer_ready) {
+		submit_tile_batch(wr, dir, tile_row);
+		return;
 	}
 
-	fclose(fp);
-	return 0;
-}
+	for (int i=0; i<wr->file_buffer_count; i++) {
+		// due diligence done at beginning of main,
+		// if there are any error while creating the file
+		// skip to next file
+		char path[MAXIMUM_PATH()];
+		char header[NPY_HEADER_SIZE];
+		TileWrite t;
 
-int fill_filebuffers(ProcValBuffer *pv, WriteBuffer *wr){
-	// offset between the beginning of pv buffer and the beginning
-	// of the current row
-	float *row_start = pv->start;
-	int field_sz =  wr->field_size;
-	int stride = wr->field_size + wr->sep_size;
+		output_tile_path(path, MAXIMUM_PATH(), dir, tile_row, i, wr->format);
+		fill_TileWrite(&t, wr, i, path, header);
+		write_tile_stdio(&t);
+		report_tile_write(&t);
+	}
+}
 
-	int write_overflow = 0;
+/*! Picks how the tiles are written, according to `write_mode`.
+ *
+ * @param max_tiles number of tiles in the widest row of tiles.
+ */
+void open_tile_writer(const Config *conf, int32_t max_tiles) {
+	char wants_uring = conf->write_mode == WRITE_AUTO || conf->write_mode == WRITE_URING;
+	if (wants_uring && init_TileWriter(&tile_writer, max_tiles) == 0) {
+		tile_writer_ready = 1;
+		return;
+	}
+	if (conf->write_mode == WRITE_URING) {
+		printf("WARNING: io_uring is not available, writing the tiles with fopen/fwrite" ENDL);
+	}
+}
 
-	for (int row_idx=0; row_idx < pv->row_count; row_idx++) {
+/*! Waits for the last row of tiles, then tears the io_uring down. */
+void close_tile_writer(void) {
+	if (!tile_writer_ready) return;
+	finish_tile_batch();
+	free_TileWriter(&tile_writer);
+	tile_writer_ready = 0;
+}
 
-		// if (!((row_idx + 1) % 100)) printf("rows written to buffer = %d" ENDL,row_idx);
+/*! Upper bound of the row count of the source, from its size and the
+ *  smallest row it can hold.
+ */
+int64_t max_source_rows(const RowLayout *row_lo, uint64_t file_size) {
+	int64_t min_row = (int64_t) row_lo->field_count * (row_lo->min_field_size + row_lo->sep_size)
+		- row_lo->sep_size + row_lo->eol_size;
+	if (min_row < 1) min_row = 1;
+	return (int64_t) (file_size / (uint64_t) min_row) + 1;
+}
 
-		// offset between the beginning of the row and the beginning of
-		// the range relevant to the current file.
-		float *range_start = row_start;
+/*! Formats `count` values separated by commas, without a trailing one.
+ *
+ * @return a pointer to the character following the last field.
+ */
+char *format_row_segment(char *dst, const float *values, int32_t count, short field_size, int *write_overflow) {
+	// if the value is too big, it is truncated to field_size characters,
+	// and counted to educate the user about it.
+	for (const float *val_ptr = values; val_ptr < values + count; val_ptr++) {
+		// same output as snprintf "%0*.3f", without the \0
+		int written = format_field(dst, field_size, *val_ptr);
+		*write_overflow += written != field_size;
+
+		//write the comma afterwards
+		dst[field_size] = ',';
+		dst += field_size + 1;
+	}
+	// remove extra sep
+	return dst - 1;
+}
 
-		// if (row_idx + 1 == pv->row_count) printf("writing last row" ENDL);
+/*! format_row_segment, for values in thousandths. */
+char *format_fixed_row_segment(char *dst, const int32_t *values, int32_t count, short field_size, int *write_overflow) {
+	for (const int32_t *val_ptr = values; val_ptr < values + count; val_ptr++) {
+		int written = format_fixed_field(dst, field_size, *val_ptr);
+		*write_overflow += written != field_size;
 
-		for (int f_idx=0; f_idx < wr->file_buffer_count; f_idx++){
+		dst[field_size] = ',';
+		dst += field_size + 1;
+	}
+	return dst - 1;
+}
 
-			// if (row_idx + 1 == pv->row_count) printf("file buffer n°%d is being written to" ENDL, f_idx);
+char *write_eol(char *dst, char eol_size) {
+	if (eol_size > 1) *dst++ = '\r';
+	*dst++ = '\n';
+	return dst;
+}
 
-			FileBuffer file = wr->file_buffers[f_idx];
+/*! Formats one output row into row `row_idx` of every tile and of the
+ *  full file. The text of each tile row is copied into the full file row
+ *  while still in cache. Binary formats are encoded instead.
+ *
+ * @return the number of values that did not fit in the field size.
+ */
+int format_output_row(const float *values, int32_t row_idx, WriteBuffer *wr, FullFileBuffer *ff) {
+	int write_overflow = 0;
+	const float *range_start = values;
+	char *ff_ptr = ff->buffer + (int64_t) row_idx * ff->row_bytesize;
+
+	// no text involved: the full row is encoded once then split in tiles
+	if (wr->format != OUTPUT_CSV) {
+		if (wr->format == OUTPUT_F16) encode_f16(ff_ptr, values, ff->row_length, &write_overflow);
+		else encode_f32(ff_ptr, values, ff->row_length);
+
+		for (int f_idx = 0; f_idx < wr->file_buffer_count; f_idx++) {
+			FileBuffer *file = wr->file_buffers + f_idx;
+			memcpy(file->buffer + (int64_t) row_idx * file->row_size, ff_ptr, file->row_size);
+			ff_ptr += file->row_size;
+		}
+		return write_overflow;
+	}
 
-			char *fb_ptr = file.buffer + row_idx * file.row_size;
+	for (int f_idx = 0; f_idx < wr->file_buffer_count; f_idx++) {
+		FileBuffer *file = wr->file_buffers + f_idx;
+		char *fb_row = file->buffer + (int64_t) row_idx * file->row_size;
 
-			float *range_end = range_start + file.row_length;
+		char *fb_end = wr->engine == ENGINE_FIXED
+			? format_fixed_row_segment(fb_row, (const int32_t *) range_start, file->row_length, wr->field_size, &write_overflow)
+			: format_row_segment(fb_row, range_start, file->row_length, wr->field_size, &write_overflow);
+		write_eol(fb_end, wr->eol_size);
 
-			// if the value is too big, we risk losing precision at best
-			// and doing a segfault at worst.
-			// I will not check for theses cases for performance, but I will try to educate
-			// the user about it, to prevent corruption.
-			for (float *val_ptr = range_start; val_ptr < range_end; val_ptr++){
-				// PERF: Investigate if loop unrolling with multiple %f is worth it
+		memcpy(ff_ptr, fb_row, fb_end - fb_row);
+		ff_ptr += fb_end - fb_row;
+		*ff_ptr++ = ',';
 
-				int count = snprintf(fb_ptr, wr->field_size + 1, "%0*.3f", field_sz, *val_ptr); // + 1 for the \0
-				
-				write_overflow += count != field_sz;
-				
-				//write the comma afterwards
-				fb_ptr[wr->field_size] = ',';
-	
-				fb_ptr += stride;
-			}
-			// remove extra sep
-			// write newline
-			if (wr->eol_size == 1) {
-				fb_ptr[-1] = '\n';
-			} else {
-				fb_ptr[-1] = '\r';
-				fb_ptr[ 0] = '\n';
-			}
-			range_start = range_end;
-		}
-		row_start += pv->row_length;
+		range_start += file->row_length;
 	}
+	write_eol(ff_ptr - 1, ff->eol_size); // replaces the extra comma
 	return write_overflow;
 }
 
-void fill_fullfile_buffer(FullFileBuffer *ff, WriteBuffer *wr){
-	char* writeptr = ff->buffer;
-	for (int row_idx = 0; row_idx < ff->row_count; row_idx++){
-		
-		FileBuffer *file_stop = wr->file_buffers + wr->file_buffer_count;
-		for (FileBuffer *file = wr->file_buffers; file < file_stop; file++){
-
-			char *src_row = file->buffer + row_idx * file->row_size;
-			size_t segment_length = file->row_size - ff->eol_size;
+/*! Downsamples and formats the rows of a CompBuffer into the tiles and
+ *  the full file at once.
+ *
+ * Each output row is reduced into `values` then formatted once per tile.
+ * With a `values_stride` of 0, `values` is a single row of scratch space
+ * and no ProcValBuffer is needed, otherwise output row i is kept at
+ * `values + i * values_stride`.
+ *
+ * @param rows number of output rows, CompBuffer rows / factor at most.
+ * @param engine ENGINE_FIXED if the CompBuffer holds thousandths, which
+ *        are then reduced and formatted as such.
+ *
+ * @return the number of values that did not fit in the field size.
+ */
+int subsample_and_format(
+	const CompBuffer *cp,
+	int32_t rows,
+	int factor,
+	Filter_flag filter,
+	Engine_flag engine,
+	WriteBuffer *wr,
+	FullFileBuffer *ff,
+	float *values,
+	int64_t values_stride
+){
+	int write_overflow = 0;
 
-			memcpy((void *) writeptr, (void *) src_row, segment_length);
-			writeptr += segment_length;
-			*writeptr++ = ',';
+	for (int32_t row_idx = 0; row_idx < rows; row_idx++) {
+		const float *top = cp->start + (int64_t) factor * row_idx * cp->row_length;
+		float *row_values = values + row_idx * values_stride;
+		if (engine == ENGINE_FIXED) {
+			downsample_row_fixed((const int32_t *) top, cp->row_length, (int32_t *) row_values, ff->row_length, factor, filter);
+		} else {
+			downsample_row(top, cp->row_length, row_values, ff->row_length, factor, filter);
 		}
-		writeptr--; // otherwise we get a free extra comma... and a buffer overrun
-		if (ff->eol_size > 1) *writeptr++ = '\r';
-		*writeptr++ = '\n';
-		ptrdiff_t delta = writeptr - ff->buffer;
-		ptrdiff_t expected = ff->row_bytesize * (row_idx + 1);
-		if (delta != expected) printf("wrote too much on this row"ENDL);
+
+		write_overflow += format_output_row(row_values, row_idx, wr, ff);
 	}
+	return write_overflow;
 }
 
 #if defined(__APPLE__) || defined(__LINUX__)
@@ -1144,244 +1198,1415 @@ HANDLE get_normal_file_handle(char* path, ErrMsg* err) {
  */
 #endif
 
+// ============================== OUTPUT BUFFERS ==============================
 
-int main(int argc, char* argv[]){
-	/*
-	*	Initialization phase:
-	*
-	*	init a bunch of variables
-	*	compute a bunch of useful values
-	*	alloc some memory for some specific buffers
-	*
-	*/
-
-	if (argc != 2) die("Wrong number of arguments", EX_USAGE);
-
-	// get config
-	Config conf = {0};
-
-	printf("reading config file" ENDL);
-	if (get_config(argv[1], &conf)) die("Invalid config file", EX_DATAERR);
-
-	int dest_dir_err = check_or_create_dest_dir(conf.dest);
-	if (dest_dir_err) handle_dest_dir_check(dest_dir_err);
+/*! Creates the tile of `fb` at `path` at its final size and maps it, so
+ *  that it is formatted in place, past its npy header if any.
+ *
+ * @return 0 on success, an errno value otherwise, with `fb` untouched.
+ */
+int map_tile(FileBuffer *fb, const char *path, Output_format format) {
+	#if defined(__APPLE__) || defined(__LINUX__)
+	int64_t header_size = format == OUTPUT_NPY ? NPY_HEADER_SIZE : 0;
+	int64_t size = header_size + fb->bytesize;
+	if (size == 0) return EINVAL;
 
-	// open source file
-	printf("input file path = `%s`" ENDL, conf.source);
-	#ifdef _WIN32
-	input_fp = fopen(conf.source, "rb");
+	int fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0666);
+	if (fd < 0) return errno;
 
-	if (atexit(close_input_fp)) {
-		die("could not set file auto-closing at exit", EX_SOFTWARE);
-	}
-	if (input_fp == NULL) specify_os_error_and_exit();
+	// reserving the blocks turns a full disk into an error here,
+	// instead of a SIGBUS while formatting
+	#if defined(__LINUX__)
+	int err = posix_fallocate(fd, 0, (off_t) size);
 	#else
-	input_fd = open(conf.source, O_RDONLY);
-	if (atexit(close_input_fd)) {
-		die("could not set file auto-closing at exit", EX_SOFTWARE);
-	}
-	// printf("input file descriptor = %d" ENDL, input_fd);
-	if (input_fd < 0) specify_os_error_and_exit();
+	int err = ftruncate(fd, (off_t) size) ? errno : 0;
 	#endif
 
-	ErrMsg rl_err = {0};
-	RowLayout row_lo = {0};
-	#ifdef _WIN32
-	if (get_row_layout_from_fp(&row_lo, &conf, input_fp, &rl_err)) {
-		die(rl_err.msg, rl_err.val);
+	char *map = NULL;
+	if (!err) {
+		void *addr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED) err = errno;
+		else map = (char *) addr;
 	}
+	close(fd);
+	if (err) return err;
+
+	if (header_size) write_npy_header(map, fb->bytesize / fb->row_size, fb->row_length);
+	fb->map = map;
+	fb->map_size = size;
+	fb->buffer = map + header_size;
+	return 0;
 	#else
-	if (get_row_layout(&row_lo, &conf, input_fd, &rl_err)) {
-		die(rl_err.msg, rl_err.val);
-	}
+	(void) fb;
+	(void) path;
+	(void) format;
+	return ENOSYS;
 	#endif
+}
 
-	uint64_t file_size = 0;
+/*! Maps the tiles and full file rows of row of tiles `tile_row`. What
+ *  cannot be mapped gets a malloc'd buffer instead, written the usual way
+ *  by unmap_output_buffers, which also reports the errors.
+ */
+void map_output_buffers(WriteBuffer *wr, FullFileBuffer *ff, const char *dir, int tile_row, FullFile *full) {
+	wr->mapped = 1;
 
-	#if defined(__APPLE__) || defined(__LINUX__)
-	file_size = file_size_from_fd(input_fd);
-	if (file_size == 0) die("could not read source file stats", EX_OSERR);
+	for (int i = 0; i < wr->file_buffer_count; i++) {
+		FileBuffer *fb = wr->file_buffers + i;
+		char path[MAXIMUM_PATH()];
+		output_tile_path(path, MAXIMUM_PATH(), dir, tile_row, i, wr->format);
+		if (map_tile(fb, path, wr->format) == 0) continue;
 
-	#elif defined(_WIN32)
-	// on windows platforms, we will use a HANDLE pointer
-	// for the rest of the program.
-	if (fclose(input_fp)) die("could not close input file correctly", EX_OSERR);
+		fb->buffer = (char *) malloc(fb->bytesize ? fb->bytesize : 1);
+		if (fb->buffer == NULL) die("Out of Memory (malloc fb->buffer)", EX_OSERR);
+	}
 
-	ErrMsg filehandle_err = {0};
-	HANDLE input_handle = get_normal_file_handle(conf.source, &filehandle_err);
-	if (input_handle == INVALID_HANDLE_VALUE) {
-		die(filehandle_err.msg, filehandle_err.val);
+	if (map_full_rows(full, ff, tile_row)) {
+		ff->buffer = malloc(ff->bytesize ? ff->bytesize : 1);
+		if (ff->buffer == NULL) die("Out of Memory (malloc ffbuff->buffer)", EX_OSERR);
 	}
+}
 
-	file_size = file_size_from_handle(input_handle);
-	if (file_size == 0) die("could not read source file stats", EX_SOFTWARE);
+/*! Unmaps what map_output_buffers mapped, which is then written by the
+ *  kernel, writes the rest with fwrite and pwrite, and releases `wr` and
+ *  `ff`.
+ */
+void unmap_output_buffers(WriteBuffer *wr, FullFileBuffer *ff, const char *dir, int tile_row, FullFile *full) {
+	for (int i = 0; i < wr->file_buffer_count; i++) {
+		FileBuffer *fb = wr->file_buffers + i;
+		if (fb->map != NULL) {
+			#if defined(__APPLE__) || defined(__LINUX__)
+			munmap(fb->map, fb->map_size);
+			#endif
+			continue;
+		}
 
-	HANDLE map_handle = CreateFileMapping(
-		input_handle, NULL, PAGE_READONLY, 0, 0, NULL
-	);
-	if (map_handle == NULL)
-		die("could not create file mapping object", EX_OSERR);
-	#endif
+		char path[MAXIMUM_PATH()];
+		char header[NPY_HEADER_SIZE];
+		TileWrite t;
+		output_tile_path(path, MAXIMUM_PATH(), dir, tile_row, i, wr->format);
+		fill_TileWrite(&t, wr, i, path, header);
+		write_tile_stdio(&t);
+		report_tile_write(&t);
+		free(fb->buffer);
+	}
+	give_back_arena(&chunk_arenas, wr->arena);
+	wr->arena = NULL;
+	wr->file_buffers = NULL;
 
+	if (ff->map != NULL) {
+		#if defined(__APPLE__) || defined(__LINUX__)
+		munmap(ff->map, ff->map_size);
+		#endif
+		account_full_rows(full, ff, 0);
+	} else {
+		int err = full->failed ? 0 : write_full_rows(full, ff, tile_row);
+		account_full_rows(full, ff, err);
+		free(ff->buffer);
+	}
+	ff->buffer = NULL;
+	ff->map = NULL;
+}
+
+/*! Carves the tile and full file buffers for the values described by
+ *  `pv`, which itself does not need to be allocated, out of an arena of
+ *  the pool: the memory of the previous chunks, already faulted in, and
+ *  only partly used by the last one. With write_mode = mmap, they are the
+ *  pages of the files of row of tiles `tile_row` of `dir` instead.
+ */
+void alloc_output_buffers(
+	ProcValBuffer *pv,
+	WriteBuffer *wr,
+	FullFileBuffer *ff,
+	const Config *conf,
+	const RowLayout *row_lo,
+	const char *dir,
+	int tile_row,
+	FullFile *full
+){
+	*wr = (WriteBuffer) {0};
+	wr->arena = take_arena(&chunk_arenas);
+	if (wr->arena == NULL)
+		die("Out of Memory (chunk arena)", EX_OSERR);
+
+	int64_t arena_used = 0;
+	if (init_WriteBufferStruct(wr, pv, conf, &arena_used))
+		die("chunk arena too small for wrbuff->file_buffers", EX_SOFTWARE);
+
+	char binary = wr->format != OUTPUT_CSV;
+	init_FullFileBuffer(
+		ff,
+		pv->row_length,
+		pv->row_count,
+		wr->field_size,
+		binary ? 0 : row_lo->sep_size,
+		binary ? 0 : row_lo->eol_size
+	);
 
-	ReadBuffer rdbuff = {0};
-	init_ReadBufferStruct(&rdbuff, &row_lo, &conf);
+	if (conf->write_mode == WRITE_MMAP) {
+		map_output_buffers(wr, ff, dir, tile_row, full);
+		return;
+	}
 
-	CompBuffer cpbuff = {0};
-	if (init_CompBuffer(&cpbuff, &row_lo, &conf)) die("Out of memory", EX_SOFTWARE);
-	// no malloc -> only done when the number of read rows has been counted
-	// (can change from chunk to chunk)
+	wr->buffer = carve_arena(wr->arena, &arena_used, wr->bytesize);
+	if(wr->buffer == NULL)
+		die("chunk arena too small for wrbuff->buffer", EX_SOFTWARE);
 
-	ProcValBuffer pvbuff = {0};
-	// no malloc -> only done when compbuff has updated its size
-	init_ProcValBufferStruct(&pvbuff, &row_lo, &conf);
-	
-	// get source file size
-	printf("getting input file statistics" ENDL);
+	asign_filebuffers(wr);
 
+	ff->buffer = carve_arena(wr->arena, &arena_used, ff->bytesize);
+	if(ff->buffer == NULL)
+		die("chunk arena too small for ffbuff->buffer", EX_SOFTWARE);
+}
 
+/*! Gives the arena of `wr` and `ff` back to the pool, unless the io_uring
+ *  batch took it over.
+ */
+void free_output_buffers(WriteBuffer *wr, FullFileBuffer *ff) {
+	give_back_arena(&chunk_arenas, wr->arena);
+	wr->arena = NULL;
+	wr->file_buffers = NULL;
+	wr->buffer = NULL;
+	ff->buffer = NULL;
+}
 
-	// printf("Input file size: " ENDL);
-	// print_size_info(file_size);
+// ================================= PYRAMID ==================================
 
-	// counts the rank of the last processed row of tiles
+typedef struct {
+	// what flush_pyramid_level writes the rows of tiles of a level with
+	const Config *conf;
+	const RowLayout *row_lo;
+} LevelOutput;
 
-	int tile_row = 0;
+/*! Formats and writes the pending rows of level `k` as its next row of
+ *  tiles, which is shorter than tile_height only at the end of the source.
+ *  The LevelFlush of the pyramid, with a LevelOutput as `ctx`.
+ */
+void flush_pyramid_level(void *ctx, PyramidLevel *lvl, int32_t k) {
+	const LevelOutput *out = (const LevelOutput *) ctx;
+	WriteBuffer wr;
+	FullFileBuffer ff;
+	alloc_output_buffers(&lvl->pending, &wr, &ff, out->conf, out->row_lo, lvl->dir, lvl->next_tile_row, &lvl->full);
+
+	int write_overflow = 0;
+	for (int32_t row = 0; row < lvl->pending.row_count; row++) {
+		const float *values = lvl->pending.start + (int64_t) row * lvl->pending.row_length;
+		write_overflow += format_output_row(values, row, &wr, &ff);
+	}
+	if (write_overflow) {
+		printf("values too wide for the output format x %d [level%d %d]" ENDL, write_overflow, k + 1, lvl->next_tile_row);
+	}
+
+	printf("writing to files [level%d %d]" ENDL, k + 1, lvl->next_tile_row);
+	report_output(&run_report, &wr, &ff);
+	if (wr.mapped) {
+		unmap_output_buffers(&wr, &ff, lvl->dir, lvl->next_tile_row, &lvl->full);
+	} else {
+		write_buffers_to_files(&wr, lvl->dir, lvl->next_tile_row);
+		if (!lvl->full.failed) {
+			account_full_rows(&lvl->full, &ff, write_full_rows(&lvl->full, &ff, lvl->next_tile_row));
+		}
+		free_output_buffers(&wr, &ff);
+	}
+	lvl->next_tile_row++;
+}
+
+/*! Opens the full file of `dir` as open_FullFile does, and dies if
+ *  what is already there can't be trusted.
+ */
+void open_output_full_file(
+	FullFile *full,
+	const char *dir,
+	const Config *conf,
+	const RowLayout *row_lo,
+	int32_t row_length,
+	int32_t rows_per_chunk,
+	int64_t max_rows,
+	int64_t kept_rows
+) {
+	Full_file_status status = open_FullFile(full, dir, conf, row_lo, row_length, rows_per_chunk, max_rows, kept_rows);
+	if (status == FULL_FILE_MISMATCH) {
+		die("the full file does not match the journal, the run can't be resumed", EX_DATAERR);
+	}
+	if (status == FULL_FILE_FAILED) die("could not set the full file up", EX_OSERR);
+}
+
+/*! Creates the `level{k}` directory and full file of every level of the
+ *  pyramid. With `resume_from`, the levels are picked up where the journal
+ *  says, where the carry and pending rows of every level are empty.
+ *  `source_rows` bounds the row count of the source.
+ */
+void open_pyramid_levels(Pyramid *pyr, const Config *conf, const RowLayout *row_lo, int64_t source_rows, const JournalEntry *resume_from) {
+	int64_t max_rows = source_rows;
+	int64_t kept_rows = resume_from != NULL ? resume_from->rows : 0;
+	for (int32_t k = 0; k < pyr->level_count; k++) {
+		PyramidLevel *lvl = pyr->levels + k;
+		int char_count = snprintf(lvl->dir, MAXIMUM_PATH(), "%s/level%d", conf->dest, k + 1);
+		if (char_count >= MAXIMUM_PATH()) die("pathname too big!", EX_SOFTWARE);
+
+		int dir_err = check_or_create_dest_dir(lvl->dir);
+		if (dir_err == DC_NON_HIDDEN_ENTRIES && resume_from != NULL) dir_err = DC_OK;
+		if (dir_err) handle_dest_dir_check(dir_err);
+
+		max_rows /= pyr->factor;
+		if (k > 0) kept_rows /= pyr->factor;
+		int32_t rows_per_chunk = k == 0 ? chunk_height(conf) : conf->tile_height;
+		open_output_full_file(&lvl->full, lvl->dir, conf, row_lo, lvl->width, rows_per_chunk, max_rows, kept_rows);
+		lvl->next_tile_row = (int32_t) (kept_rows / conf->tile_height);
+	}
+}
+
+// ================================== RESUME ==================================
+
+/*! Rows of the first level between two commits of the journal. The rows
+ *  of tiles of every level are then complete, and the carry and pending
+ *  rows of the pyramid empty, so nothing but the journal entry is needed
+ *  to pick the run up there.
+ */
+int64_t journal_commit_rows(const Config *conf) {
+	int64_t rows = conf->tile_height;
+	for (int32_t k = 1; k < conf->pyramid_levels; k++) rows *= conf->downsample_factor;
+	return rows;
+}
 
-	MapOffsets map_offsets = {
-		.fstart_to_page = 0,
-		.page_to_readptr = 0,
-		.fstart_to_readptr = 0
+/*! Counts the rows of chunk `ch`, once written, and commits them to the
+ *  journal if they complete the rows of tiles of every level. The tiles
+ *  and full files are flushed to the disk first, the journal never points
+ *  past what is there. The last chunk is never committed, the journal is
+ *  removed after it.
+ */
+void commit_written_chunk(const Chunk *ch, const Config *conf, const RowLayout *row_lo, Pyramid *pyr, FullFile *full) {
+	if (!journal.open) return;
+	journal.rows += ch->pv.row_count;
+	if (ch->last || journal.rows % journal.commit_rows) return;
+
+	// the last row of tiles may still be in the hands of io_uring
+	if (tile_writer_ready) finish_tile_batch();
+
+	JournalEntry e = {
+		.next_chunk = ch->tile_row + 1,
+		.rows = journal.rows,
+		.source_offset = ch->source_end
 	};
+	int err = sync_committed_tiles(conf, row_lo, journal.rows - journal.commit_rows, journal.rows);
+	if (pyr == NULL) {
+		if (!err) err = sync_FullFile(full);
+	} else {
+		for (int32_t k = 0; k < pyr->level_count && !err; k++) err = sync_FullFile(&pyr->levels[k].full);
+	}
+	if (!err) err = commit_journal(&journal, &e);
+	if (err) {
+		printf("WARNING: could not commit to %s (%s), the run can't be resumed past this point" ENDL, journal.path, strerror(err));
+		close_ResumeJournal(&journal, 0);
+	}
+}
 
-	/*
-	 *=========================== Processing phase ============================
-	 */
+/*! @return 1 if a row of the source starts at `offset`, 0 otherwise. */
+int is_row_start(const RowIndex *ri, uint64_t offset, uint64_t file_size) {
+	if (offset == 0) return 1;
+	if (offset >= file_size) return 0;
+	if (ri != NULL) {
+		int64_t row = row_at_offset(ri, offset);
+		return row < ri->row_count && ri->row_starts[row] == offset;
+	}
+	#if defined(__APPLE__) || defined(__LINUX__)
+	char before = 0;
+	return pread(input_fd, &before, 1, (off_t) (offset - 1)) == 1 && before == '\n';
+	#else
+	return 1;
+	#endif
+}
 
-	printf("Setup finished, starting processing" ENDL);
+// ================================== STAGES ==================================
 
-	char INPUT_READING_COMPLETE = 0;
-	int FULLFILE_FAILED = 0;
+/*! Sets up how the source is read, according to `conf->read_mode`.
+ *
+ * The whole file is mapped at once on 64-bit POSIX hosts, and the kernel
+ * is told it is read sequentially. If mmap fails, as it does on some
+ * network filesystems and FUSE mounts, the source is mapped window after
+ * window or, if that fails too, read with pread by a background thread.
+ */
+void open_source_map(SourceReader *src, const Config *conf) {
+	src->mode = conf->read_mode;
+	#if defined(__APPLE__) || defined(__LINUX__)
+	if (src->mode == READ_AUTO) {
+		src->mode = UINTPTR_MAX > 0xFFFFFFFF ? READ_MMAP_WHOLE : READ_MMAP_WINDOW;
+	}
 
-	// We don't know the number of rows in advance so no for loop
-	while(!INPUT_READING_COMPLETE) {
-		printf("processing chunk [%d]" ENDL, tile_row);
+	if (src->mode == READ_MMAP_WHOLE && UINTPTR_MAX <= 0xFFFFFFFF) {
+		printf("WARNING: whole file mapping needs a 64-bit host, mapping the source chunk by chunk" ENDL);
+		src->mode = READ_MMAP_WINDOW;
+	}
 
-		#if defined(__APPLE__) || defined(__LINUX__)
+	if (src->mode == READ_MMAP_WHOLE) {
 		errno = 0;
-		rdbuff.start = mmap( // PERF: could be optimized by using the MAP_FIXED flag?
-			NULL,
-			rdbuff.bytesize,
-			PROT_READ,
-			MAP_PRIVATE|MAP_FILE,
-			input_fd,
-			map_offsets.fstart_to_page
-		);
+		void *map = mmap(NULL, src->file_size, PROT_READ, MAP_PRIVATE|MAP_FILE, input_fd, 0);
+		if (map != MAP_FAILED) {
+			src->file_map = (char *) map;
+			src->released = src->off.fstart_to_page;
+			if (madvise(src->file_map, src->file_size, MADV_SEQUENTIAL)) {
+				printf("WARNING: madvise(MADV_SEQUENTIAL) failed on the source" ENDL);
+			}
+			return;
+		}
+		printf("WARNING: could not map the whole source (%s), mapping it chunk by chunk" ENDL, strerror(errno));
+		src->mode = READ_MMAP_WINDOW;
+	}
 
-		if (rdbuff.start == MAP_FAILED) {
+	if (src->mode == READ_MMAP_WINDOW) {
+		// same mapping as the first window, to know if mmap works at all
+		errno = 0;
+		void *probe = mmap(NULL, src->rd.page_bytesize, PROT_READ, MAP_PRIVATE|MAP_FILE, input_fd, 0);
+		if (probe != MAP_FAILED) {
+			munmap(probe, src->rd.page_bytesize);
+			return;
+		}
+		char msg[ERR_MSG_SIZE] = {0};
+		handle_mmap_error(errno, msg, ERR_MSG_SIZE);
+		printf("WARNING: %s Reading the source with pread instead" ENDL, msg);
+		src->mode = READ_STREAM;
+	}
+
+	if (init_StreamReader(&src->stream, input_fd, src->file_size, src->rd.bytesize, src->off.fstart_to_page)) {
+		die("could not start reading the source", EX_OSERR);
+	}
+	#else
+	if (src->mode != READ_AUTO && src->mode != READ_MMAP_WINDOW) {
+		printf("WARNING: only read_mode = window is available on this platform" ENDL);
+	}
+	src->mode = READ_MMAP_WINDOW;
+	#endif
+}
+
+void close_source_map(SourceReader *src) {
+	#if defined(__APPLE__) || defined(__LINUX__)
+	if (src->file_map != NULL) munmap(src->file_map, src->file_size);
+	if (src->mode == READ_STREAM) free_StreamReader(&src->stream);
+	#endif
+	src->file_map = NULL;
+}
+
+void map_source_window(SourceReader *src) {
+	#if defined(__APPLE__) || defined(__LINUX__)
+	if (src->mode == READ_STREAM) {
+		errno = 0;
+		src->rd.start = (char *) stream_window(&src->stream, src->off.fstart_to_page);
+		if (src->rd.start == NULL) {
 			char msg[ERR_MSG_SIZE] = {0};
-			int err = handle_mmap_error(errno, msg, ERR_MSG_SIZE);
-			die(msg, err);
+			snprintf(msg, ERR_MSG_SIZE, "could not read the source: %s", strerror(errno));
+			die(msg, EX_IOERR);
 		}
-		#elif defined(_WIN32)
-		BIG_WORD bwSize = {.full = map_offsets.fstart_to_page};
-		int64_t remaining_space = file_size - map_offsets.fstart_to_page;
-		int64_t map_size = rdbuff.bytesize < remaining_space ? rdbuff.bytesize : 0; // 0 means rest of file
-		rdbuff.start = MapViewOfFile(
-			map_handle,
-			FILE_MAP_READ,
-			bwSize.parts[1], bwSize.parts[0], //little-endian only
-			map_size
-		);
+		return;
+	}
 
-		if (rdbuff.start == NULL){
-			die("Couldn't map a view of input file", EX_OSERR);
+	if (src->mode == READ_MMAP_WHOLE) {
+		src->rd.start = src->file_map + src->off.fstart_to_page;
+
+		// start reading the window after this one while it is parsed
+		uint64_t next = src->off.fstart_to_page + src->rd.bytesize;
+		if (next < src->file_size) {
+			uint64_t length = src->file_size - next;
+			if (length > (uint64_t) src->rd.bytesize) length = src->rd.bytesize;
+			madvise(src->file_map + next, length, MADV_WILLNEED);
 		}
-		#endif
+		return;
+	}
 
-		printf("file successfully mapped to memory [%d]" ENDL, tile_row);
+	errno = 0;
+	src->rd.start = mmap( // PERF: could be optimized by using the MAP_FIXED flag?
+		NULL,
+		src->rd.bytesize,
+		PROT_READ,
+		MAP_PRIVATE|MAP_FILE,
+		input_fd,
+		src->off.fstart_to_page
+	);
 
+	if (src->rd.start == MAP_FAILED) {
+		char msg[ERR_MSG_SIZE] = {0};
+		int err = handle_mmap_error(errno, msg, ERR_MSG_SIZE);
+		die(msg, err);
+	}
+	#elif defined(_WIN32)
+	BIG_WORD bwSize = {.full = src->off.fstart_to_page};
+	int64_t remaining_space = src->file_size - src->off.fstart_to_page;
+	int64_t map_size = src->rd.bytesize < remaining_space ? src->rd.bytesize : 0; // 0 means rest of file
+	src->rd.start = MapViewOfFile(
+		src->map_handle,
+		FILE_MAP_READ,
+		bwSize.parts[1], bwSize.parts[0], //little-endian only
+		map_size
+	);
 
-		int read_rows = read_chunk(
-			&rdbuff, &cpbuff, &row_lo,
-			&map_offsets, file_size,
-			&INPUT_READING_COMPLETE
-		);
+	if (src->rd.start == NULL){
+		die("Couldn't map a view of input file", EX_OSERR);
+	}
+	#endif
+}
+
+void unmap_source_window(SourceReader *src) {
+	#if defined(__APPLE__) || defined(__LINUX__)
+	// the stream drops what was parsed on its next window
+	if (src->mode == READ_STREAM) return;
+
+	if (src->mode == READ_MMAP_WHOLE) {
+		// the pages before the next read pointer are done with, releasing
+		// them keeps the resident memory to about a window
+		uint64_t done = src->complete ? src->file_size : src->off.fstart_to_page;
+		if (done > src->released) {
+			madvise(src->file_map + src->released, done - src->released, MADV_DONTNEED);
+			src->released = done;
+		}
+		return;
+	}
+	munmap(src->rd.start, src->rd.bytesize); // size == byte_size since sizeof(char) == 1
+	#elif defined(_WIN32)
+	UnmapViewOfFile(src->rd.start);
+	#endif
+}
+
+void print_read_stats(const ReadStats *rs) {
+	if (rs->big_fields || rs->small_fields) {
+		printf("unexpected size of field:");
+		if (rs->big_fields) printf("    too big x %lld", (long long) rs->big_fields);
+		if (rs->small_fields) printf("    too small x %lld", (long long) rs->small_fields);
+		printf(ENDL);
+	}
+	if (rs->short_rows || rs->long_rows) {
+		printf("unexpected number of fields:");
+		if (rs->short_rows) printf("    short rows x %lld", (long long) rs->short_rows);
+		if (rs->long_rows) printf("    long rows x %lld", (long long) rs->long_rows);
+		printf(ENDL);
+	}
+}
 
-		printf("data successfully converted to float [%d]" ENDL, tile_row);
+/*! Points `ch->cached` at the next rows of the mapped value cache, where
+ *  they are already converted, instead of parsing them.
+ */
+void take_cached_rows(SourceReader *src, Chunk *ch, const RowLayout *row_lo) {
+	const ValueCache *vc = src->cache;
+	int64_t first = row_at_offset(&vc->rows, src->off.fstart_to_readptr);
+	int64_t end = row_at_offset(&vc->rows, src->file_size);
+	int64_t rows = end - first < ch->cp.row_count ? end - first : ch->cp.row_count;
+
+	ch->cached = (CompBuffer) {
+		.row_length = vc->row_length,
+		.row_count = (int32_t) rows,
+		.bytesize = rows * vc->row_length * (int64_t) sizeof(float),
+		.start = (float *) vc->values + first * vc->row_length + row_lo->first_field
+	};
+	ch->read_rows = (int32_t) rows;
+	ch->rstats = (ReadStats) {0};
 
+	src->off.fstart_to_readptr = vc->rows.row_starts[first + rows];
+	src->complete = first + rows == end;
+}
+
+/*! Maps the next window of the source and converts it into `ch->cp`.
+ *  Only one chunk can be parsed at a time since `src` is a cursor.
+ *  With a mapped value cache, the rows are taken from it instead.
+ */
+void parse_stage(SourceReader *src, Chunk *ch, const RowLayout *row_lo) {
+	double start = monotonic_seconds();
+	uint64_t read_from = src->off.fstart_to_readptr;
+	ch->tile_row = src->next_tile_row++;
+	printf("processing chunk [%d]" ENDL, ch->tile_row);
+
+	if (src->cache != NULL && src->cache->map != NULL) {
+		take_cached_rows(src, ch, row_lo);
+		ch->last = src->complete;
+		ch->source_end = src->off.fstart_to_readptr;
+		ch->read_bytes = (int64_t) (src->off.fstart_to_readptr - read_from);
+		ch->stage_seconds[PARSE_STAGE] = monotonic_seconds() - start;
+		return;
+	}
+
+	map_source_window(src);
+	printf("file successfully mapped to memory [%d]" ENDL, ch->tile_row);
+
+	ch->rstats = (ReadStats) {0};
+	ch->read_rows = read_chunk(
+		&src->rd, &ch->cp, &src->idx, &src->pool, row_lo,
+		&src->off, src->file_size, src->rows,
+		&ch->rstats, &src->complete
+	);
+	ch->last = src->complete;
+
+	printf("data successfully converted to float [%d]" ENDL, ch->tile_row);
+	print_read_stats(&ch->rstats);
+
+	if (!ch->last && ch->read_rows < ch->cp.row_count) {
+		die("rows are longer than the configured max_field_size allows", EX_DATAERR);
+	}
+
+	unmap_source_window(src);
+	if (src->cache != NULL && src->cache->fp != NULL) {
+		int cache_err = append_ValueCache(src->cache, ch->cp.start, ch->read_rows, src->idx.row_starts, read_from);
+		if (cache_err) {
+			printf("WARNING: could not write the value cache (%s), it is dropped" ENDL, strerror(cache_err));
+			close_ValueCache(src->cache);
+		}
+	}
+	ch->source_end = src->off.fstart_to_readptr;
+	ch->read_bytes = (int64_t) (src->off.fstart_to_readptr - read_from);
+	ch->stage_seconds[PARSE_STAGE] = monotonic_seconds() - start;
+}
+
+/*! Subsamples `ch->cp` and formats the result in freshly allocated
+ *  tile and full file buffers. Chunks are independent at this stage.
+ *  `ch->pv` only describes the subsampled values, it is only allocated
+ *  when they feed a pyramid, and then released by write_stage.
+ */
+void format_stage(Chunk *ch, const Config *conf, const RowLayout *row_lo, const char *dir, FullFile *full) {
+	double start = monotonic_seconds();
+	ch->stage_seconds[WRITE_STAGE] = 0;
+	init_ProcValBufferStruct(&ch->pv, row_lo, conf);
+
+	// Only compute as much as was parsed
+	if (ch->last) {
+		// calc write buff row count again
+		printf("last chunk reached [%d]" ENDL, ch->tile_row);
+		ch->pv.row_count = ch->read_rows / conf->downsample_factor;
+		ch->pv.bytesize = (int64_t) ch->pv.row_count * ch->pv.row_length * sizeof(float);
+	}
+
+	alloc_output_buffers(&ch->pv, &ch->wr, &ch->ff, conf, row_lo, dir, ch->tile_row, full);
+
+	// a single row of averages instead of the whole ProcValBuffer,
+	// unless the pyramid needs them once written
+	char keep_values = conf->pyramid_levels > 1;
+	int64_t values_stride = keep_values ? ch->pv.row_length : 0;
+	if (ch->values == NULL) {
+		int64_t value_rows = keep_values ? chunk_height(conf) : 1;
+		ch->values = (float *) malloc(value_rows * ch->pv.row_length * sizeof(float));
+		if (ch->values == NULL) die("Out of Memory (malloc row_scratch).", EX_OSERR);
+	}
+
+	printf("subsampling and filling file buffers [%d]" ENDL, ch->tile_row);
+	int write_overflow = subsample_and_format(
+		ch->cached.start != NULL ? &ch->cached : &ch->cp, ch->pv.row_count,
+		conf->downsample_factor, conf->downsample_filter, conf->engine,
+		&ch->wr, &ch->ff, ch->values, values_stride
+	);
+	if (write_overflow) {
+		printf("values too wide for the output format x %d [%d]" ENDL, write_overflow, ch->tile_row);
+	}
+
+	ch->pv.start = keep_values ? ch->values : NULL;
+	ch->stage_seconds[FORMAT_STAGE] = monotonic_seconds() - start;
+}
+
+/*! Writes the tiles and the chunk's rows of the full file, unless a
+ *  formatter already did, then releases the buffers allocated by
+ *  format_stage. Chunks must be written in order.
+ *  With a pyramid, the chunk's values then cascade down the next levels.
+ */
+void write_stage(Chunk *ch, const Config *conf, const RowLayout *row_lo, Pyramid *pyr, FullFile *full) {
+	double start = monotonic_seconds();
+	const char *dir = pyr == NULL ? conf->dest : pyr->levels[0].dir;
+
+	printf("writing to files [%d]" ENDL, ch->tile_row);
+	report_output(&run_report, &ch->wr, &ch->ff);
+	if (ch->wr.mapped) {
+		unmap_output_buffers(&ch->wr, &ch->ff, dir, ch->tile_row, full);
+	} else {
+		if (conf->band_height) append_band_to_files(&band_writer, &ch->wr, dir, ch->tile_row, ch->last);
+		else write_buffers_to_files(&ch->wr, dir, ch->tile_row);
+		if (!ch->ff_written && !full->failed) ch->ff_error = write_full_rows(full, &ch->ff, ch->tile_row);
+		account_full_rows(full, &ch->ff, ch->ff_error);
+		free_output_buffers(&ch->wr, &ch->ff);
+	}
+	ch->ff_written = 0;
+	ch->ff_error = 0;
+
+	if (pyr != NULL) {
+		for (int32_t row = 0; row < ch->pv.row_count; row++) {
+			pyramid_push_row(pyr, 1, ch->pv.start + (int64_t) row * ch->pv.row_length);
+		}
+		if (ch->last) pyramid_flush(pyr);
+		ch->pv.start = NULL;
+	}
+	commit_written_chunk(ch, conf, row_lo, pyr, full);
+
+	ch->stage_seconds[WRITE_STAGE] += monotonic_seconds() - start;
+	if (report_chunk(&run_report, ch)) die("Out of Memory (run report)", EX_OSERR);
+	printf("chunk processed [%d]" ENDL, ch->tile_row);
+}
+
+// ================================= PIPELINE =================================
+#if defined(__APPLE__) || defined(__LINUX__)
+/*  Pipelined mode:
+ *
+ *  One thread parses, `formatters` threads subsample, format and write
+ *  their rows of the full file, and the main thread writes the tiles.
+ *  Chunks circulate in a ring of slots, which is what bounds the queues
+ *  between the stages: the parser waits for a FREE slot,
+ *  formatters for a PARSED one and the writer for the next FORMATTED one,
+ *  in tile row order, so the output is the same as the serial run's.
+ *
+ *  Every slot owns a CompBuffer, so memory grows with the thread count.
+ */
+
+typedef enum {
+	SLOT_FREE       = 0,
+	SLOT_PARSED     = 1,
+	SLOT_FORMATTING = 2,
+	SLOT_FORMATTED  = 3
+} SlotState;
+
+typedef struct {
+	Chunk *chunks;
+	SlotState *states;
+	int slot_count;
+	int next_format;
+	int chunk_count; // -1 until the last chunk has been parsed
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	SourceReader *src;
+	const Config *conf;
+	const RowLayout *row_lo;
+	const char *dir;
+	FullFile *full;
+} Pipeline;
+
+static void set_slot_state(Pipeline *pl, int seq, SlotState state) {
+	pthread_mutex_lock(&pl->lock);
+	pl->states[seq % pl->slot_count] = state;
+	pthread_cond_broadcast(&pl->changed);
+	pthread_mutex_unlock(&pl->lock);
+}
+
+static void wait_slot_state(Pipeline *pl, int seq, SlotState state) {
+	pthread_mutex_lock(&pl->lock);
+	while (pl->states[seq % pl->slot_count] != state) {
+		pthread_cond_wait(&pl->changed, &pl->lock);
+	}
+	pthread_mutex_unlock(&pl->lock);
+}
+
+static void *parse_worker(void *arg) {
+	Pipeline *pl = (Pipeline *) arg;
+
+	for (int seq = 0; !pl->src->complete; seq++) {
+		wait_slot_state(pl, seq, SLOT_FREE);
+		parse_stage(pl->src, pl->chunks + seq % pl->slot_count, pl->row_lo);
+
+		pthread_mutex_lock(&pl->lock);
+		pl->states[seq % pl->slot_count] = SLOT_PARSED;
+		if (pl->src->complete) pl->chunk_count = seq + 1;
+		pthread_cond_broadcast(&pl->changed);
+		pthread_mutex_unlock(&pl->lock);
+	}
+	return NULL;
+}
+
+static void *format_worker(void *arg) {
+	Pipeline *pl = (Pipeline *) arg;
+
+	for (;;) {
+		pthread_mutex_lock(&pl->lock);
+		while (
+			pl->next_format != pl->chunk_count
+			&& pl->states[pl->next_format % pl->slot_count] != SLOT_PARSED
+		) {
+			pthread_cond_wait(&pl->changed, &pl->lock);
+		}
+		if (pl->next_format == pl->chunk_count) {
+			pthread_mutex_unlock(&pl->lock);
+			return NULL;
+		}
+		int seq = pl->next_format++;
+		pl->states[seq % pl->slot_count] = SLOT_FORMATTING;
+		pthread_mutex_unlock(&pl->lock);
+
+		Chunk *ch = pl->chunks + seq % pl->slot_count;
+		format_stage(ch, pl->conf, pl->row_lo, pl->dir, pl->full);
+
+		// rows of the full file have their own offset, no need to wait
+		// for the previous chunks
+		if (!ch->wr.mapped) {
+			double start = monotonic_seconds();
+			ch->ff_error = write_full_rows(pl->full, &ch->ff, ch->tile_row);
+			ch->ff_written = 1;
+			ch->stage_seconds[WRITE_STAGE] = monotonic_seconds() - start;
+		}
+		set_slot_state(pl, seq, SLOT_FORMATTED);
+	}
+}
+
+void run_pipeline(
+	SourceReader *src,
+	const CompBuffer *cpbuff,
+	const Config *conf,
+	const RowLayout *row_lo,
+	Pyramid *pyr,
+	FullFile *full
+){
+	int formatters = conf->threads > 2 ? conf->threads - 2 : 1;
+
+	Pipeline pl = {0};
+	pl.slot_count = formatters + 3;
+	pl.chunk_count = -1;
+	pl.src = src;
+	pl.conf = conf;
+	pl.row_lo = row_lo;
+	pl.dir = pyr == NULL ? conf->dest : pyr->levels[0].dir;
+	pl.full = full;
+
+	pl.chunks = (Chunk *) calloc(pl.slot_count, sizeof(Chunk));
+	pl.states = (SlotState *) calloc(pl.slot_count, sizeof(SlotState));
+	if (pl.chunks == NULL || pl.states == NULL) die("Out of Memory (pipeline slots)", EX_OSERR);
+
+	// the 1st slot reuses the serial CompBuffer
+	pl.chunks[0].cp = *cpbuff;
+	for (int i = 1; i < pl.slot_count; i++) {
+		init_CompBufferStruct(&pl.chunks[i].cp, row_lo, conf);
+		pl.chunks[i].cp.start = (float *) malloc(pl.chunks[i].cp.bytesize);
+		if (pl.chunks[i].cp.start == NULL) {
+			print_size_info(pl.chunks[i].cp.bytesize);
+			die("Out of Memory (pipeline computation buffers)", EX_OSERR);
+		}
+	}
+
+	if (pthread_mutex_init(&pl.lock, NULL) || pthread_cond_init(&pl.changed, NULL)) {
+		die("could not initialize pipeline synchronization", EX_OSERR);
+	}
+
+	printf("pipelined mode: 1 parser, %d formatter(s), %d slots" ENDL, formatters, pl.slot_count);
+
+	pthread_t parser_thread;
+	pthread_t *formatter_threads = (pthread_t *) malloc(formatters * sizeof(pthread_t));
+	if (formatter_threads == NULL) die("Out of Memory (pipeline threads)", EX_OSERR);
+
+	if (pthread_create(&parser_thread, NULL, parse_worker, &pl))
+		die("could not start the parsing thread", EX_OSERR);
+	for (int i = 0; i < formatters; i++) {
+		if (pthread_create(formatter_threads + i, NULL, format_worker, &pl))
+			die("could not start a formatting thread", EX_OSERR);
+	}
+
+	// the main thread writes, in order
+	for (int seq = 0; ; seq++) {
+		wait_slot_state(&pl, seq, SLOT_FORMATTED);
+		Chunk *ch = pl.chunks + seq % pl.slot_count;
+		char last = ch->last;
+		write_stage(ch, conf, row_lo, pyr, full);
+		set_slot_state(&pl, seq, SLOT_FREE);
+		if (last) break;
+	}
+
+	pthread_join(parser_thread, NULL);
+	for (int i = 0; i < formatters; i++) pthread_join(formatter_threads[i], NULL);
+
+	pthread_cond_destroy(&pl.changed);
+	pthread_mutex_destroy(&pl.lock);
+	for (int i = 1; i < pl.slot_count; i++) free(pl.chunks[i].cp.start);
+	for (int i = 0; i < pl.slot_count; i++) free(pl.chunks[i].values);
+	free(formatter_threads);
+	free(pl.states);
+	free(pl.chunks);
+}
+#endif
+
+// ================================== MEMORY ==================================
+
+/*! Bytes of a formatted output row of `width` values, in its tiles and in
+ *  the full file.
+ */
+static void output_row_bytes(
+	const Config *conf,
+	const RowLayout *row_lo,
+	int64_t width,
+	int64_t *tile_bytes,
+	int64_t *full_bytes
+){
+	char binary = conf->output_format != OUTPUT_CSV;
+	int64_t field = conf->output_field_size;
+	if (binary) field = conf->output_format == OUTPUT_F16 ? sizeof(uint16_t) : sizeof(float);
+	int64_t sep = binary ? 0 : 1;
+	int64_t eol = binary ? 0 : (conf->eol_flag == EOL_UNIX ? 1 : 2);
+	int64_t tile_count = (width + conf->tile_width - 1) / conf->tile_width;
+	*tile_bytes = width * (field + sep) + tile_count * (eol - sep);
+
+	sep = binary ? 0 : row_lo->sep_size;
+	eol = binary ? 0 : row_lo->eol_size;
+	*full_bytes = width * (field + sep) - sep + eol;
+}
+
+/*! Estimates the peak size of every buffer when chunks are `chunk_rows`
+ *  output rows high, with as many chunks in flight as the pipeline holds.
+ */
+void estimate_footprint(
+	MemoryFootprint *mf,
+	const Config *conf,
+	const RowLayout *row_lo,
+	int32_t chunk_rows
+){
+	Config cf = *conf;
+	cf.band_height = chunk_rows < cf.tile_height ? chunk_rows : 0;
+	char banded = cf.band_height != 0;
+
+	*mf = (MemoryFootprint) {0};
+	mf->chunk_rows = chunk_height(&cf);
+	mf->chunks_in_flight = cf.threads > 1 ? (cf.threads > 2 ? cf.threads - 2 : 1) + 3 : 1;
+
+	ReadBuffer rd;
+	CompBuffer cb;
+	ChunkIndex idx;
+	init_ReadBufferStruct(&rd, row_lo, &cf);
+	init_CompBufferStruct(&cb, row_lo, &cf);
+	init_ChunkIndexStruct(&idx, row_lo, &cf);
+
+	mf->read = rd.bytesize;
+	if (cf.read_mode == READ_STREAM) mf->read += 2 * (int64_t) STREAM_BLOCK_SIZE;
+	mf->index = idx.bytesize;
+	mf->values = cb.bytesize * mf->chunks_in_flight;
+
+	// formatted rows and subsampled values of each chunk in flight
+	int64_t width = row_lo->window_fields / cf.downsample_factor;
+	int64_t tile_bytes, full_bytes;
+	output_row_bytes(&cf, row_lo, width, &tile_bytes, &full_bytes);
+	int64_t value_rows = cf.pyramid_levels > 1 ? mf->chunk_rows : 1;
+	int64_t chunk_output = mf->chunk_rows * (tile_bytes + full_bytes) + value_rows * width * (int64_t) sizeof(float);
+	mf->output = chunk_output * mf->chunks_in_flight;
+	// a row of tiles stays with io_uring while the next one is formatted
+	if (!banded && cf.write_mode != WRITE_STDIO && cf.write_mode != WRITE_MMAP) {
+		mf->output += mf->chunk_rows * tile_bytes;
+	}
+	// the stdio buffer of every tile left open between bands
+	if (banded) mf->output += ((width + cf.tile_width - 1) / cf.tile_width) * (int64_t) BUFSIZ;
+
+	// carry and pending rows of the next levels, and a row of tiles of
+	// each when flushed
+	for (int32_t k = 1; k < cf.pyramid_levels; k++) {
+		int64_t width_above = width;
+		width /= cf.downsample_factor;
+		output_row_bytes(&cf, row_lo, width, &tile_bytes, &full_bytes);
+		mf->pyramid += cf.downsample_factor * width_above * (int64_t) sizeof(float);
+		mf->pyramid += cf.tile_height * (width * (int64_t) sizeof(float) + tile_bytes + full_bytes);
+	}
+
+	mf->total = mf->read + mf->index + mf->values + mf->output + mf->pyramid;
+}
+
+/*! Bytes of an arena holding the output buffers of any chunk, or of any
+ *  row of tiles of the next pyramid levels.
+ */
+int64_t chunk_arena_size(const Config *conf, const RowLayout *row_lo) {
+	int64_t width = row_lo->window_fields / conf->downsample_factor;
+	int64_t rows = chunk_height(conf);
+	int64_t size = 0;
+	for (int32_t k = 0; k == 0 || k < conf->pyramid_levels; k++) {
+		int64_t tile_bytes, full_bytes;
+		output_row_bytes(conf, row_lo, width, &tile_bytes, &full_bytes);
+		int64_t tile_count = (width + conf->tile_width - 1) / conf->tile_width;
+
+		// each of the three buffers may be shifted to be aligned
+		int64_t level_size = tile_count * (int64_t) sizeof(FileBuffer) + 3 * ARENA_ALIGNMENT;
+		if (conf->write_mode != WRITE_MMAP) level_size += rows * (tile_bytes + full_bytes);
+		if (level_size > size) size = level_size;
+
+		width /= conf->downsample_factor;
+		rows = conf->tile_height;
+	}
+	return size;
+}
+
+static double mebibytes(int64_t bytes) {
+	return (double) bytes / (1 << 20);
+}
+
+const char *arena_backing_name(Arena_backing backing) {
+	switch (backing) {
+		case ARENA_HUGETLB: return "in preallocated huge pages";
+		case ARENA_HUGE_PAGES: return "in transparent huge pages";
+		case ARENA_PAGES: return "in anonymous pages";
+		default: return "malloc'd";
+	}
+}
+
+/*! Prints the footprint of the buffers and, with memory_limit, thins the
+ *  chunks into bands of fewer rows until they fit. Dies when even bands
+ *  of a single row do not.
+ */
+void fit_memory_limit(Config *conf, const RowLayout *row_lo) {
+	MemoryFootprint mf;
+	int32_t rows = chunk_height(conf);
+	estimate_footprint(&mf, conf, row_lo, rows);
+
+	if (conf->memory_limit) {
+		// bands must still split rows of tiles evenly
+		while (mf.total > conf->memory_limit && rows > 1) {
+			do rows--; while (conf->tile_height % rows);
+			estimate_footprint(&mf, conf, row_lo, rows);
+		}
+		if (mf.total > conf->memory_limit) {
+			char msg[ERR_MSG_SIZE];
+			// in bytes, MiB would round small limits down to 0.0
+			snprintf(
+				msg, sizeof(msg),
+				"memory_limit of %lld bytes is too low, bands of a single row need %lld bytes, set it to %lldK at least",
+				(long long) conf->memory_limit, (long long) mf.total, (long long) ((mf.total + 1023) >> 10)
+			);
+			die(msg, EX_CONFIG);
+		}
+		if (rows != chunk_height(conf)) {
+			printf("memory_limit of %.1f MiB reached, processing bands of %d rows" ENDL, mebibytes(conf->memory_limit), rows);
+			conf->band_height = rows < conf->tile_height ? rows : 0;
+		}
+	}
+
+	printf("memory footprint with chunks of %d rows: %.1f MiB" ENDL, mf.chunk_rows, mebibytes(mf.total));
+	printf("    source buffer       %10.1f MiB" ENDL, mebibytes(mf.read));
+	printf("    chunk index         %10.1f MiB" ENDL, mebibytes(mf.index));
+	printf("    parsed values x%-3d  %10.1f MiB" ENDL, mf.chunks_in_flight, mebibytes(mf.values));
+	printf("    output buffers x%-3d %10.1f MiB" ENDL, mf.chunks_in_flight, mebibytes(mf.output));
+	if (conf->pyramid_levels > 1) printf("    pyramid levels      %10.1f MiB" ENDL, mebibytes(mf.pyramid));
+}
+
+/*! Files the run keeps open next to the tiles appended band after band:
+ *  the standard streams, the source, the value cache being written, and
+ *  a full file per pyramid level. One more is left for the files opened
+ *  for a moment, a journal commit, a tile of the next levels, or a tile
+ *  reopened for a band.
+ */
+static int32_t held_files(const Config *conf) {
+	int32_t levels = conf->pyramid_levels > 1 ? conf->pyramid_levels : 1;
+	return 3 + 1 + (conf->value_cache ? 1 : 0) + levels + 1;
+}
+
+
+#ifndef PARSER_NO_MAIN
+int main(int argc, char* argv[]){
+	/*
+	*	Initialization phase:
+	*
+	*	init a bunch of variables
+	*	compute a bunch of useful values
+	*	alloc some memory for some specific buffers
+	*
+	*/
+
+	if (argc != 2) die("Wrong number of arguments", EX_USAGE);
+	init_RunReport(&run_report);
+
+	// get config
+	Config conf = {0};
+
+	printf("reading config file" ENDL);
+	if (get_config(argv[1], &conf)) die("Invalid config file", EX_DATAERR);
+
+	// 1/2 scale unless configured otherwise
+	if (conf.downsample_factor == 0) conf.downsample_factor = 2;
+
+	// thousandths only make sense down to text
+	if (conf.engine == ENGINE_FIXED && conf.output_format != OUTPUT_CSV) {
+		printf("WARNING: engine = fixed only writes csv, using the float engine" ENDL);
+		conf.engine = ENGINE_FLOAT;
+	}
+	if (conf.engine == ENGINE_FIXED && conf.value_cache) {
+		printf("WARNING: the value cache holds floats, it is not used with engine = fixed" ENDL);
+		conf.value_cache = 0;
+	}
+
+	int dest_dir_err = check_or_create_dest_dir(conf.dest);
+	// the files of an interrupted run, picked up once the source is open
+	char resuming = dest_dir_err == DC_NON_HIDDEN_ENTRIES && conf.resume && journal_exists(conf.dest);
+	if (dest_dir_err && !resuming) handle_dest_dir_check(dest_dir_err);
+
+	// open source file
+	printf("input file path = `%s`" ENDL, conf.source);
+	#ifdef _WIN32
+	input_fp = fopen(conf.source, "rb");
+
+	if (atexit(close_input_fp)) {
+		die("could not set file auto-closing at exit", EX_SOFTWARE);
+	}
+	if (input_fp == NULL) specify_os_error_and_exit();
+	#else
+	input_fd = open(conf.source, O_RDONLY);
+	if (atexit(close_input_fd)) {
+		die("could not set file auto-closing at exit", EX_SOFTWARE);
+	}
+	// printf("input file descriptor = %d" ENDL, input_fd);
+	if (input_fd < 0) specify_os_error_and_exit();
+	#endif
+
+	ErrMsg rl_err = {0};
+	RowLayout row_lo = {0};
+	#ifdef _WIN32
+	if (get_row_layout_from_fp(&row_lo, &conf, input_fp, &rl_err)) {
+		die(rl_err.msg, rl_err.val);
+	}
+	#else
+	if (get_row_layout(&row_lo, &conf, input_fd, &rl_err)) {
+		die(rl_err.msg, rl_err.val);
+	}
+	#endif
+
+	// only the columns of the window are converted, see convert_rows
+	if (conf.roi_col_end) {
+		if (conf.roi_col_end > row_lo.field_count) {
+			printf("the rows of the source have %d fields" ENDL, row_lo.field_count);
+			die("roi_cols goes past the last column of the source", EX_CONFIG);
+		}
+		row_lo.first_field = conf.roi_col_first;
+		row_lo.window_fields = conf.roi_col_end - conf.roi_col_first;
+		if (row_lo.window_fields < conf.downsample_factor) {
+			die("roi_cols is narrower than downsample_factor", EX_CONFIG);
+		}
+		printf("converting columns %d to %d" ENDL, conf.roi_col_first, conf.roi_col_end - 1);
+	}
+
+	// bands must split rows of tiles evenly
+	if (conf.band_height >= conf.tile_height) conf.band_height = 0;
+	if (conf.band_height) {
+		unsigned short band = conf.band_height;
+		while (conf.tile_height % band) band--;
+		if (band != conf.band_height) {
+			printf("WARNING: band_height must divide tile_height, using %d" ENDL, band);
+			conf.band_height = band;
+		}
+	}
+	fit_memory_limit(&conf, &row_lo);
+	if (conf.band_height) {
+		if (conf.write_mode == WRITE_URING || conf.write_mode == WRITE_MMAP) {
+			printf("WARNING: tiles are written band after band with fopen/fwrite, write_mode ignored" ENDL);
+		}
+		conf.write_mode = WRITE_STDIO;
+	}
+
+	uint64_t file_size = 0;
+
+	#if defined(__APPLE__) || defined(__LINUX__)
+	file_size = file_size_from_fd(input_fd);
+	if (file_size == 0) die("could not read source file stats", EX_OSERR);
+
+	#elif defined(_WIN32)
+	// on windows platforms, we will use a HANDLE pointer
+	// for the rest of the program.
+	if (fclose(input_fp)) die("could not close input file correctly", EX_OSERR);
+
+	ErrMsg filehandle_err = {0};
+	HANDLE input_handle = get_normal_file_handle(conf.source, &filehandle_err);
+	if (input_handle == INVALID_HANDLE_VALUE) {
+		die(filehandle_err.msg, filehandle_err.val);
+	}
+
+	file_size = file_size_from_handle(input_handle);
+	if (file_size == 0) die("could not read source file stats", EX_SOFTWARE);
+
+	HANDLE map_handle = CreateFileMapping(
+		input_handle, NULL, PAGE_READONLY, 0, 0, NULL
+	);
+	if (map_handle == NULL)
+		die("could not create file mapping object", EX_OSERR);
+	#endif
+
+
+	// exact with a row index, an upper bound otherwise
+	int64_t source_rows = max_source_rows(&row_lo, file_size);
+	RowIndex row_index = {0};
+	if (conf.row_index) {
 		#if defined(__APPLE__) || defined(__LINUX__)
-		munmap(rdbuff.start, rdbuff.bytesize); // size == byte_size since sizeof(char) == 1
-		#elif defined(_WIN32)
-		UnmapViewOfFile(rdbuff.start);
+		Row_index_status status = open_RowIndex(&row_index, conf.source, input_fd);
+		if (status == ROW_INDEX_LOADED) printf("rows of the source loaded from its " ROW_INDEX_SUFFIX " sidecar" ENDL);
+		else if (status == ROW_INDEX_BUILT) printf("rows of the source indexed in its " ROW_INDEX_SUFFIX " sidecar" ENDL);
+		else if (status == ROW_INDEX_NOT_SAVED) printf("WARNING: rows of the source indexed, but its " ROW_INDEX_SUFFIX " sidecar could not be written" ENDL);
+		else printf("WARNING: could not index the rows of the source, they are looked for chunk after chunk" ENDL);
+		#else
+		printf("WARNING: row_index is not available on this platform" ENDL);
 		#endif
+		if (row_index.row_starts != NULL) {
+			printf("%lld rows in the source" ENDL, (long long) row_index.row_count);
+			source_rows = row_index.row_count;
+		}
+	}
 
-		// comp
-		// Only compute as much as was parsed
-		if (INPUT_READING_COMPLETE) {
-			// calc write buff row count again
-			printf("last chunk reached [%d]" ENDL, tile_row);
-			pvbuff.row_count = read_rows / 2;
-			pvbuff.bytesize = (int64_t) pvbuff.row_count * pvbuff.row_length * sizeof(float);
+	// values converted by a previous run, the source is then not parsed
+	ValueCache value_cache = {0};
+	Value_cache_status cache_status = VALUE_CACHE_FAILED;
+	if (conf.value_cache) {
+		#if defined(__APPLE__) || defined(__LINUX__)
+		cache_status = open_ValueCache(&value_cache, conf.source, input_fd, row_lo.field_count);
+		if (cache_status == VALUE_CACHE_LOADED) printf("values of the source mapped from %s" ENDL, value_cache.path);
+		else if (cache_status == VALUE_CACHE_FAILED) printf("WARNING: could not look for the value cache of the source" ENDL);
+		#else
+		printf("WARNING: value_cache is not available on this platform" ENDL);
+		#endif
+	}
+	char cache_loaded = cache_status == VALUE_CACHE_LOADED;
+
+	// the rows of the source, found by the cache or the index if any
+	const RowIndex *source_index = row_index.row_starts != NULL ? &row_index : NULL;
+	if (cache_loaded) source_index = &value_cache.rows;
+	if (source_index != NULL) source_rows = source_index->row_count;
+
+	// only the rows of the window are read, the source is cut to them
+	uint64_t source_start = 0;
+	uint64_t source_end = file_size;
+	if (conf.roi_row_end) {
+		int64_t rows_before = conf.roi_row_first;
+		int64_t rows_in = conf.roi_row_end - conf.roi_row_first;
+		if (source_index != NULL) {
+			if (rows_before > source_index->row_count) rows_before = source_index->row_count;
+			if (rows_in > source_index->row_count - rows_before) rows_in = source_index->row_count - rows_before;
+			source_start = source_index->row_starts[rows_before];
+			source_end = source_index->row_starts[rows_before + rows_in];
+		} else {
+			#ifdef _WIN32
+			// the source handle is only mapped, the rows are skipped with a
+			// descriptor of their own
+			int skip_fd = _open(conf.source, _O_RDONLY | _O_BINARY);
+			#else
+			int skip_fd = input_fd;
+			#endif
+			rows_before = skip_fd < 0 ? -1 : skip_rows(skip_fd, file_size, &source_start, rows_before);
+			source_end = source_start;
+			rows_in = rows_before < 0 ? -1 : skip_rows(skip_fd, file_size, &source_end, rows_in);
+			#ifdef _WIN32
+			if (skip_fd >= 0) _close(skip_fd);
+			#endif
+			if (rows_in < 0) die("could not read the source", EX_IOERR);
+		}
+		if (rows_before < conf.roi_row_first || rows_in == 0) {
+			die("roi_rows starts past the last row of the source", EX_CONFIG);
+		}
+		if (rows_in < conf.roi_row_end - conf.roi_row_first) {
+			printf("the source has %lld rows" ENDL, (long long) (rows_before + rows_in));
+			die("roi_rows goes past the last row of the source", EX_CONFIG);
 		}
+		if (rows_in < conf.downsample_factor) {
+			die("roi_rows is narrower than downsample_factor", EX_CONFIG);
+		}
+		printf(
+			"converting rows %lld to %lld, bytes %llu to %llu of the source" ENDL,
+			(long long) conf.roi_row_first, (long long) (conf.roi_row_first + rows_in - 1),
+			(unsigned long long) source_start, (unsigned long long) source_end
+		);
+		source_rows = rows_in;
+	}
 
-		pvbuff.start = (float *) malloc(pvbuff.bytesize);
-		if (pvbuff.start == NULL) die("Out of Memory (malloc pvbuff).", EX_OSERR);
+	// the source and settings a journal belongs to
+	uint64_t fingerprint = 0;
+	if (conf.resume) {
+		struct stat source_stat;
+		#ifdef _WIN32
+		int stat_err = stat(conf.source, &source_stat);
+		#else
+		int stat_err = fstat(input_fd, &source_stat);
+		#endif
+		fingerprint = run_fingerprint(&conf, file_size, stat_err ? 0 : (int64_t) source_stat.st_mtime);
+	}
 
-		subsample(&cpbuff, &pvbuff);
-		
-		printf("subsampling finished [%d]" ENDL, tile_row);
-
-		WriteBuffer wrbuff = {0};
-		if (init_WriteBufferStruct(&wrbuff, &pvbuff, &conf))
-			die("Out of Memory (malloc wrbuff->file_buffers)", EX_OSERR);
-
-		wrbuff.buffer = (char *) malloc(wrbuff.bytesize);
-		if(wrbuff.buffer == NULL)
-			die("Out of Memory (malloc wrbuff->buffer)", EX_OSERR);
-
-		asign_filebuffers(&wrbuff);
-
-		FullFileBuffer ffbuff = {0};
-		init_FullFileBuffer(
-			&ffbuff,
-			pvbuff.row_length,
-			pvbuff.row_count,
-			conf.output_field_size,
-			row_lo.sep_size,
-			row_lo.eol_size
+	JournalEntry resume_from = {0};
+	if (resuming) {
+		Journal_status status = read_journal(conf.dest, fingerprint, &resume_from);
+		if (status == JOURNAL_MISMATCH) {
+			die("the destination was written from another source or with other settings, it can't be resumed", EX_CONFIG);
+		}
+		if (status != JOURNAL_FOUND) die("could not read the journal of the destination", EX_DATAERR);
+		char within_window = resume_from.next_chunk == 0
+			|| (resume_from.source_offset >= source_start && resume_from.source_offset <= source_end);
+		if (!within_window || !is_row_start(source_index, resume_from.source_offset, file_size)) {
+			die("the journal does not match the source, it can't be resumed", EX_DATAERR);
+		}
+		printf(
+			"resuming at chunk %d, after %lld rows and %llu bytes of the source" ENDL,
+			resume_from.next_chunk, (long long) resume_from.rows, (unsigned long long) resume_from.source_offset
 		);
-		ffbuff.buffer = malloc(ffbuff.bytesize);
-		if(ffbuff.buffer == NULL)
-			die("Out of Memory (malloc ffbuff->buffer)", EX_OSERR);
-
-		printf("filling file buffers [%d]" ENDL, tile_row);
-		fill_filebuffers(&pvbuff, &wrbuff);
-		fill_fullfile_buffer(&ffbuff, &wrbuff);
-
-		printf("writing to files [%d]" ENDL, tile_row);
-		write_buffers_to_files(&wrbuff, &conf, tile_row);
-		if (!FULLFILE_FAILED) {
-			FULLFILE_FAILED = write_FullFileBuffer_to_file(&ffbuff, &conf);
+	}
+
+	// written along the first run over the whole source
+	if (cache_status == VALUE_CACHE_MISSING) {
+		if (conf.roi_row_end || conf.roi_col_end || resume_from.next_chunk > 0) {
+			printf("WARNING: the value cache is only written by runs converting the whole source" ENDL);
+		} else {
+			int cache_err = start_ValueCache(&value_cache);
+			if (cache_err) printf("WARNING: could not write the value cache (%s)" ENDL, strerror(cache_err));
+			else printf("values of the source cached in %s" ENDL, value_cache.path);
 		}
+	}
 
+	SourceReader reader = {0};
+	reader.file_size = source_end;
+	reader.rows = source_index;
+	if (conf.value_cache) reader.cache = &value_cache;
+	#if defined(_WIN32)
+	reader.map_handle = map_handle;
+	#endif
+	init_ReadBufferStruct(&reader.rd, &row_lo, &conf);
+
+	// the source is read from the window, or the last commit, on
+	uint64_t read_from = resume_from.next_chunk > 0 ? resume_from.source_offset : source_start;
+	reader.next_tile_row = resume_from.next_chunk;
+	reader.off.fstart_to_readptr = read_from;
+	reader.off.page_to_readptr = read_from % reader.rd.page_bytesize;
+	reader.off.fstart_to_page = read_from - reader.off.page_to_readptr;
+	if (!cache_loaded) {
+		open_source_map(&reader, &conf);
+		if (reader.mode == READ_STREAM) printf("source read with pread, %d MiB at a time" ENDL, STREAM_BLOCK_SIZE >> 20);
+		else printf("source mapped %s" ENDL, reader.mode == READ_MMAP_WHOLE ? "at once" : "chunk by chunk");
+	}
 
-		free(pvbuff.start);
-		free(wrbuff.file_buffers);
-		free(wrbuff.buffer);
-		free(ffbuff.buffer);
+	CompBuffer cpbuff = {0};
+	if (init_CompBuffer(&cpbuff, &row_lo, &conf)) die("Out of memory", EX_SOFTWARE);
 
-		printf("chunk processed [%d]" ENDL, tile_row);
+	if (init_ChunkIndex(&reader.idx, &row_lo, &conf)) die("Out of memory", EX_SOFTWARE);
 
-		tile_row++;
+	int parse_threads = conf.parse_threads < MAX_PARSE_THREADS ? conf.parse_threads : MAX_PARSE_THREADS;
+	if (init_WorkerPool(&reader.pool, parse_threads)) die("could not start the parsing threads", EX_OSERR);
+	if (reader.pool.thread_count > 1) {
+		printf("rows of each chunk are parsed by %d threads" ENDL, reader.pool.thread_count);
 	}
+	printf(
+		"downsampling at 1/%d with the %s filter" ENDL,
+		conf.downsample_factor, filter_name(conf.downsample_filter)
+	);
+	if (conf.engine == ENGINE_FIXED) printf("values kept in thousandths, averaged with integers" ENDL);
+	else printf("subsampling with %s instructions" ENDL, subsample_row_isa());
+	printf("writing .%s files" ENDL, output_extension(conf.output_format));
+
+	int32_t out_width = row_lo.window_fields / conf.downsample_factor;
+	int32_t tiles_per_row = (out_width + conf.tile_width - 1) / conf.tile_width;
+
+	if (conf.band_height) {
+		if (init_BandWriter(&band_writer, &conf, tiles_per_row, held_files(&conf))) die("Out of Memory (band writer columns)", EX_OSERR);
+		printf("processing bands of %d rows, %d per row of tiles" ENDL, conf.band_height, band_writer.bands_per_tile_row);
+	}
+
+	open_tile_writer(&conf, tiles_per_row);
+	#if !(defined(__APPLE__) || defined(__LINUX__))
+	if (conf.write_mode == WRITE_MMAP) {
+		printf("WARNING: write_mode = mmap is not available on this platform, using stdio" ENDL);
+		conf.write_mode = WRITE_STDIO;
+	}
+	#endif
+	if (tile_writer_ready) printf("tiles written with io_uring, a row at a time" ENDL);
+	else if (conf.write_mode == WRITE_MMAP) printf("tiles formatted in place in mapped files" ENDL);
+	else printf("tiles written with fopen/fwrite" ENDL);
+
+	if (init_ArenaPool(&chunk_arenas, chunk_arena_size(&conf, &row_lo))) {
+		die("could not set up the pool of output buffers", EX_OSERR);
+	}
+
+	// 0 and 1 both mean a single level, written straight to dest
+	Pyramid pyramid = {0};
+	Pyramid *pyr = NULL;
+	FullFile dest_full = {0};
+	FullFile *full = &dest_full;
+	LevelOutput level_output = {&conf, &row_lo};
+	if (resuming) {
+		int32_t removed = 0;
+		if (check_resumed_tiles(&conf, &row_lo, &resume_from, &removed)) {
+			die("the destination does not match its journal, it can't be resumed", EX_DATAERR);
+		}
+		if (removed) printf("%d tiles written past the last commit removed" ENDL, removed);
+	}
+	if (conf.pyramid_levels > 1) {
+		int pyramid_err = init_Pyramid(&pyramid, &conf, row_lo.window_fields, flush_pyramid_level, &level_output);
+		if (pyramid_err == 2) die("pyramid_levels is too high for the width of the source", EX_CONFIG);
+		if (pyramid_err) die("Out of Memory (pyramid levels)", EX_OSERR);
+		pyr = &pyramid;
+		open_pyramid_levels(pyr, &conf, &row_lo, source_rows, resuming ? &resume_from : NULL);
+		full = &pyr->levels[0].full;
+		printf("writing a pyramid of %d levels, in level1 to level%d" ENDL, pyr->level_count, pyr->level_count);
+	} else {
+		open_output_full_file(
+			&dest_full, conf.dest, &conf, &row_lo, out_width,
+			chunk_height(&conf), source_rows / conf.downsample_factor, resume_from.rows
+		);
+	}
+
+	if (conf.resume) {
+		journal.commit_rows = journal_commit_rows(&conf);
+		int journal_err = open_ResumeJournal(&journal, conf.dest, fingerprint, &resume_from);
+		if (journal_err) {
+			printf("WARNING: could not write %s (%s), the run can't be resumed" ENDL, journal.path, strerror(journal_err));
+		} else {
+			printf("progress committed to %s every %lld rows" ENDL, journal.path, (long long) journal.commit_rows);
+		}
+	}
+
+	// get source file size
+	printf("getting input file statistics" ENDL);
+
+
+
+	// printf("Input file size: " ENDL);
+	// print_size_info(file_size);
+
+	/*
+	 *=========================== Processing phase ============================
+	 */
+
+	printf("Setup finished, starting processing" ENDL);
+
+	char pipelined = conf.threads > 1;
+	#if !(defined(__APPLE__) || defined(__LINUX__))
+	if (pipelined) {
+		printf("WARNING: pipelined mode is not available on this platform, running serially" ENDL);
+		pipelined = 0;
+	}
+	#endif
+
+	if (pipelined) {
+		#if defined(__APPLE__) || defined(__LINUX__)
+		run_pipeline(&reader, &cpbuff, &conf, &row_lo, pyr, full);
+		#endif
+	} else {
+		Chunk chunk = {0};
+		chunk.cp = cpbuff;
+
+		// We don't know the number of rows in advance so no for loop
+		while(!reader.complete) {
+			parse_stage(&reader, &chunk, &row_lo);
+			format_stage(&chunk, &conf, &row_lo, pyr == NULL ? conf.dest : pyr->levels[0].dir, full);
+			write_stage(&chunk, &conf, &row_lo, pyr, full);
+		}
+		free(chunk.values);
+	}
+
+	close_tile_writer();
+	free_BandWriter(&band_writer);
+	free_WorkerPool(&reader.pool);
+	close_source_map(&reader);
+	free_RowIndex(&row_index);
+	if (value_cache.fp != NULL) {
+		int cache_err = finish_ValueCache(&value_cache);
+		if (cache_err) printf("WARNING: could not write the value cache (%s)" ENDL, strerror(cache_err));
+		else printf("value cache written to %s" ENDL, value_cache.path);
+	}
+	close_ValueCache(&value_cache);
+
+	if (pyr == NULL) {
+		close_FullFile(&dest_full);
+	} else {
+		for (int32_t k = 0; k < pyr->level_count; k++) close_FullFile(&pyr->levels[k].full);
+		free_Pyramid(pyr);
+	}
+	close_ResumeJournal(&journal, 1);
+
+	printf(
+		"output buffers: %d arenas of %.1f MiB, %s" ENDL,
+		chunk_arenas.arena_count, mebibytes(chunk_arenas.arena_bytesize), arena_backing_name(chunk_arenas.backing)
+	);
+	free_ArenaPool(&chunk_arenas);
 
 	/*
 	 *============================= Debrief phase =============================
 	 */
 
-	// print a report (number of rows parsed, errors? exceptions? exec time,
-	// average time per parsed value etc)
-	// exit
+	print_RunReport(&run_report);
+	if (conf.report_json[0] != '\0') {
+		int report_err = write_RunReport_json(&run_report, conf.report_json);
+		if (report_err) {
+			printf("ERROR n°%d: %s while writing the run report to %s" ENDL, report_err, strerror(report_err), conf.report_json);
+		} else {
+			printf("run report written to %s" ENDL, conf.report_json);
+		}
+	}
+	free_RunReport(&run_report);
 	exit(EX_OK);
 }
+#endif
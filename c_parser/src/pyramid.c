@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/pyramid.h"
+#include "../include/subsample.h"
+
+int init_Pyramid(Pyramid *pyr, const Config *conf, int32_t width, LevelFlush flush, void *ctx) {
+	*pyr = (Pyramid) {0};
+	pyr->level_count = conf->pyramid_levels;
+	pyr->factor = conf->downsample_factor;
+	pyr->filter = conf->downsample_filter;
+	pyr->engine = conf->engine;
+	pyr->flush = flush;
+	pyr->ctx = ctx;
+	pyr->levels = (PyramidLevel *) calloc(pyr->level_count, sizeof(PyramidLevel));
+	if (pyr->levels == NULL) return 1;
+
+	for (int32_t k = 0; k < pyr->level_count; k++) {
+		PyramidLevel *lvl = pyr->levels + k;
+		int32_t width_above = width;
+		width /= pyr->factor;
+		if (width == 0) return 2;
+		lvl->width = width;
+
+		// the first level is written straight from the chunks
+		if (k == 0) continue;
+
+		lvl->carry_length = width_above;
+		lvl->carry = (float *) malloc((int64_t) pyr->factor * width_above * sizeof(float));
+
+		lvl->pending_capacity = conf->tile_height;
+		lvl->pending.row_length = width;
+		lvl->pending.row_count = 0;
+		lvl->pending.bytesize = (int64_t) lvl->pending_capacity * width * sizeof(float);
+		lvl->pending.start = (float *) malloc(lvl->pending.bytesize);
+
+		if (lvl->carry == NULL || lvl->pending.start == NULL) return 1;
+	}
+	return 0;
+}
+
+void free_Pyramid(Pyramid *pyr) {
+	for (int32_t k = 0; pyr->levels != NULL && k < pyr->level_count; k++) {
+		free(pyr->levels[k].carry);
+		free(pyr->levels[k].pending.start);
+	}
+	free(pyr->levels);
+	pyr->levels = NULL;
+}
+
+/*! Hands the pending rows of level `k` to the flush callback, if any. */
+static void flush_level(Pyramid *pyr, int32_t k) {
+	PyramidLevel *lvl = pyr->levels + k;
+	if (lvl->pending.row_count == 0) return;
+
+	pyr->flush(pyr->ctx, lvl, k);
+	lvl->pending.row_count = 0;
+}
+
+void pyramid_push_row(Pyramid *pyr, int32_t k, const float *row) {
+	if (k >= pyr->level_count) return;
+	PyramidLevel *lvl = pyr->levels + k;
+
+	float *carry_row = lvl->carry + (int64_t) lvl->carry_rows * lvl->carry_length;
+	memcpy(carry_row, row, lvl->carry_length * sizeof(float));
+	if (++lvl->carry_rows < pyr->factor) return;
+	lvl->carry_rows = 0;
+
+	float *out = lvl->pending.start + (int64_t) lvl->pending.row_count * lvl->pending.row_length;
+	if (pyr->engine == ENGINE_FIXED) {
+		downsample_row_fixed(
+			(const int32_t *) lvl->carry, lvl->carry_length, (int32_t *) out,
+			lvl->pending.row_length, pyr->factor, pyr->filter
+		);
+	} else {
+		downsample_row(lvl->carry, lvl->carry_length, out, lvl->pending.row_length, pyr->factor, pyr->filter);
+	}
+	lvl->pending.row_count++;
+
+	pyramid_push_row(pyr, k + 1, out);
+
+	if (lvl->pending.row_count == lvl->pending_capacity) flush_level(pyr, k);
+}
+
+void pyramid_flush(Pyramid *pyr) {
+	for (int32_t k = 1; k < pyr->level_count; k++) {
+		flush_level(pyr, k);
+	}
+}
@@ -0,0 +1,194 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/resume_journal.h"
+#include "../include/utils.h"
+
+/*  The journal is a text file:
+ *
+ *      csv_parser resume journal 1
+ *      fingerprint 8c2f0e5b4a7d1936
+ *      commit <next_chunk> <rows> <source_offset>
+ *      commit ...
+ *
+ *  holding the last commit only: every commit writes a new journal next
+ *  to it and renames it over the previous one, so that a run stopped at
+ *  any point leaves one or the other whole. Only lines ending with an eol
+ *  count all the same.
+ */
+#define JOURNAL_HEADER "csv_parser resume journal 1\n"
+#define JOURNAL_LINE_SIZE 128
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t hash_int(uint64_t hash, int64_t val) {
+	return hash_bytes(hash, &val, sizeof(val));
+}
+
+uint64_t run_fingerprint(const Config *conf, uint64_t source_size, int64_t source_mtime) {
+	uint64_t hash = 14695981039346656037ull;
+	hash = hash_bytes(hash, conf->source, strlen(conf->source));
+	hash = hash_int(hash, (int64_t) source_size);
+	hash = hash_int(hash, source_mtime);
+	hash = hash_int(hash, conf->min_field_size);
+	hash = hash_int(hash, conf->max_field_size);
+	hash = hash_int(hash, conf->output_field_size);
+	hash = hash_int(hash, conf->output_format);
+	hash = hash_int(hash, conf->eol_flag);
+	hash = hash_int(hash, conf->tile_width);
+	hash = hash_int(hash, conf->tile_height);
+	// chunks are numbered by band
+	hash = hash_int(hash, conf->band_height);
+	hash = hash_int(hash, conf->downsample_factor);
+	hash = hash_int(hash, conf->downsample_filter);
+	hash = hash_int(hash, conf->engine);
+	hash = hash_int(hash, conf->pyramid_levels);
+	hash = hash_int(hash, conf->roi_row_first);
+	hash = hash_int(hash, conf->roi_row_end);
+	hash = hash_int(hash, conf->roi_col_first);
+	hash = hash_int(hash, conf->roi_col_end);
+	return hash;
+}
+
+static int journal_path(char *dst, const char *dest) {
+	int char_count = snprintf(dst, MAXIMUM_PATH(), "%s/%s", dest, JOURNAL_NAME);
+	return char_count < 0 || char_count >= MAXIMUM_PATH();
+}
+
+int journal_exists(const char *dest) {
+	char path[MAXIMUM_PATH()];
+	if (journal_path(path, dest)) return 0;
+
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) return 0;
+	fclose(fp);
+	return 1;
+}
+
+/*! Parses a whole commit line, eol included. */
+static int parse_commit(const char *line, JournalEntry *e) {
+	int next_chunk = 0;
+	long long rows = 0;
+	unsigned long long offset = 0;
+	int consumed = 0;
+
+	if (sscanf(line, "commit %d %lld %llu\n%n", &next_chunk, &rows, &offset, &consumed) != 3) return 1;
+	if (consumed == 0 || line[consumed] != '\0' || line[consumed - 1] != '\n') return 1;
+	if (next_chunk < 0 || rows < 0) return 1;
+
+	e->next_chunk = next_chunk;
+	e->rows = rows;
+	e->source_offset = offset;
+	return 0;
+}
+
+Journal_status read_journal(const char *dest, uint64_t fingerprint, JournalEntry *last) {
+	*last = (JournalEntry) {0};
+
+	char path[MAXIMUM_PATH()];
+	if (journal_path(path, dest)) return JOURNAL_UNREADABLE;
+
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) return errno == ENOENT ? JOURNAL_MISSING : JOURNAL_UNREADABLE;
+
+	char line[JOURNAL_LINE_SIZE];
+	unsigned long long written_with = 0;
+	if (
+		fgets(line, sizeof(line), fp) == NULL || strcmp(line, JOURNAL_HEADER)
+		|| fgets(line, sizeof(line), fp) == NULL || sscanf(line, "fingerprint %llx", &written_with) != 1
+	) {
+		fclose(fp);
+		return JOURNAL_UNREADABLE;
+	}
+	if ((uint64_t) written_with != fingerprint) {
+		fclose(fp);
+		return JOURNAL_MISMATCH;
+	}
+
+	// commits only go forward, anything else is the end of the journal
+	JournalEntry e;
+	while (fgets(line, sizeof(line), fp) != NULL && parse_commit(line, &e) == 0) {
+		if (e.next_chunk <= last->next_chunk || e.source_offset <= last->source_offset) break;
+		*last = e;
+	}
+	fclose(fp);
+	return JOURNAL_FOUND;
+}
+
+static int write_commit(FILE *fp, const JournalEntry *e) {
+	errno = 0;
+	int printed = fprintf(
+		fp, "commit %d %lld %llu\n",
+		e->next_chunk, (long long) e->rows, (unsigned long long) e->source_offset
+	);
+	if (printed < 0 || fflush(fp)) return errno ? errno : EIO;
+	return 0;
+}
+
+/*! Writes a journal holding `e`, or no commit if NULL, next to the one of
+ *  `rj`, flushes it to the disk and renames it over the previous one.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+static int replace_journal(const ResumeJournal *rj, const JournalEntry *e) {
+	char tmp_path[MAXIMUM_PATH()];
+	int char_count = snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", rj->path);
+	if (char_count < 0 || char_count >= (int) sizeof(tmp_path)) return ENAMETOOLONG;
+
+	errno = 0;
+	FILE *fp = fopen(tmp_path, "wb");
+	if (fp == NULL) return errno ? errno : EIO;
+
+	int err = 0;
+	if (fprintf(fp, JOURNAL_HEADER "fingerprint %016llx\n", (unsigned long long) rj->fingerprint) < 0) err = errno ? errno : EIO;
+	if (!err && e != NULL) err = write_commit(fp, e);
+	if (fclose(fp) && !err) err = errno ? errno : EIO;
+	if (!err) err = sync_file(tmp_path);
+
+	#ifdef _WIN32
+	// rename does not replace an existing file there
+	if (!err) remove(rj->path);
+	#endif
+	if (!err && rename(tmp_path, rj->path)) err = errno ? errno : EIO;
+	if (err) {
+		remove(tmp_path);
+		return err;
+	}
+	return sync_dir(rj->dest);
+}
+
+int open_ResumeJournal(ResumeJournal *rj, const char *dest, uint64_t fingerprint, const JournalEntry *from) {
+	rj->open = 0;
+	rj->rows = from->rows;
+	rj->fingerprint = fingerprint;
+	if (journal_path(rj->path, dest)) return ENAMETOOLONG;
+	snprintf(rj->dest, sizeof(rj->dest), "%s", dest);
+
+	int err = replace_journal(rj, from->next_chunk > 0 ? from : NULL);
+	if (err) return err;
+	rj->open = 1;
+	return 0;
+}
+
+int commit_journal(ResumeJournal *rj, const JournalEntry *e) {
+	if (!rj->open) return EBADF;
+	return replace_journal(rj, e);
+}
+
+void close_ResumeJournal(ResumeJournal *rj, char complete) {
+	if (!rj->open) return;
+	rj->open = 0;
+	if (complete && remove(rj->path)) {
+		printf("WARNING: could not remove %s (%s)" ENDL, rj->path, strerror(errno));
+	}
+}
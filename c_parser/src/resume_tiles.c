@@ -0,0 +1,129 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "../include/resume_tiles.h"
+#include "../include/output_files.h"
+#include "../include/value_encoder.h"
+#include "../include/utils.h"
+
+/*! Puts the directory of level `k` of the output in `dst`, `dest` itself
+ *  without a pyramid.
+ *
+ * @return 0 on success, 1 if the path is too long.
+ */
+static int level_dir(char *dst, const Config *conf, int32_t k) {
+	int char_count = conf->pyramid_levels > 1
+		? snprintf(dst, MAXIMUM_PATH(), "%s/level%d", conf->dest, k + 1)
+		: snprintf(dst, MAXIMUM_PATH(), "%s", conf->dest);
+	return char_count < 0 || char_count >= MAXIMUM_PATH();
+}
+
+int32_t check_tile_row(const char *dir, int tile_row, int32_t width, const Config *conf) {
+	// same tile layout as init_WriteBufferStruct
+	int64_t field_size = conf->output_format == OUTPUT_F16 ? sizeof(uint16_t) : sizeof(float);
+	int64_t sep_size = 0;
+	int64_t eol_size = 0;
+	if (conf->output_format == OUTPUT_CSV) {
+		field_size = conf->output_field_size;
+		sep_size = 1;
+		eol_size = conf->eol_flag == EOL_UNIX ? 1 : 2;
+	}
+	int64_t header_size = conf->output_format == OUTPUT_NPY ? NPY_HEADER_SIZE : 0;
+	int32_t tile_count = (width + conf->tile_width - 1) / conf->tile_width;
+	int32_t bad_tiles = 0;
+
+	for (int32_t col = 0; col < tile_count; col++) {
+		char path[MAXIMUM_PATH()];
+		if (tile_path(path, MAXIMUM_PATH(), dir, tile_row, col, conf->output_format)) {
+			printf("error: the path of tile %d of row %d of %s is too long" ENDL, col, tile_row, dir);
+			bad_tiles++;
+			continue;
+		}
+
+		int64_t cols = width - (int64_t) col * conf->tile_width;
+		if (cols > conf->tile_width) cols = conf->tile_width;
+		int64_t row_size = cols * (field_size + sep_size) - sep_size + eol_size;
+		int64_t size = header_size + conf->tile_height * row_size;
+
+		struct stat st;
+		if (stat(path, &st) || (int64_t) st.st_size != size) {
+			printf("error: %s is missing or not of the size of a whole tile" ENDL, path);
+			bad_tiles++;
+		}
+	}
+	return bad_tiles;
+}
+
+int32_t remove_tile_rows(const char *dir, int tile_row, int32_t width, const Config *conf) {
+	int32_t tile_count = (width + conf->tile_width - 1) / conf->tile_width;
+	int32_t total = 0;
+
+	for (int row = tile_row; ; row++) {
+		int32_t removed = 0;
+		for (int32_t col = 0; col < tile_count; col++) {
+			char path[MAXIMUM_PATH()];
+			if (tile_path(path, MAXIMUM_PATH(), dir, row, col, conf->output_format) == 0 && remove(path) == 0) {
+				removed++;
+			}
+		}
+		if (removed == 0) return total;
+		total += removed;
+	}
+}
+
+int32_t check_resumed_tiles(const Config *conf, const RowLayout *row_lo, const JournalEntry *from, int32_t *removed) {
+	int32_t level_count = conf->pyramid_levels > 1 ? conf->pyramid_levels : 1;
+	int32_t width = row_lo->window_fields;
+	int64_t rows = from->rows;
+	int32_t bad_tiles = 0;
+	*removed = 0;
+
+	for (int32_t k = 0; k < level_count; k++) {
+		char dir[MAXIMUM_PATH()];
+		if (level_dir(dir, conf, k)) {
+			printf("error: the path of level%d of %s is too long" ENDL, k + 1, conf->dest);
+			return bad_tiles + 1;
+		}
+
+		width /= conf->downsample_factor;
+		if (k > 0) rows /= conf->downsample_factor;
+		int tile_rows = (int) (rows / conf->tile_height);
+
+		if (tile_rows > 0) bad_tiles += check_tile_row(dir, tile_rows - 1, width, conf);
+		*removed += remove_tile_rows(dir, tile_rows, width, conf);
+	}
+	return bad_tiles;
+}
+
+int sync_committed_tiles(const Config *conf, const RowLayout *row_lo, int64_t from_rows, int64_t to_rows) {
+	int32_t level_count = conf->pyramid_levels > 1 ? conf->pyramid_levels : 1;
+	int32_t width = row_lo->window_fields;
+
+	for (int32_t k = 0; k < level_count; k++) {
+		char dir[MAXIMUM_PATH()];
+		if (level_dir(dir, conf, k)) return ENAMETOOLONG;
+
+		width /= conf->downsample_factor;
+		if (k > 0) {
+			from_rows /= conf->downsample_factor;
+			to_rows /= conf->downsample_factor;
+		}
+		int32_t tile_count = (width + conf->tile_width - 1) / conf->tile_width;
+		int first_row = (int) (from_rows / conf->tile_height);
+		int end_row = (int) (to_rows / conf->tile_height);
+
+		for (int row = first_row; row < end_row; row++) {
+			for (int32_t col = 0; col < tile_count; col++) {
+				char path[MAXIMUM_PATH()];
+				if (tile_path(path, MAXIMUM_PATH(), dir, row, col, conf->output_format)) return ENAMETOOLONG;
+				int err = sync_file(path);
+				if (err) return err;
+			}
+		}
+		int err = sync_dir(dir);
+		if (err) return err;
+	}
+	return 0;
+}
@@ -0,0 +1,320 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+#include "../include/custom_dtypes.h"
+#include "../include/row_index.h"
+#include "../include/scanner.h"
+
+/*  Layout of a sidecar, integers in little endian:
+ *
+ *   0  magic "ROWIDX", a nul and the version
+ *   8  size of the source
+ *  16  modification time of the source, seconds
+ *  24  modification time of the source, nanoseconds
+ *  32  row count
+ *  40  payload size
+ *  48  FNV-1a hash of the payload
+ *  56  payload: for every row, its offset minus the one of the previous
+ *      row (0 for the first), as a LEB128 varint
+ */
+#define ROW_INDEX_MAGIC "ROWIDX\0\1"
+#define ROW_INDEX_HEADER_SIZE 56
+#define MAX_VARINT_SIZE 10
+
+#if defined(__APPLE__) || defined(__LINUX__)
+static void put_u64(unsigned char *dst, uint64_t val) {
+	for (int i = 0; i < 8; i++) dst[i] = (unsigned char) (val >> (8 * i));
+}
+
+static uint64_t get_u64(const unsigned char *src) {
+	uint64_t val = 0;
+	for (int i = 0; i < 8; i++) val |= (uint64_t) src[i] << (8 * i);
+	return val;
+}
+
+static uint64_t fnv1a(const unsigned char *data, int64_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (int64_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/*! Appends `offset` to the row starts, growing them as needed. */
+static int push_row_start(RowIndex *ri, int64_t *capacity, uint64_t offset) {
+	if (ri->row_count + 1 >= *capacity) {
+		int64_t grown_capacity = *capacity ? 2 * *capacity : 4096;
+		uint64_t *grown = (uint64_t *) realloc(ri->row_starts, grown_capacity * sizeof(uint64_t));
+		if (grown == NULL) return 1;
+		ri->row_starts = grown;
+		*capacity = grown_capacity;
+	}
+	ri->row_starts[ri->row_count++] = offset;
+	return 0;
+}
+
+/*! Finds every row of `fd`, reading it block after block. */
+static int build_row_starts(RowIndex *ri, int fd) {
+	char *block = (char *) malloc(STREAM_BLOCK_SIZE);
+	if (block == NULL) return 1;
+
+	int64_t capacity = 0;
+	uint64_t offset = 0;
+	char at_row_start = 1;
+	while (offset < ri->source_size) {
+		uint64_t left = ri->source_size - offset;
+		size_t length = left < STREAM_BLOCK_SIZE ? (size_t) left : STREAM_BLOCK_SIZE;
+		ssize_t got = pread(fd, block, length, (off_t) offset);
+		if (got < 0 && errno == EINTR) continue;
+		if (got <= 0) {
+			free(block);
+			return 1;
+		}
+
+		const char *p = block;
+		const char *limit = block + got;
+		while (p < limit) {
+			if (at_row_start && push_row_start(ri, &capacity, offset + (uint64_t) (p - block))) {
+				free(block);
+				return 1;
+			}
+			const char *eol = scan_eol(p, limit);
+			at_row_start = eol != NULL;
+			if (eol == NULL) break;
+			p = eol + 1;
+		}
+		offset += (uint64_t) got;
+	}
+	free(block);
+
+	// the end of the last row, which may have no eol
+	if (push_row_start(ri, &capacity, ri->source_size)) return 1;
+	ri->row_count--;
+	return 0;
+}
+
+/*! Writes the sidecar at `path`, through a temporary file renamed over it.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+static int save_RowIndex(const RowIndex *ri, const char *path) {
+	unsigned char *file = (unsigned char *) malloc(ROW_INDEX_HEADER_SIZE + ri->row_count * MAX_VARINT_SIZE);
+	if (file == NULL) return ENOMEM;
+
+	unsigned char *payload = file + ROW_INDEX_HEADER_SIZE;
+	unsigned char *dst = payload;
+	uint64_t previous = 0;
+	for (int64_t row = 0; row < ri->row_count; row++) {
+		uint64_t delta = ri->row_starts[row] - previous;
+		previous = ri->row_starts[row];
+		while (delta >= 0x80) {
+			*dst++ = (unsigned char) (delta | 0x80);
+			delta >>= 7;
+		}
+		*dst++ = (unsigned char) delta;
+	}
+	int64_t payload_size = dst - payload;
+
+	memcpy(file, ROW_INDEX_MAGIC, 8);
+	put_u64(file + 8, ri->source_size);
+	put_u64(file + 16, (uint64_t) ri->mtime_sec);
+	put_u64(file + 24, (uint64_t) ri->mtime_nsec);
+	put_u64(file + 32, (uint64_t) ri->row_count);
+	put_u64(file + 40, (uint64_t) payload_size);
+	put_u64(file + 48, fnv1a(payload, payload_size));
+
+	char tmp_path[MAXIMUM_PATH()];
+	int char_count = snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	if (char_count < 0 || char_count >= (int) sizeof(tmp_path)) {
+		free(file);
+		return ENAMETOOLONG;
+	}
+
+	errno = 0;
+	int err = 0;
+	FILE *fp = fopen(tmp_path, "wb");
+	if (fp == NULL) err = errno ? errno : EIO;
+	else {
+		size_t size = (size_t) (ROW_INDEX_HEADER_SIZE + payload_size);
+		if (fwrite(file, 1, size, fp) != size) err = errno ? errno : EIO;
+		if (fclose(fp) && !err) err = errno ? errno : EIO;
+		if (!err && rename(tmp_path, path)) err = errno ? errno : EIO;
+		if (err) remove(tmp_path);
+	}
+	free(file);
+	return err;
+}
+
+/*! Reads the sidecar at `path` into `ri`, whose source fields are set.
+ *
+ * @return 0 if it belongs to that source and is intact, 1 otherwise.
+ */
+static int load_RowIndex(RowIndex *ri, const char *path) {
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) return 1;
+
+	unsigned char header[ROW_INDEX_HEADER_SIZE];
+	int valid = fread(header, 1, sizeof(header), fp) == sizeof(header)
+		&& memcmp(header, ROW_INDEX_MAGIC, 8) == 0
+		&& get_u64(header + 8) == ri->source_size
+		&& get_u64(header + 16) == (uint64_t) ri->mtime_sec
+		&& get_u64(header + 24) == (uint64_t) ri->mtime_nsec;
+
+	uint64_t row_count = get_u64(header + 32);
+	uint64_t payload_size = get_u64(header + 40);
+	// every row is a byte at least, and its varint too
+	valid = valid && row_count <= ri->source_size && payload_size >= row_count
+		&& payload_size <= row_count * MAX_VARINT_SIZE;
+
+	unsigned char *payload = NULL;
+	if (valid) {
+		payload = (unsigned char *) malloc(payload_size ? payload_size : 1);
+		ri->row_starts = (uint64_t *) malloc((row_count + 1) * sizeof(uint64_t));
+		valid = payload != NULL && ri->row_starts != NULL
+			&& fread(payload, 1, payload_size, fp) == payload_size
+			&& fgetc(fp) == EOF
+			&& fnv1a(payload, (int64_t) payload_size) == get_u64(header + 48);
+	}
+	fclose(fp);
+
+	const unsigned char *src = payload;
+	const unsigned char *end = payload + payload_size;
+	uint64_t offset = 0;
+	for (uint64_t row = 0; valid && row < row_count; row++) {
+		uint64_t delta = 0;
+		int shift = 0;
+		do {
+			if (src == end || shift > 63) {
+				valid = 0;
+				break;
+			}
+			delta |= (uint64_t) (*src & 0x7f) << shift;
+			shift += 7;
+		} while (*src++ & 0x80);
+
+		offset += delta;
+		// rows go forward, within the source
+		valid = valid && (row == 0 || delta > 0) && offset < ri->source_size;
+		if (valid) ri->row_starts[row] = offset;
+	}
+	valid = valid && src == end;
+	free(payload);
+
+	if (!valid) {
+		free(ri->row_starts);
+		ri->row_starts = NULL;
+		return 1;
+	}
+	ri->row_count = (int64_t) row_count;
+	ri->row_starts[row_count] = ri->source_size;
+	return 0;
+}
+#endif
+
+Row_index_status open_RowIndex(RowIndex *ri, const char *source_path, int fd) {
+	*ri = (RowIndex) {0};
+
+#if defined(__APPLE__) || defined(__LINUX__)
+	struct stat st;
+	if (fstat(fd, &st)) return ROW_INDEX_FAILED;
+	ri->source_size = (uint64_t) st.st_size;
+	#if defined(__APPLE__)
+	ri->mtime_sec = (int64_t) st.st_mtimespec.tv_sec;
+	ri->mtime_nsec = (int64_t) st.st_mtimespec.tv_nsec;
+	#else
+	ri->mtime_sec = (int64_t) st.st_mtim.tv_sec;
+	ri->mtime_nsec = (int64_t) st.st_mtim.tv_nsec;
+	#endif
+
+	char path[MAXIMUM_PATH()];
+	int char_count = snprintf(path, sizeof(path), "%s" ROW_INDEX_SUFFIX, source_path);
+	char named = char_count > 0 && char_count < (int) sizeof(path);
+
+	if (named && load_RowIndex(ri, path) == 0) return ROW_INDEX_LOADED;
+
+	if (build_row_starts(ri, fd)) {
+		free_RowIndex(ri);
+		return ROW_INDEX_FAILED;
+	}
+	if (!named || save_RowIndex(ri, path)) return ROW_INDEX_NOT_SAVED;
+	return ROW_INDEX_BUILT;
+#else
+	(void) source_path;
+	(void) fd;
+	return ROW_INDEX_FAILED;
+#endif
+}
+
+int64_t skip_rows(int fd, uint64_t source_size, uint64_t *offset, int64_t rows) {
+	if (rows <= 0 || *offset >= source_size) return 0;
+#ifdef _WIN32
+	// no pread, the reads follow each other from `offset`
+	if (_lseeki64(fd, (__int64) *offset, SEEK_SET) < 0) return -1;
+#endif
+	char *block = (char *) malloc(STREAM_BLOCK_SIZE);
+	if (block == NULL) return -1;
+
+	int64_t skipped = 0;
+	char in_row = 0;
+	while (skipped < rows && *offset < source_size) {
+		uint64_t left = source_size - *offset;
+		size_t length = left < STREAM_BLOCK_SIZE ? (size_t) left : STREAM_BLOCK_SIZE;
+#ifdef _WIN32
+		int got = _read(fd, block, (unsigned int) length);
+#else
+		ssize_t got = pread(fd, block, length, (off_t) *offset);
+		if (got < 0 && errno == EINTR) continue;
+#endif
+		if (got <= 0) {
+			free(block);
+			return -1;
+		}
+
+		const char *p = block;
+		const char *limit = block + got;
+		while (skipped < rows && p < limit) {
+			const char *eol = scan_eol(p, limit);
+			in_row = eol == NULL;
+			if (eol == NULL) {
+				p = limit;
+				break;
+			}
+			p = eol + 1;
+			skipped++;
+		}
+		*offset += (uint64_t) (p - block);
+	}
+	free(block);
+
+	// the last row may have no eol
+	if (skipped < rows && in_row) skipped++;
+	return skipped;
+}
+
+int64_t row_at_offset(const RowIndex *ri, uint64_t offset) {
+	int64_t lo = 0;
+	int64_t hi = ri->row_count;
+	while (lo < hi) {
+		int64_t mid = lo + (hi - lo) / 2;
+		if (ri->row_starts[mid] < offset) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+void free_RowIndex(RowIndex *ri) {
+	free(ri->row_starts);
+	ri->row_starts = NULL;
+	ri->row_count = 0;
+}
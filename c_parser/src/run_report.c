@@ -0,0 +1,174 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/run_report.h"
+#include "../include/utils.h"
+
+static const char *stage_names[PIPELINE_STAGES] = {"parse", "format", "write"};
+
+typedef struct {
+	double total;
+	double mean;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+} StageSummary;
+
+static int compare_seconds(const void *a, const void *b) {
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/*! Nearest rank percentile `p` of the `count` sorted values. */
+static double percentile(const double *sorted, int32_t count, int p) {
+	int32_t rank = (int32_t) (((int64_t) p * count + 99) / 100);
+	if (rank < 1) rank = 1;
+	return sorted[rank - 1];
+}
+
+static void summarize_stage(const RunReport *rr, int stage, StageSummary *sum) {
+	*sum = (StageSummary) {0};
+	if (rr->chunk_count == 0) return;
+
+	double *sorted = (double *) malloc(rr->chunk_count * sizeof(double));
+	if (sorted == NULL) return;
+	memcpy(sorted, rr->stage_seconds[stage], rr->chunk_count * sizeof(double));
+	qsort(sorted, rr->chunk_count, sizeof(double), compare_seconds);
+
+	for (int32_t i = 0; i < rr->chunk_count; i++) sum->total += sorted[i];
+	sum->mean = sum->total / rr->chunk_count;
+	sum->p50 = percentile(sorted, rr->chunk_count, 50);
+	sum->p90 = percentile(sorted, rr->chunk_count, 90);
+	sum->p99 = percentile(sorted, rr->chunk_count, 99);
+	sum->max = sorted[rr->chunk_count - 1];
+	free(sorted);
+}
+
+void init_RunReport(RunReport *rr) {
+	*rr = (RunReport) {0};
+	rr->start = monotonic_seconds();
+}
+
+int report_chunk(RunReport *rr, const Chunk *ch) {
+	if (rr->chunk_count == rr->chunk_capacity) {
+		int32_t capacity = rr->chunk_capacity ? 2 * rr->chunk_capacity : 64;
+		for (int s = 0; s < PIPELINE_STAGES; s++) {
+			double *grown = (double *) realloc(rr->stage_seconds[s], capacity * sizeof(double));
+			if (grown == NULL) return 1;
+			rr->stage_seconds[s] = grown;
+		}
+		rr->chunk_capacity = capacity;
+	}
+
+	for (int s = 0; s < PIPELINE_STAGES; s++) rr->stage_seconds[s][rr->chunk_count] = ch->stage_seconds[s];
+	rr->chunk_count++;
+
+	if (ch->cached.start != NULL) {
+		rr->cache_bytes_read += ch->cached.bytesize;
+		rr->values_cached += (int64_t) ch->read_rows * ch->cp.row_length;
+		return 0;
+	}
+	rr->bytes_read += ch->read_bytes;
+	rr->values_parsed += (int64_t) ch->read_rows * ch->cp.row_length;
+	rr->parse_errors.small_fields += ch->rstats.small_fields;
+	rr->parse_errors.big_fields += ch->rstats.big_fields;
+	rr->parse_errors.short_rows += ch->rstats.short_rows;
+	rr->parse_errors.long_rows += ch->rstats.long_rows;
+	return 0;
+}
+
+void report_output(RunReport *rr, const WriteBuffer *wr, const FullFileBuffer *ff) {
+	rr->values_written += (int64_t) ff->row_count * ff->row_length;
+	rr->bytes_written += wr->bytesize + ff->bytesize;
+}
+
+void print_RunReport(const RunReport *rr) {
+	double seconds = monotonic_seconds() - rr->start;
+	double per_second = seconds > 0 ? 1 / seconds : 0;
+
+	printf("run report" ENDL);
+	printf("    wall time       %12.3f s" ENDL, seconds);
+	printf("    chunks          %12d" ENDL, rr->chunk_count);
+	printf("    bytes read      %12.1f MB   %8.1f MB/s" ENDL, rr->bytes_read / 1e6, rr->bytes_read / 1e6 * per_second);
+	printf("    values parsed   %12lld      %8.3g values/s" ENDL, (long long) rr->values_parsed, rr->values_parsed * per_second);
+	if (rr->values_cached) {
+		printf(
+			"    values cached   %12lld      %8.1f MB from the value cache" ENDL,
+			(long long) rr->values_cached, rr->cache_bytes_read / 1e6
+		);
+	}
+	printf(
+		"    parse errors    %lld short rows, %lld long rows, %lld small fields, %lld big fields" ENDL,
+		(long long) rr->parse_errors.short_rows, (long long) rr->parse_errors.long_rows,
+		(long long) rr->parse_errors.small_fields, (long long) rr->parse_errors.big_fields
+	);
+	printf("    values written  %12lld" ENDL, (long long) rr->values_written);
+	printf("    bytes written   %12.1f MB   %8.1f MB/s" ENDL, rr->bytes_written / 1e6, rr->bytes_written / 1e6 * per_second);
+	printf("    peak RSS        %12.1f MB" ENDL, peak_rss_bytes() / 1e6);
+
+	printf("    stage      total s   mean ms    p50 ms    p90 ms    p99 ms    max ms" ENDL);
+	for (int s = 0; s < PIPELINE_STAGES; s++) {
+		StageSummary sum;
+		summarize_stage(rr, s, &sum);
+		printf(
+			"    %-8s %9.3f %9.2f %9.2f %9.2f %9.2f %9.2f" ENDL,
+			stage_names[s], sum.total, sum.mean * 1e3, sum.p50 * 1e3, sum.p90 * 1e3, sum.p99 * 1e3, sum.max * 1e3
+		);
+	}
+}
+
+int write_RunReport_json(const RunReport *rr, const char *path) {
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL) return errno ? errno : EIO;
+
+	double seconds = monotonic_seconds() - rr->start;
+	double per_second = seconds > 0 ? 1 / seconds : 0;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"wall_seconds\": %.6f,\n", seconds);
+	fprintf(fp, "  \"chunks\": %d,\n", rr->chunk_count);
+	fprintf(fp, "  \"bytes_read\": %lld,\n", (long long) rr->bytes_read);
+	fprintf(fp, "  \"values_parsed\": %lld,\n", (long long) rr->values_parsed);
+	fprintf(fp, "  \"values_per_second\": %.0f,\n", rr->values_parsed * per_second);
+	fprintf(fp, "  \"cache_bytes_read\": %lld,\n", (long long) rr->cache_bytes_read);
+	fprintf(fp, "  \"values_cached\": %lld,\n", (long long) rr->values_cached);
+	fprintf(
+		fp, "  \"parse_errors\": {\"short_rows\": %lld, \"long_rows\": %lld, \"small_fields\": %lld, \"big_fields\": %lld},\n",
+		(long long) rr->parse_errors.short_rows, (long long) rr->parse_errors.long_rows,
+		(long long) rr->parse_errors.small_fields, (long long) rr->parse_errors.big_fields
+	);
+	fprintf(fp, "  \"values_written\": %lld,\n", (long long) rr->values_written);
+	fprintf(fp, "  \"bytes_written\": %lld,\n", (long long) rr->bytes_written);
+	fprintf(fp, "  \"peak_rss_bytes\": %lld,\n", (long long) peak_rss_bytes());
+	fprintf(fp, "  \"stages\": {\n");
+	for (int s = 0; s < PIPELINE_STAGES; s++) {
+		StageSummary sum;
+		summarize_stage(rr, s, &sum);
+		fprintf(
+			fp, "    \"%s\": {\"total_seconds\": %.6f, \"mean_seconds\": %.6f, \"p50_seconds\": %.6f, "
+			"\"p90_seconds\": %.6f, \"p99_seconds\": %.6f, \"max_seconds\": %.6f}%s\n",
+			stage_names[s], sum.total, sum.mean, sum.p50, sum.p90, sum.p99, sum.max,
+			s + 1 < PIPELINE_STAGES ? "," : ""
+		);
+	}
+	fprintf(fp, "  }\n");
+	fprintf(fp, "}\n");
+
+	int err = ferror(fp) ? EIO : 0;
+	if (fclose(fp) && !err) err = errno ? errno : EIO;
+	return err;
+}
+
+void free_RunReport(RunReport *rr) {
+	for (int s = 0; s < PIPELINE_STAGES; s++) {
+		free(rr->stage_seconds[s]);
+		rr->stage_seconds[s] = NULL;
+	}
+	rr->chunk_count = 0;
+	rr->chunk_capacity = 0;
+}
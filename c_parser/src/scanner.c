@@ -0,0 +1,190 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../include/scanner.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCAN_WIDTH 16
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static inline int ctz32(uint32_t x) {
+	unsigned long idx;
+	_BitScanForward(&idx, x);
+	return (int) idx;
+}
+#else
+#define ctz32(x) __builtin_ctz(x)
+#endif
+
+#ifdef SCAN_WIDTH
+/*! Bit i of the returned mask is set if p[i] is a ',' or a '\n'.
+ *  Bit i of `nl` is set if p[i] is a '\n'.
+ */
+static inline uint32_t structural_mask(const char *p, uint32_t *nl) {
+#if defined(__AVX2__)
+	__m256i v = _mm256_loadu_si256((const __m256i *) p);
+	uint32_t sep = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+	*nl = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+#else
+	__m128i v = _mm_loadu_si128((const __m128i *) p);
+	uint32_t sep = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+	*nl = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+#endif
+	return sep | *nl;
+}
+
+/*! Bit i of the returned mask is set if p[i] is a '\n'. */
+static inline uint32_t eol_mask(const char *p) {
+#if defined(__AVX2__)
+	__m256i v = _mm256_loadu_si256((const __m256i *) p);
+	return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+#else
+	__m128i v = _mm_loadu_si128((const __m128i *) p);
+	return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+#endif
+}
+#endif
+
+const char *scan_eol(const char *p, const char *limit) {
+#ifdef SCAN_WIDTH
+	for (; limit - p >= SCAN_WIDTH; p += SCAN_WIDTH) {
+		uint32_t nl = eol_mask(p);
+		if (nl) return p + ctz32(nl);
+	}
+#endif
+	for (; p < limit; p++) {
+		if (*p == '\n') return p;
+	}
+	return NULL;
+}
+
+int64_t scan_row(
+	const char *row,
+	const char *limit,
+	uint32_t *ends,
+	int64_t capacity,
+	const char **eol
+) {
+	const char *p = row;
+	int64_t hits = 0;
+	*eol = NULL;
+
+#ifdef SCAN_WIDTH
+	for (; limit - p >= SCAN_WIDTH; p += SCAN_WIDTH) {
+		uint32_t nl;
+		uint32_t mask = structural_mask(p, &nl);
+
+		// only keep the hits up to the 1st eol, the rest is the next row
+		if (nl) mask &= nl ^ (nl - 1);
+
+		while (mask) {
+			if (hits < capacity) ends[hits] = (uint32_t) (p - row) + ctz32(mask);
+			hits++;
+			mask &= mask - 1;
+		}
+
+		if (nl) {
+			*eol = p + ctz32(nl);
+			return hits;
+		}
+	}
+#endif
+
+	// tail of the buffer, or whole row without SIMD
+	for (; p < limit; p++) {
+		if (*p != ',' && *p != '\n') continue;
+
+		if (hits < capacity) ends[hits] = (uint32_t) (p - row);
+		hits++;
+
+		if (*p == '\n') {
+			*eol = p;
+			return hits;
+		}
+	}
+	return hits;
+}
+
+const char *find_row_starts(
+	ChunkIndex *idx,
+	const char *start,
+	const char *limit,
+	int32_t max_rows,
+	char at_eof
+) {
+	const char *row = start;
+	idx->row_count = 0;
+
+	while (idx->row_count < max_rows && row < limit) {
+		const char *eol = scan_eol(row, limit);
+
+		// the row is cut by the end of the mapped region
+		if (eol == NULL && !at_eof) break;
+
+		// without eol, the last row of the file ends at the end of file
+		idx->row_starts[idx->row_count++] = row - start;
+		row = (eol == NULL) ? limit : eol + 1;
+	}
+	idx->row_starts[idx->row_count] = row - start;
+	return row;
+}
+
+const char *find_indexed_row_starts(
+	ChunkIndex *idx,
+	const RowIndex *ri,
+	uint64_t offset,
+	const char *start,
+	const char *limit,
+	int32_t max_rows
+) {
+	uint64_t limit_offset = offset + (uint64_t) (limit - start);
+	uint64_t end = offset;
+	idx->row_count = 0;
+
+	for (int64_t row = row_at_offset(ri, offset); idx->row_count < max_rows && row < ri->row_count; row++) {
+		// the row is cut by the end of the mapped region
+		uint64_t next = ri->row_starts[row + 1];
+		if (next > limit_offset) break;
+
+		idx->row_starts[idx->row_count++] = (int64_t) (ri->row_starts[row] - offset);
+		end = next;
+	}
+	idx->row_starts[idx->row_count] = (int64_t) (end - offset);
+	return start + (end - offset);
+}
+
+void index_rows(ChunkIndex *idx, const char *start, int32_t first, int32_t last) {
+	for (int32_t r = first; r < last; r++) {
+		const char *row = start + idx->row_starts[r];
+		const char *row_end = start + idx->row_starts[r + 1];
+		uint32_t *ends = idx->field_ends + (int64_t) r * idx->row_length;
+		const char *eol = NULL;
+
+		int64_t hits = scan_row(row, row_end, ends, idx->row_length, &eol);
+
+		if (eol == NULL) {
+			// last row of the file, without eol: it ends at the end of file
+			if (hits < idx->row_length) ends[hits] = (uint32_t) (row_end - row);
+			hits++;
+		}
+		idx->row_fields[r] = (int32_t) hits;
+	}
+}
+
+const char *index_chunk(
+	ChunkIndex *idx,
+	const char *start,
+	const char *limit,
+	int32_t max_rows,
+	char at_eof
+) {
+	const char *next = find_row_starts(idx, start, limit, max_rows, at_eof);
+	index_rows(idx, start, 0, idx->row_count);
+	return next;
+}
@@ -0,0 +1,179 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/stream_reader.h"
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <unistd.h>
+
+/*! Reads `length` bytes at `offset`, whatever the number of pread it takes.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+static int read_block(int fd, char *dst, int64_t length, uint64_t offset) {
+	while (length > 0) {
+		ssize_t got = pread(fd, dst, (size_t) length, (off_t) offset);
+		if (got < 0 && errno == EINTR) continue;
+		if (got < 0) return errno;
+		if (got == 0) return EIO; // the file shrank
+
+		dst += got;
+		length -= got;
+		offset += (uint64_t) got;
+	}
+	return 0;
+}
+
+static void *stream_worker(void *arg) {
+	StreamReader *sr = (StreamReader *) arg;
+
+	pthread_mutex_lock(&sr->lock);
+	while (!sr->stopping && !sr->read_error && sr->next_read < sr->block_count) {
+		int slot = (int) (sr->next_read % 2);
+		while (!sr->stopping && sr->block_ready[slot]) {
+			pthread_cond_wait(&sr->changed, &sr->lock);
+		}
+		if (sr->stopping) break;
+
+		uint64_t offset = (uint64_t) sr->next_read * STREAM_BLOCK_SIZE;
+		int64_t length = sr->file_size - offset < STREAM_BLOCK_SIZE ? (int64_t) (sr->file_size - offset) : STREAM_BLOCK_SIZE;
+		pthread_mutex_unlock(&sr->lock);
+
+		int err = read_block(sr->fd, sr->blocks[slot], length, offset);
+
+		pthread_mutex_lock(&sr->lock);
+		sr->block_lengths[slot] = length;
+		sr->block_ready[slot] = 1;
+		sr->read_error = err;
+		sr->next_read++;
+		pthread_cond_broadcast(&sr->changed);
+	}
+	pthread_mutex_unlock(&sr->lock);
+	return NULL;
+}
+
+/*! Appends the next block to the window, once the thread has read it.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+static int take_block(StreamReader *sr) {
+	int slot = (int) (sr->next_take % 2);
+
+	pthread_mutex_lock(&sr->lock);
+	while (!sr->block_ready[slot]) pthread_cond_wait(&sr->changed, &sr->lock);
+	int err = sr->next_read == sr->next_take + 1 ? sr->read_error : 0;
+	pthread_mutex_unlock(&sr->lock);
+	if (err) return err;
+
+	memcpy(sr->window + sr->tail, sr->blocks[slot], sr->block_lengths[slot]);
+	sr->tail += sr->block_lengths[slot];
+
+	pthread_mutex_lock(&sr->lock);
+	sr->block_ready[slot] = 0;
+	sr->next_take++;
+	pthread_cond_broadcast(&sr->changed);
+	pthread_mutex_unlock(&sr->lock);
+	return 0;
+}
+#endif
+
+int init_StreamReader(StreamReader *sr, int fd, uint64_t file_size, int64_t window_size, uint64_t offset) {
+	*sr = (StreamReader) {0};
+#if defined(__APPLE__) || defined(__LINUX__)
+	sr->fd = fd;
+	sr->file_size = file_size;
+	sr->window_size = window_size;
+	sr->block_count = (int64_t) ((file_size + STREAM_BLOCK_SIZE - 1) / STREAM_BLOCK_SIZE);
+	sr->next_read = (int64_t) (offset / STREAM_BLOCK_SIZE);
+	sr->next_take = sr->next_read;
+	sr->window_offset = (uint64_t) sr->next_read * STREAM_BLOCK_SIZE;
+
+	// what is left of the last window, then a whole block
+	sr->window_capacity = window_size + STREAM_BLOCK_SIZE;
+	sr->window = (char *) malloc(sr->window_capacity);
+
+	// page aligned destinations, for the larger reads some systems do
+	size_t alignment = (size_t) sysconf(_SC_PAGESIZE);
+	for (int i = 0; i < 2; i++) {
+		void *block = NULL;
+		if (posix_memalign(&block, alignment, STREAM_BLOCK_SIZE) == 0) sr->blocks[i] = (char *) block;
+	}
+
+	if (sr->window == NULL || sr->blocks[0] == NULL || sr->blocks[1] == NULL) {
+		free_StreamReader(sr);
+		return 1;
+	}
+
+	if (pthread_mutex_init(&sr->lock, NULL) || pthread_cond_init(&sr->changed, NULL)) {
+		free_StreamReader(sr);
+		return 1;
+	}
+	// set before the thread starts reading the struct
+	sr->running = 1;
+	if (pthread_create(&sr->thread, NULL, stream_worker, sr)) {
+		sr->running = 0;
+		pthread_cond_destroy(&sr->changed);
+		pthread_mutex_destroy(&sr->lock);
+		free_StreamReader(sr);
+		return 1;
+	}
+	return 0;
+#else
+	(void) fd;
+	(void) file_size;
+	(void) window_size;
+	(void) offset;
+	return 1;
+#endif
+}
+
+const char *stream_window(StreamReader *sr, uint64_t offset) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	int64_t head = (int64_t) (offset - sr->window_offset);
+	uint64_t left = sr->file_size - offset;
+	int64_t needed = left < (uint64_t) sr->window_size ? (int64_t) left : sr->window_size;
+
+	while (sr->tail - head < needed) {
+		// move the bytes still needed to the front, to make room for a block
+		if (sr->tail + STREAM_BLOCK_SIZE > sr->window_capacity) {
+			memmove(sr->window, sr->window + head, sr->tail - head);
+			sr->tail -= head;
+			sr->window_offset += head;
+			head = 0;
+		}
+
+		int err = take_block(sr);
+		if (err) {
+			errno = err;
+			return NULL;
+		}
+	}
+	return sr->window + head;
+#else
+	(void) sr;
+	(void) offset;
+	errno = ENOSYS;
+	return NULL;
+#endif
+}
+
+void free_StreamReader(StreamReader *sr) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	if (sr->running) {
+		pthread_mutex_lock(&sr->lock);
+		sr->stopping = 1;
+		pthread_cond_broadcast(&sr->changed);
+		pthread_mutex_unlock(&sr->lock);
+
+		pthread_join(sr->thread, NULL);
+		pthread_cond_destroy(&sr->changed);
+		pthread_mutex_destroy(&sr->lock);
+	}
+#endif
+	free(sr->window);
+	free(sr->blocks[0]);
+	free(sr->blocks[1]);
+	*sr = (StreamReader) {0};
+}
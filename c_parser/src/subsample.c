@@ -0,0 +1,314 @@
+#include <stdint.h>
+
+#include "../include/subsample.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#include <immintrin.h>
+#define SUBSAMPLE_SSE2 1
+#if defined(__GNUC__) && !defined(__AVX2__)
+// AVX2 is compiled in anyway and only used if the CPU supports it
+#define SUBSAMPLE_AVX2_DISPATCH 1
+#define AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#define AVX2_TARGET
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SUBSAMPLE_NEON 1
+#endif
+
+/*  Every version computes ((t[0] + t[1]) + b[0]) + b[1], then * 0.25:
+ *  the pair of the top row is added first, and multiplying by a power of
+ *  two is exact, so the results are the same as the plain C ones.
+ */
+
+void subsample_row_scalar(const float *top, const float *bottom, float *out, int32_t out_length) {
+	for (int32_t col = 0; col < out_length; col++) {
+		const float *t = top + 2 * col;
+		const float *b = bottom + 2 * col;
+
+		//avg
+		out[col] = (t[0] + t[1] + b[0] + b[1]) * 0.25f;
+	}
+}
+
+#ifdef SUBSAMPLE_SSE2
+static void subsample_row_sse2(const float *top, const float *bottom, float *out, int32_t out_length) {
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	int32_t col = 0;
+
+	// 4 averages from 8 values of each row
+	for (; col + 4 <= out_length; col += 4) {
+		__m128 t_lo = _mm_loadu_ps(top + 2 * col);
+		__m128 t_hi = _mm_loadu_ps(top + 2 * col + 4);
+		__m128 b_lo = _mm_loadu_ps(bottom + 2 * col);
+		__m128 b_hi = _mm_loadu_ps(bottom + 2 * col + 4);
+
+		// horizontal pair add of the top row: t[0] + t[1], t[2] + t[3]...
+		__m128 t_pairs = _mm_add_ps(
+			_mm_shuffle_ps(t_lo, t_hi, _MM_SHUFFLE(2, 0, 2, 0)),
+			_mm_shuffle_ps(t_lo, t_hi, _MM_SHUFFLE(3, 1, 3, 1))
+		);
+		__m128 b_even = _mm_shuffle_ps(b_lo, b_hi, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 b_odd = _mm_shuffle_ps(b_lo, b_hi, _MM_SHUFFLE(3, 1, 3, 1));
+
+		__m128 sum = _mm_add_ps(_mm_add_ps(t_pairs, b_even), b_odd);
+		_mm_storeu_ps(out + col, _mm_mul_ps(sum, quarter));
+	}
+	subsample_row_scalar(top + 2 * col, bottom + 2 * col, out + col, out_length - col);
+}
+#endif
+
+#ifdef AVX2_TARGET
+AVX2_TARGET
+static void subsample_row_avx2(const float *top, const float *bottom, float *out, int32_t out_length) {
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	int32_t col = 0;
+
+	// 8 averages from 16 values of each row
+	for (; col + 8 <= out_length; col += 8) {
+		__m256 t_lo = _mm256_loadu_ps(top + 2 * col);
+		__m256 t_hi = _mm256_loadu_ps(top + 2 * col + 8);
+		__m256 b_lo = _mm256_loadu_ps(bottom + 2 * col);
+		__m256 b_hi = _mm256_loadu_ps(bottom + 2 * col + 8);
+
+		// hadd and shuffle work within 128 bit lanes, so the 3 vectors
+		// below share the same order: 0 1 4 5 | 2 3 6 7
+		__m256 t_pairs = _mm256_hadd_ps(t_lo, t_hi);
+		__m256 b_even = _mm256_shuffle_ps(b_lo, b_hi, _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 b_odd = _mm256_shuffle_ps(b_lo, b_hi, _MM_SHUFFLE(3, 1, 3, 1));
+
+		__m256 sum = _mm256_add_ps(_mm256_add_ps(t_pairs, b_even), b_odd);
+		// back to 0 1 2 3 | 4 5 6 7
+		sum = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm256_storeu_ps(out + col, _mm256_mul_ps(sum, quarter));
+	}
+	subsample_row_scalar(top + 2 * col, bottom + 2 * col, out + col, out_length - col);
+}
+#endif
+
+#ifdef SUBSAMPLE_NEON
+static void subsample_row_neon(const float *top, const float *bottom, float *out, int32_t out_length) {
+	const float32x4_t quarter = vdupq_n_f32(0.25f);
+	int32_t col = 0;
+
+	// 4 averages from 8 values of each row, deinterleaved while loading
+	for (; col + 4 <= out_length; col += 4) {
+		float32x4x2_t t = vld2q_f32(top + 2 * col);
+		float32x4x2_t b = vld2q_f32(bottom + 2 * col);
+
+		float32x4_t t_pairs = vaddq_f32(t.val[0], t.val[1]);
+		float32x4_t sum = vaddq_f32(vaddq_f32(t_pairs, b.val[0]), b.val[1]);
+		vst1q_f32(out + col, vmulq_f32(sum, quarter));
+	}
+	subsample_row_scalar(top + 2 * col, bottom + 2 * col, out + col, out_length - col);
+}
+#endif
+
+void subsample_row(const float *top, const float *bottom, float *out, int32_t out_length) {
+#if defined(__AVX2__)
+	subsample_row_avx2(top, bottom, out, out_length);
+#elif defined(SUBSAMPLE_AVX2_DISPATCH)
+	if (__builtin_cpu_supports("avx2")) subsample_row_avx2(top, bottom, out, out_length);
+	else subsample_row_sse2(top, bottom, out, out_length);
+#elif defined(SUBSAMPLE_SSE2)
+	subsample_row_sse2(top, bottom, out, out_length);
+#elif defined(SUBSAMPLE_NEON)
+	subsample_row_neon(top, bottom, out, out_length);
+#else
+	subsample_row_scalar(top, bottom, out, out_length);
+#endif
+}
+
+const char *subsample_row_isa(void) {
+#if defined(__AVX2__)
+	return "AVX2";
+#elif defined(SUBSAMPLE_AVX2_DISPATCH)
+	return __builtin_cpu_supports("avx2") ? "AVX2" : "SSE2";
+#elif defined(SUBSAMPLE_SSE2)
+	return "SSE2";
+#elif defined(SUBSAMPLE_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
+
+void subsample(CompBuffer* cpb, ProcValBuffer* pvb) {
+	for (int32_t row = 0; row < pvb->row_count; row++) {
+		const float *top = cpb->start + (int64_t) 2 * row * cpb->row_length;
+		subsample_row(
+			top, top + cpb->row_length,
+			pvb->start + (int64_t) row * pvb->row_length,
+			pvb->row_length
+		);
+	}
+}
+
+static void box_row(const float *rows, int64_t stride, float *out, int32_t out_length, int factor) {
+	const float area = (float) (factor * factor);
+	for (int32_t col = 0; col < out_length; col++) {
+		const float *block = rows + (int64_t) col * factor;
+		float sum = 0.0f;
+
+		// same order as subsample_row: row after row, left to right
+		for (int r = 0; r < factor; r++) {
+			for (int c = 0; c < factor; c++) sum += block[r * stride + c];
+		}
+		out[col] = sum / area;
+	}
+}
+
+static void extremum_row(const float *rows, int64_t stride, float *out, int32_t out_length, int factor, char keep_max) {
+	for (int32_t col = 0; col < out_length; col++) {
+		const float *block = rows + (int64_t) col * factor;
+		float best = block[0];
+
+		for (int r = 0; r < factor; r++) {
+			for (int c = 0; c < factor; c++) {
+				float v = block[r * stride + c];
+				if (keep_max ? v > best : v < best) best = v;
+			}
+		}
+		out[col] = best;
+	}
+}
+
+static void bilinear_row(const float *rows, int64_t stride, float *out, int32_t out_length, int factor) {
+	// the center of output value i is at i * factor + (factor - 1) / 2 in
+	// source coordinates, which falls on a value when factor is odd and
+	// right between 4 values when it is even
+	int half = (factor - 1) / 2;
+	const float *center = rows + half * stride + half;
+
+	if (factor % 2) {
+		for (int32_t col = 0; col < out_length; col++) out[col] = center[(int64_t) col * factor];
+		return;
+	}
+	for (int32_t col = 0; col < out_length; col++) {
+		const float *t = center + (int64_t) col * factor;
+		const float *b = t + stride;
+		out[col] = (t[0] + t[1] + b[0] + b[1]) * 0.25f;
+	}
+}
+
+void downsample_row(
+	const float *rows,
+	int64_t stride,
+	float *out,
+	int32_t out_length,
+	int factor,
+	Filter_flag filter
+) {
+	switch (filter) {
+		case FILTER_MIN:
+			extremum_row(rows, stride, out, out_length, factor, 0);
+			break;
+		case FILTER_MAX:
+			extremum_row(rows, stride, out, out_length, factor, 1);
+			break;
+		case FILTER_BILINEAR:
+			if (factor == 2) subsample_row(rows, rows + stride, out, out_length);
+			else bilinear_row(rows, stride, out, out_length, factor);
+			break;
+		case FILTER_BOX:
+		default:
+			if (factor == 2) subsample_row(rows, rows + stride, out, out_length);
+			else box_row(rows, stride, out, out_length, factor);
+			break;
+	}
+}
+
+/*! `sum` / `area` rounded half away from zero. */
+static int32_t round_fixed(int64_t sum, int32_t area) {
+	int64_t half = area / 2;
+	return (int32_t) ((sum < 0 ? sum - half : sum + half) / area);
+}
+
+static void box_row_fixed(const int32_t *rows, int64_t stride, int32_t *out, int32_t out_length, int factor) {
+	const int32_t area = factor * factor;
+	for (int32_t col = 0; col < out_length; col++) {
+		const int32_t *block = rows + (int64_t) col * factor;
+		int64_t sum = 0;
+
+		for (int r = 0; r < factor; r++) {
+			for (int c = 0; c < factor; c++) sum += block[r * stride + c];
+		}
+		out[col] = round_fixed(sum, area);
+	}
+}
+
+static void box2_row_fixed(const int32_t *top, const int32_t *bottom, int32_t *out, int32_t out_length) {
+	for (int32_t col = 0; col < out_length; col++) {
+		const int32_t *t = top + 2 * col;
+		const int32_t *b = bottom + 2 * col;
+		out[col] = round_fixed((int64_t) t[0] + t[1] + b[0] + b[1], 4);
+	}
+}
+
+static void extremum_row_fixed(const int32_t *rows, int64_t stride, int32_t *out, int32_t out_length, int factor, char keep_max) {
+	for (int32_t col = 0; col < out_length; col++) {
+		const int32_t *block = rows + (int64_t) col * factor;
+		int32_t best = block[0];
+
+		for (int r = 0; r < factor; r++) {
+			for (int c = 0; c < factor; c++) {
+				int32_t v = block[r * stride + c];
+				if (keep_max ? v > best : v < best) best = v;
+			}
+		}
+		out[col] = best;
+	}
+}
+
+static void bilinear_row_fixed(const int32_t *rows, int64_t stride, int32_t *out, int32_t out_length, int factor) {
+	int half = (factor - 1) / 2;
+	const int32_t *center = rows + half * stride + half;
+
+	if (factor % 2) {
+		for (int32_t col = 0; col < out_length; col++) out[col] = center[(int64_t) col * factor];
+		return;
+	}
+	for (int32_t col = 0; col < out_length; col++) {
+		const int32_t *t = center + (int64_t) col * factor;
+		const int32_t *b = t + stride;
+		out[col] = round_fixed((int64_t) t[0] + t[1] + b[0] + b[1], 4);
+	}
+}
+
+void downsample_row_fixed(
+	const int32_t *rows,
+	int64_t stride,
+	int32_t *out,
+	int32_t out_length,
+	int factor,
+	Filter_flag filter
+) {
+	switch (filter) {
+		case FILTER_MIN:
+			extremum_row_fixed(rows, stride, out, out_length, factor, 0);
+			break;
+		case FILTER_MAX:
+			extremum_row_fixed(rows, stride, out, out_length, factor, 1);
+			break;
+		case FILTER_BILINEAR:
+			if (factor == 2) box2_row_fixed(rows, rows + stride, out, out_length);
+			else bilinear_row_fixed(rows, stride, out, out_length, factor);
+			break;
+		case FILTER_BOX:
+		default:
+			if (factor == 2) box2_row_fixed(rows, rows + stride, out, out_length);
+			else box_row_fixed(rows, stride, out, out_length, factor);
+			break;
+	}
+}
+
+const char *filter_name(Filter_flag filter) {
+	switch (filter) {
+		case FILTER_MIN: return "min";
+		case FILTER_MAX: return "max";
+		case FILTER_BILINEAR: return "bilinear";
+		case FILTER_BOX:
+		default: return "box";
+	}
+}
@@ -0,0 +1,357 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/tile_writer.h"
+
+#ifdef TILE_WRITER_URING
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// what a completion is about, in the low bits of its user_data
+#define OP_OPEN   0
+#define OP_HEADER 1
+#define OP_WRITE  2
+#define OP_CLOSE  3
+#define OP_BITS   2
+#define OP_MASK   ((1 << OP_BITS) - 1)
+#define MAX_OPS_PER_TILE 4
+
+#define MAX_RING_ENTRIES 4096
+// linux never writes more at once
+#define MAX_WRITE_SIZE 0x7ffff000
+
+static int uring_setup(unsigned entries, struct io_uring_params *p) {
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+	return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int map_rings(TileWriter *tw, const struct io_uring_params *p) {
+	tw->sq_map_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	tw->cq_map_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	char single_map = (p->features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_map && tw->cq_map_size > tw->sq_map_size) tw->sq_map_size = tw->cq_map_size;
+
+	void *map = mmap(NULL, tw->sq_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, tw->ring_fd, IORING_OFF_SQ_RING);
+	if (map == MAP_FAILED) return 1;
+	tw->sq_map = map;
+
+	if (single_map) {
+		tw->cq_map = tw->sq_map;
+	} else {
+		map = mmap(NULL, tw->cq_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, tw->ring_fd, IORING_OFF_CQ_RING);
+		if (map == MAP_FAILED) return 1;
+		tw->cq_map = map;
+	}
+
+	tw->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	map = mmap(NULL, tw->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, tw->ring_fd, IORING_OFF_SQES);
+	if (map == MAP_FAILED) return 1;
+	tw->sqes = map;
+
+	char *sq = (char *) tw->sq_map;
+	tw->sq_head = (unsigned *) (sq + p->sq_off.head);
+	tw->sq_tail = (unsigned *) (sq + p->sq_off.tail);
+	tw->sq_mask = *(unsigned *) (sq + p->sq_off.ring_mask);
+	tw->sq_entries = p->sq_entries;
+	tw->sq_array = (unsigned *) (sq + p->sq_off.array);
+
+	char *cq = (char *) tw->cq_map;
+	tw->cq_head = (unsigned *) (cq + p->cq_off.head);
+	tw->cq_tail = (unsigned *) (cq + p->cq_off.tail);
+	tw->cq_mask = *(unsigned *) (cq + p->cq_off.ring_mask);
+	tw->cq_entries = p->cq_entries;
+	tw->cqes = cq + p->cq_off.cqes;
+	return 0;
+}
+
+static int ops_supported(TileWriter *tw) {
+	const int ops[] = {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE};
+	size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+	struct io_uring_probe *probe = (struct io_uring_probe *) calloc(1, size);
+	if (probe == NULL) return 0;
+
+	int supported = uring_register(tw->ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+	for (size_t i = 0; supported && i < sizeof(ops) / sizeof(ops[0]); i++) {
+		supported = ops[i] < probe->ops_len && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+	}
+	free(probe);
+	return supported;
+}
+
+/*! Registers an empty table of file slots, one per tile if the limit on
+ *  open files allows it.
+ */
+static int register_slots(TileWriter *tw, int32_t max_tiles) {
+	uint32_t slots = (uint32_t) max_tiles;
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY && slots > rl.rlim_cur / 2) {
+		slots = (uint32_t) (rl.rlim_cur / 2);
+	}
+	if (slots == 0) slots = 1;
+
+	int *fds = (int *) malloc(slots * sizeof(int));
+	if (fds == NULL) return 1;
+	memset(fds, 0xff, slots * sizeof(int)); // -1: empty slot
+
+	while (uring_register(tw->ring_fd, IORING_REGISTER_FILES, fds, slots) < 0) {
+		if (errno != EMFILE || slots == 1) {
+			free(fds);
+			return 1;
+		}
+		slots /= 2;
+	}
+	free(fds);
+	tw->file_slots = slots;
+	return 0;
+}
+
+static struct io_uring_sqe *sqe_at(TileWriter *tw, unsigned tail, uint64_t user_data) {
+	unsigned idx = tail & tw->sq_mask;
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *) tw->sqes + idx;
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = user_data;
+	tw->sq_array[idx] = idx;
+	return sqe;
+}
+
+/*! Prepares the openat of `path` in file slot `slot`, the writes of
+ *  `header` (skipped if NULL) and `data`, and the close of the slot.
+ *  Writes go on after a failed one, so that the slot is always closed.
+ *
+ * @return the number of operations queued.
+ */
+static int32_t queue_file_ops(
+	TileWriter *tw,
+	uint64_t id,
+	const char *path,
+	int flags,
+	uint32_t slot,
+	const char *header,
+	int64_t header_size,
+	const char *data,
+	int64_t size
+) {
+	unsigned tail = *tw->sq_tail;
+	int32_t ops = 0;
+	struct io_uring_sqe *sqe;
+
+	sqe = sqe_at(tw, tail + ops++, id << OP_BITS | OP_OPEN);
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (uint64_t) (uintptr_t) path;
+	sqe->len = 0666;
+	sqe->open_flags = (uint32_t) flags;
+	sqe->file_index = slot + 1;
+	sqe->flags = IOSQE_IO_LINK;
+
+	if (header != NULL) {
+		sqe = sqe_at(tw, tail + ops++, id << OP_BITS | OP_HEADER);
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = (int32_t) slot;
+		sqe->addr = (uint64_t) (uintptr_t) header;
+		sqe->len = (uint32_t) header_size;
+		sqe->off = 0;
+		sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+	}
+
+	sqe = sqe_at(tw, tail + ops++, id << OP_BITS | OP_WRITE);
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = (int32_t) slot;
+	sqe->addr = (uint64_t) (uintptr_t) data;
+	// anything past it comes back as a short write
+	sqe->len = (uint32_t) (size < MAX_WRITE_SIZE ? size : MAX_WRITE_SIZE);
+	sqe->off = (uint64_t) (header != NULL ? header_size : 0);
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+
+	sqe = sqe_at(tw, tail + ops++, id << OP_BITS | OP_CLOSE);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->file_index = slot + 1;
+
+	__atomic_store_n(tw->sq_tail, tail + ops, __ATOMIC_RELEASE);
+	tw->unsubmitted += ops;
+	tw->in_flight += ops;
+	return ops;
+}
+
+/*! Submits what was queued, and waits for `min_complete` completions.
+ *
+ * @return 0 on success, an errno value otherwise.
+ */
+static int enter_ring(TileWriter *tw, unsigned min_complete) {
+	for (;;) {
+		unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+		int ret = uring_enter(tw->ring_fd, tw->unsubmitted, min_complete, flags);
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret < 0) return errno;
+		tw->unsubmitted -= (unsigned) ret;
+		return 0;
+	}
+}
+
+/*! Checks that openat can fill a file slot that linked operations then use
+ *  (linux 5.18 on), by writing a byte to /dev/null.
+ */
+static int direct_open_works(TileWriter *tw) {
+	static const char byte = 0;
+	int32_t ops = queue_file_ops(tw, 0, "/dev/null", O_WRONLY, 0, NULL, 0, &byte, 1);
+	if (enter_ring(tw, (unsigned) ops)) return 0;
+
+	int works = 1;
+	unsigned head = *tw->cq_head;
+	unsigned tail = __atomic_load_n(tw->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = (struct io_uring_cqe *) tw->cqes + (head & tw->cq_mask);
+		if (cqe->res < 0 || ((cqe->user_data & OP_MASK) == OP_WRITE && cqe->res != 1)) works = 0;
+		tw->in_flight--;
+	}
+	__atomic_store_n(tw->cq_head, head, __ATOMIC_RELEASE);
+	return works && tw->in_flight == 0;
+}
+
+static void reap_completions(TileWriter *tw) {
+	unsigned head = *tw->cq_head;
+	unsigned tail = __atomic_load_n(tw->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = (struct io_uring_cqe *) tw->cqes + (head & tw->cq_mask);
+		TileWrite *t = tw->tiles + (cqe->user_data >> OP_BITS);
+		int res = cqe->res;
+
+		// once the openat failed, the rest of the chain is cancelled
+		switch (cqe->user_data & OP_MASK) {
+			case OP_OPEN:
+				if (res < 0) t->open_error = -res;
+				break;
+			case OP_HEADER:
+				if (res >= 0) t->header_written = res;
+				break;
+			case OP_WRITE:
+				if (res >= 0) t->written = res;
+				else if (res != -ECANCELED) t->write_error = -res;
+				break;
+			case OP_CLOSE:
+				// deferred write errors may only show up here
+				if (res < 0 && res != -ECANCELED && t->write_error == 0) t->write_error = -res;
+				break;
+		}
+		t->pending_ops--;
+		tw->in_flight--;
+	}
+	__atomic_store_n(tw->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*! Queues the next tiles of the row while the rings have room for them and
+ *  their file slot is free, then submits them.
+ */
+static int push_tiles(TileWriter *tw) {
+	while (tw->next_tile < tw->tile_count) {
+		int32_t i = tw->next_tile;
+		unsigned sq_used = *tw->sq_tail - __atomic_load_n(tw->sq_head, __ATOMIC_ACQUIRE);
+
+		if (sq_used + MAX_OPS_PER_TILE > tw->sq_entries) break;
+		if (tw->in_flight + MAX_OPS_PER_TILE > tw->cq_entries) break;
+		// slots are reused in order
+		if ((uint32_t) i >= tw->file_slots && tw->tiles[i - tw->file_slots].pending_ops) break;
+
+		TileWrite *t = tw->tiles + i;
+		t->pending_ops = queue_file_ops(
+			tw, (uint64_t) i, t->path, O_WRONLY|O_CREAT|O_TRUNC, (uint32_t) i % tw->file_slots,
+			t->header_size ? t->header : NULL, t->header_size, t->data, t->size
+		);
+		tw->next_tile++;
+	}
+	return tw->unsubmitted ? enter_ring(tw, 0) : 0;
+}
+#endif
+
+int init_TileWriter(TileWriter *tw, int32_t max_tiles) {
+	*tw = (TileWriter) {0};
+	tw->ring_fd = -1;
+
+#ifdef TILE_WRITER_URING
+	if (max_tiles < 1) max_tiles = 1;
+	unsigned entries = max_tiles > MAX_RING_ENTRIES / MAX_OPS_PER_TILE
+		? MAX_RING_ENTRIES
+		: (unsigned) max_tiles * MAX_OPS_PER_TILE;
+
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	tw->ring_fd = uring_setup(entries, &p);
+	if (tw->ring_fd < 0) return 1;
+
+	if (map_rings(tw, &p) || !ops_supported(tw) || register_slots(tw, max_tiles) || !direct_open_works(tw)) {
+		free_TileWriter(tw);
+		return 1;
+	}
+	return 0;
+#else
+	(void) max_tiles;
+	return 1;
+#endif
+}
+
+int submit_tile_writes(TileWriter *tw, TileWrite *tiles, int32_t count) {
+#ifdef TILE_WRITER_URING
+	for (int32_t i = 0; i < count; i++) {
+		tiles[i].open_error = 0;
+		tiles[i].write_error = 0;
+		tiles[i].header_written = 0;
+		tiles[i].written = 0;
+		tiles[i].pending_ops = 0;
+	}
+	tw->tiles = tiles;
+	tw->tile_count = count;
+	tw->next_tile = 0;
+	return push_tiles(tw);
+#else
+	(void) tw;
+	(void) tiles;
+	(void) count;
+	return ENOSYS;
+#endif
+}
+
+int wait_tile_writes(TileWriter *tw) {
+#ifdef TILE_WRITER_URING
+	while (tw->tiles != NULL) {
+		reap_completions(tw);
+		int err = push_tiles(tw);
+		if (err) return err;
+
+		if (tw->next_tile == tw->tile_count && tw->in_flight == 0) break;
+
+		err = enter_ring(tw, 1);
+		if (err) return err;
+	}
+	tw->tiles = NULL;
+	tw->tile_count = 0;
+	tw->next_tile = 0;
+#else
+	(void) tw;
+#endif
+	return 0;
+}
+
+void free_TileWriter(TileWriter *tw) {
+#ifdef TILE_WRITER_URING
+	if (tw->sqes != NULL) munmap(tw->sqes, tw->sqes_size);
+	if (tw->cq_map != NULL && tw->cq_map != tw->sq_map) munmap(tw->cq_map, tw->cq_map_size);
+	if (tw->sq_map != NULL) munmap(tw->sq_map, tw->sq_map_size);
+	if (tw->ring_fd >= 0) close(tw->ring_fd);
+#endif
+	*tw = (TileWriter) {0};
+	tw->ring_fd = -1;
+}
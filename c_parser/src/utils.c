@@ -1,9 +1,18 @@
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/stat.h>
+#include <time.h>
 #if defined(_WIN32)
 #include <windows.h>
+#include <io.h>
+#define PSAPI_VERSION 2 // GetProcessMemoryInfo from kernel32
+#include <psapi.h>
 #include "../include/custom_dtypes.h"
+#else
+#include <sys/resource.h>
+#include <unistd.h>
 #endif
 #include "../include/utils.h"
 
@@ -46,6 +55,66 @@ uint64_t file_size_from_handle(HANDLE file_handle) {
 }
 #endif
 
+double monotonic_seconds(void) {
+#if defined(_WIN32)
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (double) count.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+#endif
+}
+
+int64_t peak_rss_bytes(void) {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return (int64_t) pmc.PeakWorkingSetSize;
+#else
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru)) return 0;
+	#if defined(__APPLE__)
+	return (int64_t) ru.ru_maxrss; // bytes on macOS
+	#else
+	return (int64_t) ru.ru_maxrss * 1024;
+	#endif
+#endif
+}
+
+int sync_file(const char *path) {
+#if defined(_WIN32)
+	int fd = _open(path, _O_RDWR | _O_BINARY);
+	if (fd < 0) return errno ? errno : EIO;
+	int err = _commit(fd) ? (errno ? errno : EIO) : 0;
+	_close(fd);
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return errno ? errno : EIO;
+	int err = fsync(fd) ? (errno ? errno : EIO) : 0;
+	close(fd);
+#endif
+	return err;
+}
+
+int sync_dir(const char *path) {
+#if defined(_WIN32)
+	// entries are made durable by NTFS itself, and directories can't be
+	// opened as files
+	(void) path;
+	return 0;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return errno ? errno : EIO;
+	int err = fsync(fd) ? (errno ? errno : EIO) : 0;
+	close(fd);
+	// some file systems can't sync a directory, and need not
+	return err == EINVAL ? 0 : err;
+#endif
+}
+
 void _die(const char e_msg[], int excode, char USAGE[MAX_USAGE]) {
 		printf("Error: %s\n", e_msg);
 		printf("%s", USAGE);
@@ -0,0 +1,256 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../include/custom_dtypes.h"
+#include "../include/value_cache.h"
+
+/*  Layout of a cache, in the byte order of the host, so that it can be
+ *  used in place once mapped:
+ *
+ *   0  magic "F32VAL", a nul and the version
+ *   8  size of the source
+ *  16  modification time of the source, seconds
+ *  24  modification time of the source, nanoseconds
+ *  32  row count
+ *  40  row length
+ *  48  offset of the row starts
+ *  56  VALUE_CACHE_ORDER, to tell the byte order apart
+ *  64  values: row count x row length float32
+ *      padding to a multiple of 8
+ *      row starts: the offset of every row in the source, then its size
+ */
+#define VALUE_CACHE_MAGIC "F32VAL\0\1"
+#define VALUE_CACHE_HEADER_SIZE 64
+#define VALUE_CACHE_ORDER 0x0102030405060708ull
+
+#if defined(__APPLE__) || defined(__LINUX__)
+typedef struct {
+	char magic[8];
+	uint64_t source_size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t row_count;
+	int64_t row_length;
+	uint64_t row_starts_offset;
+	uint64_t order;
+} CacheHeader;
+
+static uint64_t row_starts_offset(int64_t row_count, int32_t row_length) {
+	uint64_t values_end = VALUE_CACHE_HEADER_SIZE + (uint64_t) row_count * row_length * sizeof(float);
+	return (values_end + 7) & ~(uint64_t) 7;
+}
+
+/*! Checks a mapped cache against the source and the row length.
+ *
+ * @return 0 if it can be used, 1 otherwise.
+ */
+static int check_cache_map(const ValueCache *vc, const char *map, uint64_t map_size, int32_t row_length) {
+	if (map_size < VALUE_CACHE_HEADER_SIZE) return 1;
+	CacheHeader h;
+	memcpy(&h, map, sizeof(h));
+
+	if (
+		memcmp(h.magic, VALUE_CACHE_MAGIC, 8) || h.order != VALUE_CACHE_ORDER
+		|| h.source_size != vc->rows.source_size
+		|| h.mtime_sec != vc->rows.mtime_sec || h.mtime_nsec != vc->rows.mtime_nsec
+		|| h.row_length != row_length
+		// every row is a byte of the source at least
+		|| h.row_count <= 0 || (uint64_t) h.row_count > h.source_size
+	) return 1;
+	if ((uint64_t) h.row_count > (map_size - VALUE_CACHE_HEADER_SIZE) / sizeof(float) / (uint64_t) row_length) return 1;
+	if (h.row_starts_offset != row_starts_offset(h.row_count, row_length)) return 1;
+	if (map_size != h.row_starts_offset + ((uint64_t) h.row_count + 1) * sizeof(uint64_t)) return 1;
+
+	// rows go forward, from the start to the end of the source
+	const uint64_t *starts = (const uint64_t *) (map + h.row_starts_offset);
+	if (starts[0] != 0 || starts[h.row_count] != h.source_size) return 1;
+	for (int64_t row = 1; row <= h.row_count; row++) {
+		if (starts[row] <= starts[row - 1]) return 1;
+	}
+	return 0;
+}
+#endif
+
+Value_cache_status open_ValueCache(ValueCache *vc, const char *source_path, int fd, int32_t row_length) {
+	*vc = (ValueCache) {0};
+	vc->row_length = row_length;
+
+#if defined(__APPLE__) || defined(__LINUX__)
+	struct stat st;
+	if (fstat(fd, &st)) return VALUE_CACHE_FAILED;
+	vc->rows.source_size = (uint64_t) st.st_size;
+	#if defined(__APPLE__)
+	vc->rows.mtime_sec = (int64_t) st.st_mtimespec.tv_sec;
+	vc->rows.mtime_nsec = (int64_t) st.st_mtimespec.tv_nsec;
+	#else
+	vc->rows.mtime_sec = (int64_t) st.st_mtim.tv_sec;
+	vc->rows.mtime_nsec = (int64_t) st.st_mtim.tv_nsec;
+	#endif
+
+	size_t path_size = strlen(source_path) + sizeof(VALUE_CACHE_SUFFIX);
+	if (path_size + 4 > MAXIMUM_PATH()) return VALUE_CACHE_FAILED;
+	vc->path = (char *) malloc(path_size);
+	if (vc->path == NULL) return VALUE_CACHE_FAILED;
+	snprintf(vc->path, path_size, "%s" VALUE_CACHE_SUFFIX, source_path);
+
+	int cache_fd = open(vc->path, O_RDONLY);
+	if (cache_fd < 0) return VALUE_CACHE_MISSING;
+	struct stat cache_st;
+	void *map = MAP_FAILED;
+	if (fstat(cache_fd, &cache_st) == 0 && cache_st.st_size >= VALUE_CACHE_HEADER_SIZE) {
+		map = mmap(NULL, (size_t) cache_st.st_size, PROT_READ, MAP_PRIVATE|MAP_FILE, cache_fd, 0);
+	}
+	close(cache_fd);
+	if (map == MAP_FAILED) return VALUE_CACHE_MISSING;
+
+	uint64_t map_size = (uint64_t) cache_st.st_size;
+	if (check_cache_map(vc, (const char *) map, map_size, row_length)) {
+		munmap(map, (size_t) map_size);
+		return VALUE_CACHE_MISSING;
+	}
+	// chunks take the rows in order
+	madvise(map, (size_t) map_size, MADV_SEQUENTIAL);
+
+	CacheHeader h;
+	memcpy(&h, map, sizeof(h));
+	vc->map = map;
+	vc->map_size = map_size;
+	vc->values = (const float *) ((const char *) map + VALUE_CACHE_HEADER_SIZE);
+	vc->rows.row_starts = (uint64_t *) ((char *) map + h.row_starts_offset);
+	vc->rows.row_count = h.row_count;
+	return VALUE_CACHE_LOADED;
+#else
+	(void) source_path;
+	(void) fd;
+	return VALUE_CACHE_FAILED;
+#endif
+}
+
+int start_ValueCache(ValueCache *vc) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	if (vc->path == NULL || vc->map != NULL) return EINVAL;
+
+	char tmp_path[MAXIMUM_PATH()];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", vc->path);
+
+	errno = 0;
+	vc->fp = fopen(tmp_path, "wb");
+	if (vc->fp == NULL) return errno ? errno : EIO;
+
+	// written again once complete
+	char header[VALUE_CACHE_HEADER_SIZE] = {0};
+	if (fwrite(header, 1, sizeof(header), vc->fp) != sizeof(header)) {
+		int err = errno ? errno : EIO;
+		close_ValueCache(vc);
+		return err;
+	}
+	return 0;
+#else
+	(void) vc;
+	return ENOSYS;
+#endif
+}
+
+/*! Appends `offset` to the row starts, growing them as needed. */
+static int push_cached_row(ValueCache *vc, uint64_t offset) {
+	if (vc->rows.row_count + 1 >= vc->row_capacity) {
+		int64_t capacity = vc->row_capacity ? 2 * vc->row_capacity : 4096;
+		uint64_t *grown = (uint64_t *) realloc(vc->rows.row_starts, capacity * sizeof(uint64_t));
+		if (grown == NULL) return 1;
+		vc->rows.row_starts = grown;
+		vc->row_capacity = capacity;
+	}
+	vc->rows.row_starts[vc->rows.row_count++] = offset;
+	return 0;
+}
+
+int append_ValueCache(ValueCache *vc, const float *values, int32_t rows, const int64_t *row_starts, uint64_t base) {
+	if (vc->fp == NULL) return EBADF;
+
+	errno = 0;
+	size_t count = (size_t) rows * vc->row_length;
+	if (fwrite(values, sizeof(float), count, vc->fp) != count) return errno ? errno : EIO;
+	for (int32_t r = 0; r < rows; r++) {
+		if (push_cached_row(vc, base + (uint64_t) row_starts[r])) return ENOMEM;
+	}
+	return 0;
+}
+
+int finish_ValueCache(ValueCache *vc) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	if (vc->fp == NULL) return EBADF;
+
+	// the end of the last row
+	if (push_cached_row(vc, vc->rows.source_size)) return ENOMEM;
+	int64_t row_count = --vc->rows.row_count;
+
+	CacheHeader h = {
+		.source_size = vc->rows.source_size,
+		.mtime_sec = vc->rows.mtime_sec,
+		.mtime_nsec = vc->rows.mtime_nsec,
+		.row_count = row_count,
+		.row_length = vc->row_length,
+		.row_starts_offset = row_starts_offset(row_count, vc->row_length),
+		.order = VALUE_CACHE_ORDER
+	};
+	memcpy(h.magic, VALUE_CACHE_MAGIC, 8);
+
+	uint64_t values_end = VALUE_CACHE_HEADER_SIZE + (uint64_t) row_count * vc->row_length * sizeof(float);
+	char padding[8] = {0};
+	size_t padding_size = (size_t) (h.row_starts_offset - values_end);
+	size_t starts_count = (size_t) row_count + 1;
+
+	errno = 0;
+	int err = 0;
+	if (
+		fwrite(padding, 1, padding_size, vc->fp) != padding_size
+		|| fwrite(vc->rows.row_starts, sizeof(uint64_t), starts_count, vc->fp) != starts_count
+		|| fseeko(vc->fp, 0, SEEK_SET)
+		|| fwrite(&h, sizeof(h), 1, vc->fp) != 1
+	) err = errno ? errno : EIO;
+	if (fclose(vc->fp) && !err) err = errno ? errno : EIO;
+	vc->fp = NULL;
+
+	char tmp_path[MAXIMUM_PATH()];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", vc->path);
+	if (!err && rename(tmp_path, vc->path)) err = errno ? errno : EIO;
+	if (err) remove(tmp_path);
+	return err;
+#else
+	(void) vc;
+	return ENOSYS;
+#endif
+}
+
+void close_ValueCache(ValueCache *vc) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	if (vc->map != NULL) {
+		munmap(vc->map, (size_t) vc->map_size);
+		vc->map = NULL;
+		vc->rows.row_starts = NULL;
+	}
+	if (vc->fp != NULL) {
+		fclose(vc->fp);
+		vc->fp = NULL;
+		char tmp_path[MAXIMUM_PATH()];
+		snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", vc->path);
+		remove(tmp_path);
+	}
+#endif
+	free(vc->rows.row_starts);
+	vc->rows.row_starts = NULL;
+	vc->rows.row_count = 0;
+	vc->values = NULL;
+	free(vc->path);
+	vc->path = NULL;
+}
@@ -0,0 +1,102 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/value_encoder.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ENCODER_BIG_ENDIAN 1
+#endif
+
+uint16_t float_to_half(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(float));
+
+	uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	// inf, or nan with its quiet bit set and the top of its payload kept
+	if (magnitude >= 0x7F800000) {
+		if (magnitude == 0x7F800000) return sign | 0x7C00;
+		return sign | 0x7E00 | (uint16_t) ((magnitude >> 13) & 0x3FF);
+	}
+
+	// 65520 is halfway between 65504, the largest half, and 65536
+	if (magnitude >= 0x477FF000) return sign | 0x7C00;
+
+	uint32_t half;
+	uint32_t rest;
+	uint32_t halfway;
+
+	if (magnitude >= 0x38800000) {
+		// normal half: rebias the exponent, keep the top 10 mantissa bits
+		half = (magnitude >> 13) - ((127 - 15) << 10);
+		rest = magnitude & 0x1FFF;
+		halfway = 0x1000;
+	}
+	else {
+		// below 2^-14: counted in half subnormal units of 2^-24,
+		// 2^-25 and below round to zero
+		if (magnitude <= 0x33000000) return sign;
+
+		int32_t exponent = (int32_t) (magnitude >> 23);
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		int32_t shift = 126 - exponent; // from 14 to 24
+
+		half = mantissa >> shift;
+		rest = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+
+	// round half to even, a carry correctly moves to the next exponent
+	half += rest > halfway || (rest == halfway && (half & 1));
+	return sign | (uint16_t) half;
+}
+
+char *encode_f32(char *dst, const float *values, int32_t count) {
+#ifdef ENCODER_BIG_ENDIAN
+	for (int32_t i = 0; i < count; i++) {
+		uint32_t bits;
+		memcpy(&bits, values + i, sizeof(float));
+		dst[4 * i + 0] = (char) (bits);
+		dst[4 * i + 1] = (char) (bits >> 8);
+		dst[4 * i + 2] = (char) (bits >> 16);
+		dst[4 * i + 3] = (char) (bits >> 24);
+	}
+#else
+	memcpy(dst, values, (size_t) count * sizeof(float));
+#endif
+	return dst + (int64_t) count * sizeof(float);
+}
+
+char *encode_f16(char *dst, const float *values, int32_t count, int *overflow) {
+	for (int32_t i = 0; i < count; i++) {
+		uint16_t half = float_to_half(values[i]);
+		*overflow += (half & 0x7FFF) == 0x7C00 && isfinite(values[i]);
+
+		dst[2 * i + 0] = (char) (half);
+		dst[2 * i + 1] = (char) (half >> 8);
+	}
+	return dst + (int64_t) count * sizeof(uint16_t);
+}
+
+void write_npy_header(char *dst, int64_t rows, int64_t cols) {
+	// magic, version 1.0, then the length of the python dict that follows
+	const char magic[8] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+	const int dict_size = NPY_HEADER_SIZE - 10;
+
+	memcpy(dst, magic, sizeof(magic));
+	dst[8] = (char) (dict_size & 0xFF);
+	dst[9] = (char) (dict_size >> 8);
+
+	char *dict = dst + 10;
+	int written = snprintf(
+		dict, dict_size,
+		"{'descr': '<f4', 'fortran_order': False, 'shape': (%lld, %lld), }",
+		(long long) rows, (long long) cols
+	);
+	// spaces up to the final newline, which ends the header
+	memset(dict + written, ' ', dict_size - written - 1);
+	dict[dict_size - 1] = '\n';
+}
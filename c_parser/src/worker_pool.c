@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../include/worker_pool.h"
+
+#if defined(__APPLE__) || defined(__LINUX__)
+/*! Claims and runs tasks of the current batch until none is left.
+ *  Must be called with the lock held, returns with the lock held.
+ */
+static void run_batch_tasks(WorkerPool *wp) {
+	while (wp->next_task < wp->task_count) {
+		int32_t task = wp->next_task++;
+		pthread_mutex_unlock(&wp->lock);
+
+		wp->fn(wp->ctx, task);
+
+		pthread_mutex_lock(&wp->lock);
+		wp->done_tasks++;
+		if (wp->done_tasks == wp->task_count) pthread_cond_signal(&wp->batch_done);
+	}
+}
+
+static void *pool_worker(void *arg) {
+	WorkerPool *wp = (WorkerPool *) arg;
+	uint64_t seen_batch = 0;
+
+	pthread_mutex_lock(&wp->lock);
+	for (;;) {
+		while (!wp->stopping && wp->batch == seen_batch) {
+			pthread_cond_wait(&wp->batch_ready, &wp->lock);
+		}
+		if (wp->stopping) break;
+
+		seen_batch = wp->batch;
+		run_batch_tasks(wp);
+	}
+	pthread_mutex_unlock(&wp->lock);
+	return NULL;
+}
+#endif
+
+int init_WorkerPool(WorkerPool *wp, int32_t thread_count) {
+	*wp = (WorkerPool) {0};
+	wp->thread_count = thread_count > 1 ? thread_count : 1;
+
+#if defined(__APPLE__) || defined(__LINUX__)
+	if (wp->thread_count == 1) return 0;
+
+	wp->threads = (pthread_t *) malloc((wp->thread_count - 1) * sizeof(pthread_t));
+	if (wp->threads == NULL) return 1;
+
+	if (pthread_mutex_init(&wp->lock, NULL)) return 1;
+	if (pthread_cond_init(&wp->batch_ready, NULL)) return 1;
+	if (pthread_cond_init(&wp->batch_done, NULL)) return 1;
+
+	for (int32_t i = 0; i < wp->thread_count - 1; i++) {
+		if (pthread_create(wp->threads + i, NULL, pool_worker, wp)) {
+			// keep the threads that did start
+			wp->thread_count = i + 1;
+			break;
+		}
+	}
+	if (wp->thread_count == 1) {
+		free_WorkerPool(wp);
+		return 1;
+	}
+#else
+	wp->thread_count = 1;
+#endif
+	return 0;
+}
+
+void run_on_pool(WorkerPool *wp, PoolTask fn, void *ctx, int32_t task_count) {
+	if (wp->thread_count == 1) {
+		for (int32_t task = 0; task < task_count; task++) fn(ctx, task);
+		return;
+	}
+
+#if defined(__APPLE__) || defined(__LINUX__)
+	pthread_mutex_lock(&wp->lock);
+	wp->fn = fn;
+	wp->ctx = ctx;
+	wp->task_count = task_count;
+	wp->next_task = 0;
+	wp->done_tasks = 0;
+	wp->batch++;
+	pthread_cond_broadcast(&wp->batch_ready);
+
+	// the caller works too
+	run_batch_tasks(wp);
+
+	while (wp->done_tasks < wp->task_count) {
+		pthread_cond_wait(&wp->batch_done, &wp->lock);
+	}
+	pthread_mutex_unlock(&wp->lock);
+#endif
+}
+
+void free_WorkerPool(WorkerPool *wp) {
+#if defined(__APPLE__) || defined(__LINUX__)
+	if (wp->threads == NULL) return;
+
+	pthread_mutex_lock(&wp->lock);
+	wp->stopping = 1;
+	pthread_cond_broadcast(&wp->batch_ready);
+	pthread_mutex_unlock(&wp->lock);
+
+	for (int32_t i = 0; i < wp->thread_count - 1; i++) pthread_join(wp->threads[i], NULL);
+
+	pthread_cond_destroy(&wp->batch_done);
+	pthread_cond_destroy(&wp->batch_ready);
+	pthread_mutex_destroy(&wp->lock);
+	free(wp->threads);
+	wp->threads = NULL;
+#endif
+	wp->thread_count = 1;
+}
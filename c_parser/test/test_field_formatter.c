@@ -0,0 +1,154 @@
+#include "../include/field_formatter.h"
+#include "../include/ANSI_colors.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define FAIL( str ) RED_BG BLK_FG str DEF_BG DEF_FG
+#define PASS( str ) GRN_BG BLK_FG str DEF_BG DEF_FG
+
+#define RANDOM_BITS_COUNT 2000000
+#define FIELD_BUFF_SIZE FORMAT_FALLBACK_SIZE
+
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+
+static uint64_t xorshift64(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+static float float_from_bits(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(float));
+	return value;
+}
+
+/*! Compares format_field with snprintf, the way format_output_row uses it.
+ *
+ * @return 0 if both the `width` characters and the counts are identical.
+ */
+int compare_with_snprintf(float value, int width) {
+	char ref[FIELD_BUFF_SIZE];
+	char fast[FIELD_BUFF_SIZE];
+
+	int ref_count = snprintf(ref, width + 1, "%0*.3f", width, value);
+	int fast_count = format_field(fast, width, value);
+
+	if (ref_count != fast_count || memcmp(ref, fast, width)) {
+		fast[width] = '\0';
+		printf(
+			"\t\t%a (width %d): snprintf gave `%s` (%d), format_field gave `%s` (%d)\n",
+			(double) value, width, ref, ref_count, fast, fast_count
+		);
+		return 1;
+	}
+	return 0;
+}
+
+int test_exhaustive_binades(void) {
+	printf("\tTesting every float of magnitude in [0.5, 1) and [512, 1024)\n");
+	const uint32_t first_bits[] = {0x3F000000, 0x44000000}; // 0.5, 512
+	int fail_count = 0;
+
+	for (int b = 0; b < 2; b++) {
+		for (uint32_t m = 0; m < 0x800000 && fail_count < 10; m++) {
+			uint32_t bits = first_bits[b] + m;
+			fail_count += compare_with_snprintf(float_from_bits(bits), 8);
+			fail_count += compare_with_snprintf(float_from_bits(bits | 0x80000000), 8);
+		}
+	}
+
+	if (fail_count) printf("\t\tExhaustive binades: " FAIL("FAILED") "\n");
+	else printf("\t\tExhaustive binades: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_exhaustive_3_decimals(void) {
+	printf("\tTesting every value from -9999.999 to 9999.999\n");
+	int fail_count = 0;
+
+	// the largest ones overflow a field of 8 characters
+	for (int32_t v = -9999999; v <= 9999999 && fail_count < 10; v++) {
+		fail_count += compare_with_snprintf((float) v / 1000.0f, 8);
+	}
+
+	if (fail_count) printf("\t\tExhaustive range: " FAIL("FAILED") "\n");
+	else printf("\t\tExhaustive range: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_random_bits(void) {
+	printf("\tTesting %d random bit patterns (inf, nan, subnormals...)\n", RANDOM_BITS_COUNT);
+	int fail_count = 0;
+
+	for (int i = 0; i < RANDOM_BITS_COUNT && fail_count < 10; i++) {
+		uint64_t r = xorshift64();
+		int width = 1 + (int) ((r >> 32) % 20);
+		fail_count += compare_with_snprintf(float_from_bits((uint32_t) r), width);
+	}
+
+	const float specials[] = {0.0f, -0.0f, 0.0005f, -0.0005f, 0.0625f, 0.1875f, 1e-45f, 8388607.5f, 8388608.0f};
+	for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]); i++) {
+		for (int width = 1; width < 12; width++) {
+			fail_count += compare_with_snprintf(specials[i], width);
+		}
+	}
+
+	if (fail_count) printf("\t\tRandom bit patterns: " FAIL("FAILED") "\n");
+	else printf("\t\tRandom bit patterns: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+/*! Compares format_fixed_field with snprintf on the exact value. */
+int compare_fixed_with_snprintf(int32_t thousandths, int width) {
+	char ref[FIELD_BUFF_SIZE];
+	char fast[FIELD_BUFF_SIZE];
+
+	// a double holds the value close enough to round back to it
+	int ref_count = snprintf(ref, width + 1, "%0*.3f", width, thousandths / 1000.0);
+	int fast_count = format_fixed_field(fast, width, thousandths);
+
+	if (ref_count != fast_count || memcmp(ref, fast, width)) {
+		fast[width] = '\0';
+		printf(
+			"\t\t%d (width %d): snprintf gave `%s` (%d), format_fixed_field gave `%s` (%d)\n",
+			thousandths, width, ref, ref_count, fast, fast_count
+		);
+		return 1;
+	}
+	return 0;
+}
+
+int test_fixed_fields(void) {
+	printf("\tTesting every thousandths from -9999.999 to 9999.999, and the extremes\n");
+	int fail_count = 0;
+
+	for (int32_t v = -9999999; v <= 9999999 && fail_count < 10; v++) {
+		fail_count += compare_fixed_with_snprintf(v, 8);
+	}
+
+	const int32_t specials[] = {0, 1, -1, 999, -999, 1000, -1000, INT32_MAX, INT32_MIN};
+	for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]); i++) {
+		for (int width = 1; width < 16; width++) {
+			fail_count += compare_fixed_with_snprintf(specials[i], width);
+		}
+	}
+
+	if (fail_count) printf("\t\tFixed point fields: " FAIL("FAILED") "\n");
+	else printf("\t\tFixed point fields: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int main(void) {
+	printf("starting tests on field_formatter.c\n");
+	int fail_count = 0;
+	fail_count += test_exhaustive_binades();
+	fail_count += test_exhaustive_3_decimals();
+	fail_count += test_random_bits();
+	fail_count += test_fixed_fields();
+	return fail_count ? 1 : 0;
+}
@@ -0,0 +1,280 @@
+#include "../include/field_parser.h"
+#include "../include/ANSI_colors.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define FAIL( str ) RED_BG BLK_FG str DEF_BG DEF_FG
+#define PASS( str ) GRN_BG BLK_FG str DEF_BG DEF_FG
+
+#define RANDOM_CORPUS_SIZE 20000000
+#define FIELD_BUFF_SIZE 64
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t xorshift64(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+/*! Compares parse_field with strtof on the first `max_size` characters
+ *  of a single field.
+ *
+ * @return 0 if both the values and the end pointers are identical.
+ */
+int compare_with_strtof(const char *field, int max_size) {
+	char bounded[FIELD_BUFF_SIZE];
+	size_t size = strnlen(field, (size_t) max_size);
+	memcpy(bounded, field, size);
+	bounded[size] = '\0';
+
+	char *end_ref = NULL;
+	char *end_fast = NULL;
+	float ref = strtof(bounded, &end_ref);
+	float fast = parse_field(field, max_size, &end_fast);
+
+	if (memcmp(&ref, &fast, sizeof(float)) || end_ref - bounded != end_fast - field) {
+		printf(
+			"\t\t`%s` (max %d): strtof gave %a (+%d), parse_field gave %a (+%d)\n",
+			field, max_size,
+			(double) ref, (int) (end_ref - bounded),
+			(double) fast, (int) (end_fast - field)
+		);
+		return 1;
+	}
+	return 0;
+}
+
+int test_edge_cases(void) {
+	const char *fields[] = {
+		"0.000,", "-0.000,", "0,", "-0,", "000.000,", ".5,", "-.5,", "5.,",
+		"999.999\r\n", "-999.999\n", "16777216,", "16777217,", "0.1,",
+		"123456789,", "1234567890,", "0.0000000001,", "0.00000000001,",
+		"1e3,", "1.5E-2,", "0x1A,", "0x,", "inf,", "-nan,", " 1.5,", "+1.5,",
+		"-,", ".,", ",", "\n", "", "1.5e,", "3.40282e38,", "1e-50,",
+	};
+	const int field_count = sizeof(fields) / sizeof(fields[0]);
+
+	printf("\tTesting edge cases\n");
+	int fail_count = 0;
+	for (int i = 0; i < field_count; i++) {
+		fail_count += compare_with_strtof(fields[i], 8);
+		fail_count += compare_with_strtof(fields[i], 3);
+	}
+
+	if (fail_count) printf("\t\tEdge cases: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tEdge cases: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_exhaustive_3_decimals(void) {
+	printf("\tTesting every value from -999.999 to 999.999\n");
+	char field[FIELD_BUFF_SIZE];
+	int fail_count = 0;
+
+	for (int32_t v = -999999; v <= 999999 && fail_count < 10; v++) {
+		int32_t a = v < 0 ? -v : v;
+		snprintf(field, FIELD_BUFF_SIZE, "%s%d.%03d,", v < 0 ? "-" : "", a / 1000, a % 1000);
+		fail_count += compare_with_strtof(field, 8);
+	}
+
+	if (fail_count) printf("\t\tExhaustive range: " FAIL("FAILED") "\n");
+	else printf("\t\tExhaustive range: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_random_corpus(void) {
+	printf("\tTesting a random corpus of %d fields\n", RANDOM_CORPUS_SIZE);
+	const char terminators[] = ",\r\n";
+	char field[FIELD_BUFF_SIZE];
+	int fail_count = 0;
+
+	for (int i = 0; i < RANDOM_CORPUS_SIZE && fail_count < 10; i++) {
+		uint64_t r = xorshift64();
+		char *p = field;
+
+		if (r & 1) *p++ = '-';
+		r >>= 1;
+
+		int int_digits = r % 11; // up to 10 to go past the fast path
+		r /= 11;
+		int frac_digits = r % 12;
+		r /= 12;
+		char with_dot = (r & 3) != 0;
+		r >>= 2;
+
+		for (int d = 0; d < int_digits; d++) *p++ = '0' + xorshift64() % 10;
+		if (with_dot) *p++ = '.';
+		for (int d = 0; d < frac_digits; d++) *p++ = '0' + xorshift64() % 10;
+		*p++ = terminators[r % 3];
+		*p = '\0';
+
+		int max_size = 1 + (int) ((r >> 2) % 16);
+		fail_count += compare_with_strtof(field, max_size);
+	}
+
+	if (fail_count) printf("\t\tRandom corpus: " FAIL("FAILED") "\n");
+	else printf("\t\tRandom corpus: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+/*! Parses fields ending right before a page that can't be read, as the
+ *  last field of a mapped source without eol does. The thousandths must
+ *  be those of the same field followed by a nul.
+ */
+int test_guarded_end(void) {
+	printf("\tTesting fields ending at an unreadable page\n");
+#if defined(__APPLE__) || defined(__LINUX__)
+	const char *fields[] = {
+		"0.000", "-999.999", "7", "-", "", "12.", ".5", "123456789",
+		"1234567890", "0.00000000001", "1e3", "1.5e", "inf", "-nan", "0x1A",
+	};
+	const int field_count = sizeof(fields) / sizeof(fields[0]);
+
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	char *map = (char *) mmap(NULL, 2 * page, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED || mprotect(map + page, page, PROT_NONE)) {
+		printf("\t\tGuarded end: " FAIL("FAILED") " to map the pages\n");
+		return 1;
+	}
+	char *guard = map + page;
+
+	int fail_count = 0;
+	for (int i = 0; i < field_count; i++) {
+		int size = (int) strlen(fields[i]);
+		char *start = guard - size;
+		memcpy(start, fields[i], (size_t) size);
+
+		char *end_ref = NULL;
+		char *end_fast = NULL;
+		float ref = strtof(fields[i], &end_ref);
+		float fast = parse_field(start, size, &end_fast);
+		if (memcmp(&ref, &fast, sizeof(float)) || end_ref - fields[i] != end_fast - start) {
+			printf(
+				"\t\t`%s`: strtof gave %a (+%d), parse_field gave %a (+%d)\n",
+				fields[i], (double) ref, (int) (end_ref - fields[i]),
+				(double) fast, (int) (end_fast - start)
+			);
+			fail_count++;
+		}
+
+		char *end_nul = NULL;
+		char *end_guarded = NULL;
+		int32_t fixed_nul = parse_fixed_field(fields[i], size, &end_nul);
+		int32_t fixed_guarded = parse_fixed_field(start, size, &end_guarded);
+		if (fixed_nul != fixed_guarded || end_nul - fields[i] != end_guarded - start) {
+			printf(
+				"\t\t`%s`: parse_fixed_field gave %d (+%d), %d (+%d) at the guard\n",
+				fields[i], fixed_nul, (int) (end_nul - fields[i]),
+				fixed_guarded, (int) (end_guarded - start)
+			);
+			fail_count++;
+		}
+	}
+	munmap(map, 2 * page);
+
+	if (fail_count) printf("\t\tGuarded end: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tGuarded end: " PASS("PASSED") "\n");
+	return fail_count;
+#else
+	printf("\t\tGuarded end: skipped, no mmap\n");
+	return 0;
+#endif
+}
+
+/*! Compares parse_fixed_field with the thousandths expected.
+ *
+ * @return 0 if both the values and the end pointers are as expected.
+ */
+int check_fixed(const char *field, int max_size, int32_t expected, int length) {
+	char *end = NULL;
+	int32_t value = parse_fixed_field(field, max_size, &end);
+
+	if (value != expected || end != field + length) {
+		printf(
+			"\t\t`%s` (max %d): expected %d (+%d), parse_fixed_field gave %d (+%d)\n",
+			field, max_size, expected, length, value, (int) (end - field)
+		);
+		return 1;
+	}
+	return 0;
+}
+
+int test_fixed_fields(void) {
+	printf("\tTesting fields read as thousandths\n");
+	char field[FIELD_BUFF_SIZE];
+	int fail_count = 0;
+
+	// every 3 decimals value, exactly
+	for (int32_t v = -999999; v <= 999999 && fail_count < 10; v++) {
+		int32_t a = v < 0 ? -v : v;
+		int length = snprintf(field, FIELD_BUFF_SIZE, "%s%d.%03d,", v < 0 ? "-" : "", a / 1000, a % 1000) - 1;
+		fail_count += check_fixed(field, 8, v, length);
+	}
+
+	// fewer decimals are scaled, more are rounded half away from zero
+	fail_count += check_fixed("12.5,", 8, 12500, 4);
+	fail_count += check_fixed("7\r\n", 8, 7000, 1);
+	fail_count += check_fixed("-.5,", 8, -500, 3);
+	fail_count += check_fixed("5.,", 8, 5000, 2);
+	fail_count += check_fixed("1.2345,", 8, 1235, 6);
+	fail_count += check_fixed("-1.2345,", 8, -1235, 7);
+	fail_count += check_fixed("1.23449999,", 16, 1234, 10);
+	fail_count += check_fixed("-0.0004,", 8, 0, 7);
+	fail_count += check_fixed("2147483.647,", 16, 2147483647, 11);
+	// cut at max_size, like parse_field
+	fail_count += check_fixed("999.999", 3, 999000, 3);
+	fail_count += check_fixed("1.25e3,", 4, 1250, 4);
+
+	// handed to strtod
+	fail_count += check_fixed("1e3,", 8, 1000000, 3);
+	fail_count += check_fixed("-2.5e-3,", 8, -3, 7);
+	fail_count += check_fixed("2147483.648,", 16, 2147483647, 11);
+	fail_count += check_fixed("-99999999,", 16, -2147483647 - 1, 9);
+	fail_count += check_fixed("nan,", 8, 0, 3);
+	fail_count += check_fixed(",", 8, 0, 0);
+
+	for (int i = 0; i < RANDOM_CORPUS_SIZE / 10 && fail_count < 10; i++) {
+		uint64_t r = xorshift64();
+		int32_t v = (int32_t) (r % 4294966000u) - 2147483000;
+		int extra_digits = (int) ((r >> 32) % 7);
+		int32_t a = v < 0 ? -v : v;
+		char *p = field + snprintf(field, FIELD_BUFF_SIZE, "%s%d.%03d", v < 0 ? "-" : "", a / 1000, a % 1000);
+
+		char first_extra = '0';
+		for (int d = 0; d < extra_digits; d++) {
+			*p = '0' + xorshift64() % 10;
+			if (d == 0) first_extra = *p;
+			p++;
+		}
+		*p++ = ',';
+		*p = '\0';
+
+		int32_t expected = v;
+		if (first_extra >= '5') expected += v < 0 ? -1 : 1;
+		fail_count += check_fixed(field, FIELD_BUFF_SIZE, expected, (int) (p - field) - 1);
+	}
+
+	if (fail_count) printf("\t\tFixed point fields: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tFixed point fields: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int main(void) {
+	printf("starting tests on field_parser.c\n");
+	int fail_count = 0;
+	fail_count += test_edge_cases();
+	fail_count += test_exhaustive_3_decimals();
+	fail_count += test_random_corpus();
+	fail_count += test_guarded_end();
+	fail_count += test_fixed_fields();
+	return fail_count ? 1 : 0;
+}
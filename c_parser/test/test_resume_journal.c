@@ -0,0 +1,196 @@
+#include "../include/resume_journal.h"
+#include "../include/ANSI_colors.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <unistd.h>
+#endif
+
+#define FAIL( str ) RED_BG BLK_FG str DEF_BG DEF_FG
+#define PASS( str ) GRN_BG BLK_FG str DEF_BG DEF_FG
+
+#define FINGERPRINT 0x8c2f0e5b4a7d1936ULL
+
+/*! Reads the journal of `dest` and compares it with what is expected.
+ *
+ * @return 0 if the status and the last commit are the expected ones.
+ */
+int check_read(const char *dest, uint64_t fingerprint, Journal_status expected, const JournalEntry *last, const char *what) {
+	JournalEntry e;
+	Journal_status status = read_journal(dest, fingerprint, &e);
+	if (status != expected) {
+		printf("\t\t%s: status %d instead of %d\n", what, (int) status, (int) expected);
+		return 1;
+	}
+	if (last != NULL && (e.next_chunk != last->next_chunk || e.rows != last->rows || e.source_offset != last->source_offset)) {
+		printf(
+			"\t\t%s: commit %d %lld %llu instead of %d %lld %llu\n", what,
+			e.next_chunk, (long long) e.rows, (unsigned long long) e.source_offset,
+			last->next_chunk, (long long) last->rows, (unsigned long long) last->source_offset
+		);
+		return 1;
+	}
+	return 0;
+}
+
+/*! Writes `text` as the journal of `dest`. */
+int write_journal_text(const char *dest, const char *text) {
+	char path[MAXIMUM_PATH()];
+	snprintf(path, sizeof(path), "%s/%s", dest, JOURNAL_NAME);
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL) return 1;
+	int err = fputs(text, fp) < 0;
+	return fclose(fp) || err;
+}
+
+int test_commits(const char *dest) {
+	printf("\tTesting commits read back\n");
+	int fail_count = 0;
+	JournalEntry none = {0};
+
+	fail_count += journal_exists(dest) != 0;
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_MISSING, &none, "no journal");
+
+	ResumeJournal rj = {0};
+	fail_count += open_ResumeJournal(&rj, dest, FINGERPRINT, &none) != 0;
+	fail_count += journal_exists(dest) != 1;
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_FOUND, &none, "no commit");
+
+	JournalEntry e = {0};
+	for (int i = 1; i <= 5; i++) {
+		e = (JournalEntry) {.next_chunk = 2 * i, .rows = 200 * i, .source_offset = 5000000000ULL * i};
+		fail_count += commit_journal(&rj, &e) != 0;
+		fail_count += check_read(dest, FINGERPRINT, JOURNAL_FOUND, &e, "commit");
+	}
+
+	// nothing is left of the temporary journals
+	char tmp_path[MAXIMUM_PATH() + 8];
+	snprintf(tmp_path, sizeof(tmp_path), "%s/%s.tmp", dest, JOURNAL_NAME);
+	FILE *tmp = fopen(tmp_path, "rb");
+	if (tmp != NULL) {
+		printf("\t\t%s left behind\n", tmp_path);
+		fclose(tmp);
+		fail_count++;
+	}
+
+	// a run picked up from its last commit starts from it
+	close_ResumeJournal(&rj, 0);
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_FOUND, &e, "closed");
+	fail_count += open_ResumeJournal(&rj, dest, FINGERPRINT, &e) != 0;
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_FOUND, &e, "reopened");
+
+	// and a complete run removes it
+	close_ResumeJournal(&rj, 1);
+	fail_count += journal_exists(dest) != 0;
+	fail_count += commit_journal(&rj, &e) == 0;
+
+	if (fail_count) printf("\t\tCommits: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tCommits: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_damaged_journals(const char *dest) {
+	printf("\tTesting journals of another run or cut short\n");
+	int fail_count = 0;
+	char text[512];
+	JournalEntry first = {.next_chunk = 3, .rows = 300, .source_offset = 1234};
+
+	// written with other settings
+	ResumeJournal rj = {0};
+	fail_count += open_ResumeJournal(&rj, dest, FINGERPRINT, &first) != 0;
+	close_ResumeJournal(&rj, 0);
+	fail_count += check_read(dest, FINGERPRINT + 1, JOURNAL_MISMATCH, NULL, "other fingerprint");
+
+	// a last commit cut short by the end of the run is ignored
+	snprintf(
+		text, sizeof(text), "csv_parser resume journal 1\nfingerprint %016llx\ncommit 3 300 1234\ncommit 6 600 24",
+		(unsigned long long) FINGERPRINT
+	);
+	fail_count += write_journal_text(dest, text);
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_FOUND, &first, "commit cut short");
+
+	// so are commits going backwards and garbage
+	snprintf(
+		text, sizeof(text), "csv_parser resume journal 1\nfingerprint %016llx\ncommit 3 300 1234\ncommit 2 200 2000\ncommit 9 900 9000\n",
+		(unsigned long long) FINGERPRINT
+	);
+	fail_count += write_journal_text(dest, text);
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_FOUND, &first, "commit going backwards");
+
+	snprintf(
+		text, sizeof(text), "csv_parser resume journal 1\nfingerprint %016llx\ncommit 3 300 1234\ncommit -1 0 0\n",
+		(unsigned long long) FINGERPRINT
+	);
+	fail_count += write_journal_text(dest, text);
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_FOUND, &first, "negative commit");
+
+	// a header that is not ours
+	fail_count += write_journal_text(dest, "csv_parser resume journal 2\nfingerprint 0\n");
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_UNREADABLE, NULL, "other version");
+	fail_count += write_journal_text(dest, "csv_parser resume journal 1\n");
+	fail_count += check_read(dest, FINGERPRINT, JOURNAL_UNREADABLE, NULL, "no fingerprint");
+
+	char path[MAXIMUM_PATH()];
+	snprintf(path, sizeof(path), "%s/%s", dest, JOURNAL_NAME);
+	remove(path);
+
+	if (fail_count) printf("\t\tDamaged journals: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tDamaged journals: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_fingerprint(void) {
+	printf("\tTesting the fingerprint of a run\n");
+	int fail_count = 0;
+
+	Config conf = {0};
+	snprintf(conf.source, sizeof(conf.source), "/data/source.csv");
+	conf.tile_width = 300;
+	conf.tile_height = 100;
+	conf.downsample_factor = 2;
+	uint64_t base = run_fingerprint(&conf, 1000, 42);
+
+	fail_count += run_fingerprint(&conf, 1000, 42) != base;
+	fail_count += run_fingerprint(&conf, 1001, 42) == base;
+	fail_count += run_fingerprint(&conf, 1000, 43) == base;
+
+	Config other = conf;
+	other.tile_height = 101;
+	fail_count += run_fingerprint(&other, 1000, 42) == base;
+	other = conf;
+	other.roi_col_end = 10;
+	fail_count += run_fingerprint(&other, 1000, 42) == base;
+	other = conf;
+	snprintf(other.source, sizeof(other.source), "/data/source2.csv");
+	fail_count += run_fingerprint(&other, 1000, 42) == base;
+
+	// what does not shape the output does not matter
+	other = conf;
+	other.threads = 8;
+	other.write_mode = WRITE_MMAP;
+	fail_count += run_fingerprint(&other, 1000, 42) != base;
+
+	if (fail_count) printf("\t\tFingerprint: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tFingerprint: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int main(void) {
+	printf("starting tests on resume_journal.c\n");
+	int fail_count = 0;
+#if defined(__APPLE__) || defined(__LINUX__)
+	char dest[] = "/tmp/test_resume_journal_XXXXXX";
+	if (mkdtemp(dest) == NULL) {
+		printf("\tcould not create a destination in /tmp\n");
+		return 1;
+	}
+	fail_count += test_commits(dest);
+	fail_count += test_damaged_journals(dest);
+	rmdir(dest);
+#endif
+	fail_count += test_fingerprint();
+	return fail_count ? 1 : 0;
+}
@@ -0,0 +1,217 @@
+#include "../include/row_index.h"
+#include "../include/ANSI_colors.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FAIL( str ) RED_BG BLK_FG str DEF_BG DEF_FG
+#define PASS( str ) GRN_BG BLK_FG str DEF_BG DEF_FG
+
+#define ROW_COUNT 2000
+#define PATH_SIZE 64
+
+#if defined(__APPLE__) || defined(__LINUX__)
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t xorshift64(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+/*! Writes a source of ROW_COUNT rows to `fd`, from empty rows to rows of
+ *  a few hundred kB, so that the distances between rows take every varint
+ *  size up to 3 bytes. The last row has no eol, every other one is one
+ *  byte at least.
+ *
+ * @return 0 on success, with the offset of every row and of the end of
+ *         the source in `starts`.
+ */
+static int write_source(int fd, uint64_t starts[ROW_COUNT + 1]) {
+	char *row = (char *) malloc(1 << 19);
+	if (row == NULL) return 1;
+	memset(row, '7', 1 << 19);
+
+	uint64_t offset = 0;
+	for (int i = 0; i < ROW_COUNT; i++) {
+		starts[i] = offset;
+		uint64_t r = xorshift64();
+		size_t length = (r & 3) == 0 ? (size_t) (r >> 8) % 200
+			: (r & 3) == 1 ? (size_t) (r >> 8) % 20000
+			: (r & 3) == 2 ? 0
+			: (size_t) (r >> 8) % (1 << 18);
+		char last = i == ROW_COUNT - 1;
+		if (last && length == 0) length = 1;
+		if (!last) row[length++] = '\n';
+		if (write(fd, row, length) != (ssize_t) length) {
+			free(row);
+			return 1;
+		}
+		if (!last) row[length - 1] = '7';
+		offset += length;
+	}
+	starts[ROW_COUNT] = offset;
+	free(row);
+	return 0;
+}
+
+/*! @return the number of rows of `ri` not at the offsets of `starts`. */
+static int compare_rows(const RowIndex *ri, const uint64_t starts[ROW_COUNT + 1]) {
+	if (ri->row_count != ROW_COUNT) {
+		printf("\t\t%lld rows found instead of %d\n", (long long) ri->row_count, ROW_COUNT);
+		return 1;
+	}
+	int fail_count = 0;
+	for (int i = 0; i <= ROW_COUNT; i++) {
+		if (ri->row_starts[i] != starts[i] && fail_count++ < 5) {
+			printf(
+				"\t\trow %d at %llu instead of %llu\n",
+				i, (unsigned long long) ri->row_starts[i], (unsigned long long) starts[i]
+			);
+		}
+	}
+	return fail_count;
+}
+
+/*! Opens the index of the source and checks how it was obtained and its
+ *  rows.
+ */
+static int check_open(const char *path, int fd, Row_index_status expected, const char *what, const uint64_t starts[ROW_COUNT + 1]) {
+	RowIndex ri;
+	Row_index_status status = open_RowIndex(&ri, path, fd);
+	int fail_count = 0;
+	if (status != expected) {
+		printf("\t\t%s: status %d instead of %d\n", what, (int) status, (int) expected);
+		fail_count++;
+	}
+	if (status != ROW_INDEX_FAILED) fail_count += compare_rows(&ri, starts);
+	free_RowIndex(&ri);
+	return fail_count;
+}
+
+/*! Flips a byte of the sidecar at `offset`. */
+static int flip_byte(const char *sidecar, long offset) {
+	FILE *fp = fopen(sidecar, "rb+");
+	if (fp == NULL) return 1;
+	int c = fseek(fp, offset, SEEK_SET) ? EOF : fgetc(fp);
+	int err = c == EOF || fseek(fp, offset, SEEK_SET) || fputc(c ^ 0x01, fp) == EOF;
+	return fclose(fp) || err;
+}
+#endif
+
+int test_round_trip(void) {
+	printf("\tTesting the sidecar round trip and its invalidation\n");
+#if defined(__APPLE__) || defined(__LINUX__)
+	char path[PATH_SIZE] = "/tmp/test_row_index_XXXXXX";
+	char sidecar[PATH_SIZE + sizeof(ROW_INDEX_SUFFIX)];
+	int fd = mkstemp(path);
+	snprintf(sidecar, sizeof(sidecar), "%s" ROW_INDEX_SUFFIX, path);
+
+	uint64_t *starts = (uint64_t *) malloc((ROW_COUNT + 1) * sizeof(uint64_t));
+	if (fd < 0 || starts == NULL || write_source(fd, starts)) {
+		printf("\t\tRound trip: " FAIL("FAILED") " to write the source\n");
+		if (fd >= 0) close(fd);
+		unlink(path);
+		free(starts);
+		return 1;
+	}
+
+	int fail_count = 0;
+	fail_count += check_open(path, fd, ROW_INDEX_BUILT, "first open", starts);
+	fail_count += check_open(path, fd, ROW_INDEX_LOADED, "second open", starts);
+
+	// a payload byte changed: the hash no longer matches
+	fail_count += flip_byte(sidecar, 60);
+	fail_count += check_open(path, fd, ROW_INDEX_BUILT, "payload changed", starts);
+
+	// another modification time: the source may have changed
+	struct timespec times[2] = {{0, UTIME_OMIT}, {1000000000, 123}};
+	fail_count += futimens(fd, times) != 0;
+	fail_count += check_open(path, fd, ROW_INDEX_BUILT, "mtime changed", starts);
+	fail_count += check_open(path, fd, ROW_INDEX_LOADED, "rebuilt", starts);
+
+	// another source size, in the header only
+	fail_count += flip_byte(sidecar, 8);
+	fail_count += check_open(path, fd, ROW_INDEX_BUILT, "size changed", starts);
+
+	// a sidecar cut short
+	fail_count += truncate(sidecar, 100) != 0;
+	fail_count += check_open(path, fd, ROW_INDEX_BUILT, "sidecar cut", starts);
+
+	// a row looked up from an offset
+	RowIndex ri;
+	if (open_RowIndex(&ri, path, fd) == ROW_INDEX_LOADED) {
+		for (int i = 0; i < ROW_COUNT; i += 7) {
+			if (row_at_offset(&ri, starts[i]) != i) fail_count++;
+			// within the row before, unless it is a bare eol
+			if (i > 0 && starts[i] - 1 > starts[i - 1] && row_at_offset(&ri, starts[i] - 1) != i) fail_count++;
+		}
+		if (row_at_offset(&ri, starts[ROW_COUNT]) != ROW_COUNT) fail_count++;
+	} else {
+		fail_count++;
+	}
+	free_RowIndex(&ri);
+
+	close(fd);
+	unlink(sidecar);
+	unlink(path);
+	free(starts);
+
+	if (fail_count) printf("\t\tRound trip: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tRound trip: " PASS("PASSED") "\n");
+	return fail_count;
+#else
+	printf("\t\tRound trip: skipped, no pread\n");
+	return 0;
+#endif
+}
+
+int test_skip_rows(void) {
+	printf("\tTesting rows skipped without an index\n");
+#if defined(__APPLE__) || defined(__LINUX__)
+	char path[PATH_SIZE] = "/tmp/test_row_index_XXXXXX";
+	int fd = mkstemp(path);
+	const char source[] = "a\nbb\n\nccc\r\ndddd";
+	if (fd < 0 || write(fd, source, sizeof(source) - 1) != (ssize_t) sizeof(source) - 1) {
+		printf("\t\tSkip rows: " FAIL("FAILED") " to write the source\n");
+		if (fd >= 0) close(fd);
+		unlink(path);
+		return 1;
+	}
+	uint64_t size = sizeof(source) - 1;
+
+	int fail_count = 0;
+	uint64_t offset = 0;
+	fail_count += skip_rows(fd, size, &offset, 2) != 2 || offset != 5;
+	fail_count += skip_rows(fd, size, &offset, 2) != 2 || offset != 11;
+	// the last row has no eol, and there is no row past it
+	fail_count += skip_rows(fd, size, &offset, 5) != 1 || offset != size;
+	fail_count += skip_rows(fd, size, &offset, 1) != 0 || offset != size;
+
+	close(fd);
+	unlink(path);
+
+	if (fail_count) printf("\t\tSkip rows: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tSkip rows: " PASS("PASSED") "\n");
+	return fail_count;
+#else
+	printf("\t\tSkip rows: skipped, no pread\n");
+	return 0;
+#endif
+}
+
+int main(void) {
+	printf("starting tests on row_index.c\n");
+	int fail_count = 0;
+	fail_count += test_round_trip();
+	fail_count += test_skip_rows();
+	return fail_count ? 1 : 0;
+}
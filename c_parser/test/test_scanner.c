@@ -0,0 +1,193 @@
+#include "../include/scanner.h"
+#include "../include/ANSI_colors.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define FAIL( str ) RED_BG BLK_FG str DEF_BG DEF_FG
+#define PASS( str ) GRN_BG BLK_FG str DEF_BG DEF_FG
+
+#define BUFF_SIZE 256
+#define MAX_HITS 64
+#define RANDOM_ROUNDS 200000
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t xorshift64(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+/*! Fills `size` bytes with digits, separators and, one time in
+ *  `eol_odds`, eols.
+ */
+static void fill_random(char *buff, int size, int eol_odds) {
+	const char others[] = "0123456789.-\r";
+	for (int i = 0; i < size; i++) {
+		uint64_t r = xorshift64();
+		if (r % eol_odds == 0) buff[i] = '\n';
+		else if ((r >> 16) % 4 == 0) buff[i] = ',';
+		else buff[i] = others[(r >> 24) % (sizeof(others) - 1)];
+	}
+}
+
+/*! Plain scan_row, one byte at a time. */
+static int64_t reference_scan_row(const char *row, const char *limit, uint32_t *ends, int64_t capacity, const char **eol) {
+	int64_t hits = 0;
+	*eol = NULL;
+	for (const char *p = row; p < limit; p++) {
+		if (*p != ',' && *p != '\n') continue;
+		if (hits < capacity) ends[hits] = (uint32_t) (p - row);
+		hits++;
+		if (*p == '\n') {
+			*eol = p;
+			break;
+		}
+	}
+	return hits;
+}
+
+/*! Compares scan_row and scan_eol with the plain scan on [row, limit).
+ *
+ * @return 0 if they find the same hits and eol.
+ */
+static int compare_scans(const char *row, const char *limit, int64_t capacity) {
+	uint32_t ends[MAX_HITS];
+	uint32_t ref_ends[MAX_HITS];
+	const char *eol = NULL;
+	const char *ref_eol = NULL;
+
+	int64_t hits = scan_row(row, limit, ends, capacity, &eol);
+	int64_t ref_hits = reference_scan_row(row, limit, ref_ends, capacity, &ref_eol);
+	int64_t stored = ref_hits < capacity ? ref_hits : capacity;
+
+	int fail = hits != ref_hits || eol != ref_eol
+		|| memcmp(ends, ref_ends, (size_t) stored * sizeof(uint32_t))
+		|| scan_eol(row, limit) != ref_eol;
+	if (fail) {
+		printf(
+			"\t\t%d bytes, capacity %lld: %lld hits, eol at %d, reference %lld hits, eol at %d\n",
+			(int) (limit - row), (long long) capacity,
+			(long long) hits, eol == NULL ? -1 : (int) (eol - row),
+			(long long) ref_hits, ref_eol == NULL ? -1 : (int) (ref_eol - row)
+		);
+	}
+	return fail;
+}
+
+int test_random_rows(void) {
+	printf("\tTesting rows of every length and alignment\n");
+	char buff[BUFF_SIZE];
+	int fail_count = 0;
+
+	for (int i = 0; i < RANDOM_ROUNDS && fail_count < 10; i++) {
+		uint64_t r = xorshift64();
+		// from rows ending in the first block to rows with no eol at all
+		int eol_odds = 2 + (int) (r % 300);
+		fill_random(buff, BUFF_SIZE, eol_odds);
+
+		int offset = (int) ((r >> 16) % 64);
+		int length = (int) ((r >> 24) % (BUFF_SIZE - offset + 1));
+		int64_t capacity = (int64_t) ((r >> 40) % (MAX_HITS + 1));
+		fail_count += compare_scans(buff + offset, buff + offset + length, capacity);
+	}
+
+	if (fail_count) printf("\t\tRandom rows: " FAIL("FAILED") "\n");
+	else printf("\t\tRandom rows: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_guarded_end(void) {
+	printf("\tTesting rows ending at an unreadable page\n");
+#if defined(__APPLE__) || defined(__LINUX__)
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	char *map = (char *) mmap(NULL, 2 * page, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED || mprotect(map + page, page, PROT_NONE)) {
+		printf("\t\tGuarded end: " FAIL("FAILED") " to map the pages\n");
+		return 1;
+	}
+	char *guard = map + page;
+
+	int fail_count = 0;
+	for (int length = 0; length <= 200 && fail_count < 10; length++) {
+		// no eol, so that every scan runs into the guard
+		fill_random(guard - length, length, 1 << 30);
+		fail_count += compare_scans(guard - length, guard, MAX_HITS);
+
+		// and the eol as the last byte
+		if (length > 0) {
+			guard[-1] = '\n';
+			fail_count += compare_scans(guard - length, guard, MAX_HITS);
+		}
+	}
+	munmap(map, 2 * page);
+
+	if (fail_count) printf("\t\tGuarded end: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tGuarded end: " PASS("PASSED") "\n");
+	return fail_count;
+#else
+	printf("\t\tGuarded end: skipped, no mmap\n");
+	return 0;
+#endif
+}
+
+int test_index_chunk(void) {
+	printf("\tTesting the index of a chunk\n");
+	const char chunk[] = "1,2,3\n,,\n\n4.5,6\r\n7,8,9,10\n11";
+	const char *limit = chunk + sizeof(chunk) - 1;
+	int fail_count = 0;
+
+	int64_t row_starts[8];
+	int32_t row_fields[8];
+	uint32_t field_ends[8 * 3];
+	ChunkIndex idx = {
+		.field_ends = field_ends, .row_starts = row_starts, .row_fields = row_fields,
+		.row_length = 3, .row_capacity = 7
+	};
+
+	// the last row has no eol, it is only a row at the end of the file
+	const char *next = index_chunk(&idx, chunk, limit, 7, 0);
+	int64_t expected_starts[] = {0, 6, 9, 10, 17, 26};
+	int32_t expected_fields[] = {3, 3, 1, 2, 4};
+	fail_count += idx.row_count != 5 || next != chunk + 26;
+	for (int r = 0; r <= 5 && idx.row_count == 5; r++) {
+		fail_count += row_starts[r] != expected_starts[r];
+		if (r < 5) fail_count += row_fields[r] != expected_fields[r];
+	}
+	// the offsets of the fields, the eol of row 4 counted but not stored
+	uint32_t expected_ends[5][3] = {{1, 3, 5}, {0, 1, 2}, {0}, {3, 6}, {1, 3, 5}};
+	for (int r = 0; r < 5; r++) {
+		for (int i = 0; i < expected_fields[r] && i < 3; i++) {
+			fail_count += field_ends[r * 3 + i] != expected_ends[r][i];
+		}
+	}
+
+	next = index_chunk(&idx, chunk, limit, 7, 1);
+	fail_count += idx.row_count != 6 || next != limit || row_starts[6] != (int64_t) (limit - chunk);
+	fail_count += row_fields[5] != 1 || field_ends[15] != 2;
+
+	// no more rows than asked for
+	next = index_chunk(&idx, chunk, limit, 2, 1);
+	fail_count += idx.row_count != 2 || next != chunk + 9 || row_starts[2] != 9;
+
+	if (fail_count) printf("\t\tChunk index: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tChunk index: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int main(void) {
+	printf("starting tests on scanner.c\n");
+	int fail_count = 0;
+	fail_count += test_random_rows();
+	fail_count += test_guarded_end();
+	fail_count += test_index_chunk();
+	return fail_count ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+#include "../include/value_cache.h"
+#include "../include/ANSI_colors.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__LINUX__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FAIL( str ) RED_BG BLK_FG str DEF_BG DEF_FG
+#define PASS( str ) GRN_BG BLK_FG str DEF_BG DEF_FG
+
+#define ROW_COUNT 1000
+#define ROW_LENGTH 3
+#define PATH_SIZE 64
+
+#if defined(__APPLE__) || defined(__LINUX__)
+/*! Writes ROW_COUNT rows of ROW_LENGTH fields to `fd`, and the values
+ *  and row offsets read_chunk would give for them.
+ *
+ * @return the size of the source, 0 on a write error.
+ */
+static uint64_t write_source(int fd, float *values, int64_t *row_starts) {
+	char row[64];
+	uint64_t offset = 0;
+	for (int i = 0; i < ROW_COUNT; i++) {
+		int length = snprintf(row, sizeof(row), "%d.5,-%d.25,%d\n", i, i % 17, i * 3);
+		if (write(fd, row, (size_t) length) != length) return 0;
+		values[i * ROW_LENGTH] = (float) i + 0.5f;
+		values[i * ROW_LENGTH + 1] = -(float) (i % 17) - 0.25f;
+		values[i * ROW_LENGTH + 2] = (float) (i * 3);
+		row_starts[i] = (int64_t) offset;
+		offset += (uint64_t) length;
+	}
+	return offset;
+}
+
+/*! Writes the cache of the source in two batches, the second one with
+ *  offsets relative to where it starts, as chunks have them.
+ *
+ * @return 0 on success.
+ */
+static int write_cache(const char *path, int fd, const float *values, const int64_t *row_starts) {
+	ValueCache vc;
+	int fail_count = open_ValueCache(&vc, path, fd, ROW_LENGTH) != VALUE_CACHE_MISSING;
+	fail_count += start_ValueCache(&vc) != 0;
+
+	int32_t half = ROW_COUNT / 2;
+	int64_t second[ROW_COUNT];
+	for (int i = half; i < ROW_COUNT; i++) second[i - half] = row_starts[i] - row_starts[half];
+	fail_count += append_ValueCache(&vc, values, half, row_starts, 0) != 0;
+	fail_count += append_ValueCache(&vc, values + half * ROW_LENGTH, ROW_COUNT - half, second, (uint64_t) row_starts[half]) != 0;
+	fail_count += finish_ValueCache(&vc) != 0;
+	close_ValueCache(&vc);
+	return fail_count;
+}
+
+/*! Opens the cache, and compares it with the source if loaded.
+ *
+ * @return 0 if it was opened with the `expected` status, and holds the
+ *         values and rows of the source if loaded.
+ */
+static int check_open(
+	const char *path, int fd, int32_t row_length, Value_cache_status expected, const char *what,
+	const float *values, const int64_t *row_starts, uint64_t source_size
+) {
+	ValueCache vc;
+	Value_cache_status status = open_ValueCache(&vc, path, fd, row_length);
+	int fail_count = 0;
+	if (status != expected) {
+		printf("\t\t%s: status %d instead of %d\n", what, (int) status, (int) expected);
+		fail_count++;
+	}
+	if (status == VALUE_CACHE_LOADED) {
+		if (vc.rows.row_count != ROW_COUNT || vc.rows.row_starts[ROW_COUNT] != source_size) {
+			printf("\t\t%s: %lld rows instead of %d\n", what, (long long) vc.rows.row_count, ROW_COUNT);
+			fail_count++;
+		} else {
+			for (int i = 0; i < ROW_COUNT; i++) {
+				if (vc.rows.row_starts[i] != (uint64_t) row_starts[i]) fail_count++;
+			}
+			if (memcmp(vc.values, values, (size_t) ROW_COUNT * ROW_LENGTH * sizeof(float))) {
+				printf("\t\t%s: values differ\n", what);
+				fail_count++;
+			}
+		}
+	}
+	close_ValueCache(&vc);
+	return fail_count;
+}
+
+/*! @return 1 if the file at `path` exists, 0 otherwise. */
+static int file_exists(const char *path) {
+	struct stat st;
+	return stat(path, &st) == 0;
+}
+#endif
+
+int test_load(void) {
+	printf("\tTesting a cache written, loaded and found stale\n");
+#if defined(__APPLE__) || defined(__LINUX__)
+	char path[PATH_SIZE] = "/tmp/test_value_cache_XXXXXX";
+	char cache[PATH_SIZE + sizeof(VALUE_CACHE_SUFFIX)];
+	char tmp[PATH_SIZE + sizeof(VALUE_CACHE_SUFFIX) + 4];
+	int fd = mkstemp(path);
+	snprintf(cache, sizeof(cache), "%s" VALUE_CACHE_SUFFIX, path);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", cache);
+
+	float *values = (float *) malloc((size_t) ROW_COUNT * ROW_LENGTH * sizeof(float));
+	int64_t *row_starts = (int64_t *) malloc(ROW_COUNT * sizeof(int64_t));
+	uint64_t size = fd < 0 || values == NULL || row_starts == NULL ? 0 : write_source(fd, values, row_starts);
+	if (size == 0) {
+		printf("\t\tLoad: " FAIL("FAILED") " to write the source\n");
+		if (fd >= 0) close(fd);
+		unlink(path);
+		free(values);
+		free(row_starts);
+		return 1;
+	}
+
+	int fail_count = 0;
+
+	// a write that does not finish leaves nothing behind
+	ValueCache vc;
+	fail_count += open_ValueCache(&vc, path, fd, ROW_LENGTH) != VALUE_CACHE_MISSING;
+	fail_count += start_ValueCache(&vc) != 0;
+	fail_count += append_ValueCache(&vc, values, 10, row_starts, 0) != 0;
+	close_ValueCache(&vc);
+	fail_count += file_exists(tmp) || file_exists(cache);
+
+	fail_count += write_cache(path, fd, values, row_starts);
+	fail_count += file_exists(tmp);
+	fail_count += check_open(path, fd, ROW_LENGTH, VALUE_CACHE_LOADED, "written", values, row_starts, size);
+
+	// other fields: the values would not line up
+	fail_count += check_open(path, fd, ROW_LENGTH + 1, VALUE_CACHE_MISSING, "other row length", values, row_starts, size);
+
+	// a cache cut short
+	struct stat st;
+	fail_count += stat(cache, &st) != 0;
+	fail_count += truncate(cache, st.st_size - 8) != 0;
+	fail_count += check_open(path, fd, ROW_LENGTH, VALUE_CACHE_MISSING, "cut short", values, row_starts, size);
+
+	// another modification time: the source may have changed
+	fail_count += write_cache(path, fd, values, row_starts);
+	struct timespec times[2] = {{0, UTIME_OMIT}, {1000000000, 123}};
+	fail_count += futimens(fd, times) != 0;
+	fail_count += check_open(path, fd, ROW_LENGTH, VALUE_CACHE_MISSING, "mtime changed", values, row_starts, size);
+
+	// another size, with the same modification time
+	fail_count += write_cache(path, fd, values, row_starts);
+	fail_count += write(fd, "1,2,3\n", 6) != 6;
+	fail_count += futimens(fd, times) != 0;
+	fail_count += check_open(path, fd, ROW_LENGTH, VALUE_CACHE_MISSING, "size changed", values, row_starts, size);
+
+	close(fd);
+	unlink(cache);
+	unlink(path);
+	free(values);
+	free(row_starts);
+
+	if (fail_count) printf("\t\tLoad: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tLoad: " PASS("PASSED") "\n");
+	return fail_count;
+#else
+	printf("\t\tLoad: skipped, no mmap\n");
+	return 0;
+#endif
+}
+
+int main(void) {
+	printf("starting tests on value_cache.c\n");
+	int fail_count = 0;
+	fail_count += test_load();
+	return fail_count ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+#include "../include/value_encoder.h"
+#include "../include/ANSI_colors.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define FAIL( str ) RED_BG BLK_FG str DEF_BG DEF_FG
+#define PASS( str ) GRN_BG BLK_FG str DEF_BG DEF_FG
+
+#define RANDOM_CORPUS_SIZE 20000000
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t xorshift64(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+/*! Straightforward float to half conversion, in double precision.
+ *  Only meant to be obviously right, for finite values.
+ */
+uint16_t reference_half(float value) {
+	uint16_t sign = signbit(value) ? 0x8000 : 0;
+	double magnitude = fabs((double) value);
+	if (magnitude == 0.0) return sign;
+
+	// half values are multiples of 2^(e - 10) in [2^e, 2^(e+1)),
+	// and of 2^-24 below 2^-14
+	int exponent;
+	frexp(magnitude, &exponent);
+	exponent -= 1;
+	if (exponent < -14) exponent = -14;
+
+	// exact in double, rounded to nearest even by the default rounding mode
+	double units = nearbyint(ldexp(magnitude, 10 - exponent));
+	if (units >= 2048) {
+		units /= 2;
+		exponent++;
+	}
+	if (exponent > 15) return sign | 0x7C00;
+	if (units < 1024) return sign | (uint16_t) units; // subnormal
+	return sign | (uint16_t) ((exponent + 15) << 10) | (uint16_t) (units - 1024);
+}
+
+int compare_with_reference(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(float));
+	uint16_t ref = reference_half(value);
+	uint16_t half = float_to_half(value);
+
+	if (ref != half) {
+		printf("\t\t%a (0x%08x): expected 0x%04x, got 0x%04x\n", (double) value, bits, ref, half);
+		return 1;
+	}
+	return 0;
+}
+
+int test_half_edge_cases(void) {
+	const uint32_t patterns[] = {
+		0x00000000, 0x80000000, 0x00000001, 0x007FFFFF, 0x00800000,
+		0x33000000, 0x33000001, 0x337FFFFF, 0x33800000, 0x33C00000,
+		0x387FC000, 0x387FE000, 0x387FFFFF, 0x38800000, 0x3F800000,
+		0x3F801000, 0x3F802000, 0x3F803000, 0x477FE000, 0x477FEFFF,
+		0x477FF000, 0x477FF001, 0x47800000, 0x7F7FFFFF, 0xBF801000,
+		0xC77FF000,
+	};
+	const int pattern_count = sizeof(patterns) / sizeof(patterns[0]);
+
+	printf("\tTesting half precision edge cases\n");
+	int fail_count = 0;
+	for (int i = 0; i < pattern_count; i++) fail_count += compare_with_reference(patterns[i]);
+
+	// non finite values
+	float inf = INFINITY;
+	fail_count += float_to_half(inf) != 0x7C00;
+	fail_count += float_to_half(-inf) != 0xFC00;
+	fail_count += (float_to_half(NAN) & 0x7FFF) <= 0x7C00;
+
+	if (fail_count) printf("\t\tEdge cases: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tEdge cases: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_half_ranges(void) {
+	printf("\tTesting every float from 2^-26 to 2^17\n");
+	int fail_count = 0;
+
+	// every half exponent, normal and subnormal, and the overflow
+	for (uint32_t bits = 0x32800000; bits < 0x48000000 && fail_count < 10; bits++) {
+		fail_count += compare_with_reference(bits);
+	}
+
+	if (fail_count) printf("\t\tRanges: " FAIL("FAILED") "\n");
+	else printf("\t\tRanges: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_half_random(void) {
+	printf("\tTesting %d random finite floats\n", RANDOM_CORPUS_SIZE);
+	int fail_count = 0;
+
+	for (int i = 0; i < RANDOM_CORPUS_SIZE && fail_count < 10; i++) {
+		uint32_t bits = (uint32_t) xorshift64();
+		if ((bits & 0x7F800000) == 0x7F800000) continue;
+		fail_count += compare_with_reference(bits);
+	}
+
+	if (fail_count) printf("\t\tRandom floats: " FAIL("FAILED") "\n");
+	else printf("\t\tRandom floats: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int test_encoders(void) {
+	printf("\tTesting the float32, float16 and npy encoders\n");
+	const float values[] = {1.0f, -2.5f, 65504.0f, 1e6f};
+	unsigned char out[NPY_HEADER_SIZE];
+	int fail_count = 0;
+
+	char *end = encode_f32((char *) out, values, 2);
+	const unsigned char f32[] = {0x00, 0x00, 0x80, 0x3F, 0x00, 0x00, 0x20, 0xC0};
+	fail_count += end != (char *) out + 8 || memcmp(out, f32, sizeof(f32));
+
+	int overflow = 0;
+	end = encode_f16((char *) out, values, 4, &overflow);
+	const unsigned char f16[] = {0x00, 0x3C, 0x00, 0xC1, 0xFF, 0x7B, 0x00, 0x7C};
+	fail_count += end != (char *) out + 8 || memcmp(out, f16, sizeof(f16));
+	fail_count += overflow != 1;
+
+	write_npy_header((char *) out, 1234, 56);
+	const char start[] = "\x93NUMPY\x01\x00\x76\x00{'descr': '<f4', 'fortran_order': False, 'shape': (1234, 56), }";
+	fail_count += memcmp(out, start, sizeof(start) - 1) != 0;
+	fail_count += out[NPY_HEADER_SIZE - 1] != '\n' || out[NPY_HEADER_SIZE - 2] != ' ';
+
+	if (fail_count) printf("\t\tEncoders: " FAIL("FAILED") " x %d\n", fail_count);
+	else printf("\t\tEncoders: " PASS("PASSED") "\n");
+	return fail_count;
+}
+
+int main(void) {
+	printf("starting tests on value_encoder.c\n");
+	int fail_count = 0;
+	fail_count += test_half_edge_cases();
+	fail_count += test_half_ranges();
+	fail_count += test_half_random();
+	fail_count += test_encoders();
+	return fail_count ? 1 : 0;
+}